@@ -7,18 +7,87 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
+#include <float.h>
 #include <time.h>
 #include <SDL3/SDL.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+//build with -DHAVE_ZLIB -lz and -DHAVE_ZSTD -lzstd to open .stl.gz and .stl.zst models
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define RENDER_LINES 0x01
 #define FILL_POLYGONS 0x02
 
+#define EDGES_ALL 0 //every polygon outlines itself, so shared edges are drawn twice
+#define EDGES_UNIQUE 1 //every edge once
+#define EDGES_FEATURE 2 //edges sharper than feature_angle and open borders
+#define EDGES_SILHOUETTE 3 //edges between a polygon facing the viewer and one facing away, and open borders
+
+#define NO_NEIGHBOR UINT32_MAX
+#define OPEN_EDGE 255 //edge angle of an edge with no polygon across it
+
 #define PI 3.1415926535897932384626433832795
 
 #define RED (color_t) 0xffff0000
 #define WHITE (color_t) 0xffffffff
 #define BLACK (color_t) 0xff000000
 
+#define BVH_BINS 16
+#define BVH_LEAF_SIZE 8
+
+#define MAX_LODS 3
+
+#define INDEX_BLOCK 64 //polygons whose compact indices share one base vertex
+#define WIDE_INDEX_BLOCK 0x80000000u //set in the base of a block that keeps 32 bit indices
+
+#define MESHLET_VERTICES 64
+#define MESHLET_POLYGONS 124
+#define TRANSFORM_BLOCK 512 //vertices rotated and then projected at a time, few enough to stay in the L1 cache
+//what a visible meshlet does in a hi-z frame
+#define MESHLET_EARLY 1
+#define MESHLET_LATE 2
+#define MESHLET_OCCLUDED 3
+
+#define CACHE_VERSION 5
+
+#define LOAD_BATCH 131072 //polygons decoded between progress updates while streaming a model in
+
+#define STREAM_LOADING 0
+#define STREAM_DONE 1
+#define STREAM_FAILED 2
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1
+#define COMPRESSION_ZSTD 2
+#define COMPRESSED_BLOCK (4 << 20) //decompressed bytes handed to the parsers at a time
+#define COMPRESSED_BLOCKS 4 //blocks in flight between the decompressor and the parsers
+#define COMPRESSED_CARRY 65536 //longest unfinished tail of a block carried into the next one
+
+#define PROFILE_EVENTS 65536 //power of two, the oldest events are overwritten
+#define PROFILE_HISTORY 64 //frames averaged by the overlay
+#define PROFILE_STAGES 7
+
+#define FRAME_BUFFERS 3 //one on screen, one being drawn and one finished and waiting
+#define FRAME_FREE 0
+#define FRAME_RENDERING 1
+#define FRAME_READY 2
+#define FRAME_SHOWN 3
+
 typedef uint32_t color_t;
 
 typedef struct
@@ -37,6 +106,377 @@ typedef struct
     color_t color;
 } polygon_t;
 
+typedef struct
+{
+    point3d low;
+    point3d high;
+    uint32_t first; //first polygon of a leaf, or the first of two children
+    uint32_t count; //polygons in a leaf, 0 for inner nodes
+} bvh_node_t;
+
+typedef struct
+{
+    //a bvh_node_t of a compact mesh in steps of its position grid, so the bounds are the rounded positions themselves
+    uint16_t low[3];
+    uint16_t high[3];
+    uint32_t first;
+    uint32_t count;
+} quantized_bvh_node_t;
+
+typedef struct
+{
+    //bounding sphere of the vertices
+    point3d center;
+    float radius;
+    //every face normal is within the angle whose cosine and sine these are of cone_axis, a cosine <= 0 never culls
+    point3d cone_axis;
+    float cone_cosine;
+    float cone_sine;
+    //polygons [first_polygon, last_polygon) in leaf order; vertices are numbered by first use, so the ones this meshlet
+    //brings in are [first_vertex, last_vertex) and the ones it shares with earlier meshlets are number_of_shared pairs
+    //of vertex and owning meshlet from shared_vertices[first_shared * 2] on
+    uint32_t first_polygon;
+    uint32_t last_polygon;
+    uint32_t first_vertex;
+    uint32_t last_vertex;
+    uint32_t first_shared;
+    uint32_t number_of_shared;
+} meshlet_t;
+
+typedef struct
+{
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} mapped_file_t;
+
+typedef struct mesh_s
+{
+    //vertex positions as separate x, y and z streams for the SIMD transform
+    float* x;
+    float* y;
+    float* z;
+    long long number_of_vertices;
+    //three vertex indices per polygon, counter clockwise like the STL facets
+    uint32_t* indices;
+    point3d* normals;
+    color_t* colors;
+    long long number_of_polygons;
+    //bounding box of the vertices
+    point3d low;
+    point3d high;
+    //polygons are stored in leaf order, so every node covers a contiguous range of them
+    bvh_node_t* bvh;
+    long long number_of_bvh_nodes;
+    //three per polygon in the order the edges are drawn (corners 0-1, 0-2, 2-1): the polygon across the edge and the angle
+    //between the two normals in degrees, NO_NEIGHBOR and OPEN_EDGE on an open border; NULL draws every polygon outline
+    uint32_t* neighbors;
+    uint8_t* edge_angles;
+    //runs of at most MESHLET_POLYGONS polygons and MESHLET_VERTICES vertices that are culled whole before anything in them is
+    //transformed; NULL when the vertices are not numbered by first use, then the polygons are culled one by one
+    meshlet_t* meshlets;
+    long long number_of_meshlets;
+    uint32_t* shared_vertices;
+    long long number_of_shared_vertices;
+    //simplified copies, each about a quarter of the one before, built in the background
+    struct mesh_s* lods;
+    int number_of_lods;
+    SDL_AtomicInt lods_ready;
+    SDL_Thread* lod_thread;
+    double surface_area;
+    //set when the arrays above point into a mapped cache file instead of the heap
+    mapped_file_t cache;
+    //compact storage, used instead of x, y, z, normals and colors when set: a position is quant_low + q * quant_step,
+    //normals are octahedral with two 16 bit halves and colors index a palette of up to 256
+    uint16_t* qx;
+    uint16_t* qy;
+    uint16_t* qz;
+    point3d quant_low;
+    point3d quant_step;
+    uint32_t* packed_normals;
+    uint8_t* color_index;
+    color_t* palette;
+    int palette_size;
+    //and indices are 16 bit offsets from index_base of their block of INDEX_BLOCK polygons, a block whose vertices are
+    //further apart keeps its indices whole in wide_indices; the bvh is quantized_bvh, with the same number of nodes
+    uint16_t* packed_indices;
+    uint32_t* index_base;
+    uint32_t* wide_indices;
+    quantized_bvh_node_t* quantized_bvh;
+    //new whenever the positions change, so nothing transformed from the old ones is reused; 0 is never cached
+    uint32_t revision;
+} mesh_t;
+
+typedef struct
+{
+    //a cache file is this header, then x, y, z, indices, normals, colors, bvh nodes, neighbors, edge angles, meshlets and
+    //shared meshlet vertices, each starting on a 64 byte boundary
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; //0x01020304 as written
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t file_size;
+    int64_t number_of_vertices;
+    int64_t number_of_polygons;
+    int64_t number_of_bvh_nodes;
+    int64_t number_of_meshlets;
+    int64_t number_of_shared_vertices;
+    uint64_t offsets[11];
+    point3d low;
+    point3d high;
+    float weld_tolerance;
+    uint32_t reserved;
+} mesh_cache_header_t;
+
+typedef struct
+{
+    //screen x = (row 0 . v) / w, screen y = (row 1 . v) / w, z = row 2 . v, w = row 3 . v, with v = (x, y, z, 1)
+    float m[4][4];
+    //rotation only, for normals
+    float rotation[3][3];
+} view_matrix_t;
+
+typedef struct
+{
+    //the last stage of the transform, on positions already rotated into the view: screen x = x * scale / w + center_x,
+    //screen y = center_y - y * scale / w, with w = 2 - z * perspective, or 1 without perspective
+    float scale;
+    float perspective;
+    float center_x;
+    float center_y;
+} projection_t;
+
+typedef struct
+{
+    float* x;
+    float* y;
+    float* z;
+    long long capacity;
+} vertex_stream_t;
+
+typedef struct
+{
+    mesh_t* mesh;
+    //bounds and centroid of every polygon, by original index
+    point3d* low;
+    point3d* high;
+    point3d* centroid;
+    //polygon order, partitioned in place as nodes are split
+    uint32_t* order;
+    bvh_node_t* nodes;
+    SDL_AtomicInt next_node;
+    //subtrees small enough to finish on one thread
+    uint32_t* tasks;
+    long long number_of_tasks;
+} bvh_build_t;
+
+typedef struct
+{
+    mesh_t* mesh;
+    //edges whose lower vertex is v are entries[starts[v]] up to entries[starts[v + 1]], as polygon * 3 + edge
+    uint32_t* starts;
+    uint32_t* entries;
+    uint32_t* uppers; //the higher vertex of each entry's edge
+} edge_build_t;
+
+typedef struct
+{
+    //polygons [first, last)
+    uint32_t first;
+    uint32_t last;
+} polygon_run_t;
+
+typedef struct
+{
+    //pixels [x0, x1) x [y0, y1), empty when x0 >= x1 or y0 >= y1
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} rect_t;
+
+typedef struct
+{
+    //what a frame is drawn into, rows are width pixels apart and the buffer holds at least capacity pixels
+    uint32_t* pixels;
+    int width;
+    int height;
+    long long capacity;
+    rect_t dirty; //covers everything drawn since the target was last cleared
+} render_target_t;
+
+typedef struct
+{
+    uint32_t* items;
+    int count;
+    int capacity;
+} tile_bin_t;
+
+typedef struct
+{
+    struct thread_pool_s* pool;
+    int index;
+} pool_worker_t;
+
+typedef struct thread_pool_s
+{
+    SDL_Thread** threads;
+    pool_worker_t* workers;
+    int number_of_threads; //workers besides the calling thread
+    SDL_Mutex* mutex;
+    SDL_Condition* wake;
+    SDL_Condition* done;
+    int generation;
+    int busy;
+    int quit;
+    //current job, run once for every item
+    void (*job)(void* data, int item, int worker);
+    void* data;
+    //participant k owns items [queue_next[k], queue_end[k]), idle participants take from the others
+    SDL_AtomicInt* queue_next;
+    int* queue_end;
+    double* busy_ms;
+    SDL_AtomicInt steals;
+} thread_pool_t;
+
+typedef struct
+{
+    long long backface;
+    long long outside;
+    long long behind;
+} cull_counts_t;
+
+typedef struct
+{
+    int tiles;
+    int threads;
+    int steals;
+    long long max_tile_polygons;
+    double mean_tile_polygons;
+    double max_tile_ms;
+    double mean_tile_ms;
+    double max_thread_ms;
+    double mean_thread_ms;
+    long long visible_polygons;
+    long long bvh_skipped;
+    long long meshlets;
+    long long meshlets_culled;
+    long long meshlet_skipped; //polygons in the bvh runs that were in culled meshlets
+    long long meshlets_occluded;
+    long long occlusion_culled; //polygons in meshlets hidden behind the depth pyramid
+    cull_counts_t culled;
+    int lod_level;
+    int lod_levels;
+    long long submitted;
+    long long lines;
+    long long pixels;
+    long long rotated_vertices;
+    long long projected_vertices;
+} raster_stats_t;
+
+typedef struct
+{
+    render_target_t* target;
+    float* depth;
+    long long depth_allocated;
+    mesh_t* mesh;
+    vertex_stream_t projected;
+    view_matrix_t matrix;
+    projection_t projection;
+    //positions rotated into the view, z goes straight to projected; they stay while the mesh and the rotation do, so zooming
+    //or changing the perspective only projects again. An epoch is moved on whenever its key changes, and a range is
+    //current when it was done in the current epoch
+    vertex_stream_t rotated;
+    const mesh_t* cached_mesh;
+    uint32_t cached_revision;
+    long long cached_vertices;
+    float cached_rotation[3][3];
+    projection_t cached_projection;
+    uint32_t rotation_epoch;
+    uint32_t projection_epoch;
+    uint32_t rotated_all; //epochs the whole mesh was done in
+    uint32_t projected_all;
+    uint32_t* meshlet_rotated; //epochs each meshlet's own vertices were done in
+    uint32_t* meshlet_projected;
+    long long rotated_count;
+    long long projected_count;
+    uint8_t mode;
+    float line_bias;
+    int tile_size;
+    int tiles_x;
+    int tiles_y;
+    //one set of tile bins per binning chunk, so chunks never share a bin
+    int chunks;
+    tile_bin_t* bins;
+    int bins_allocated;
+    //polygons in bvh nodes that overlap the view, as runs of consecutive polygons
+    polygon_run_t* runs;
+    long long* run_offsets;
+    long long number_of_runs;
+    long long runs_allocated;
+    uint32_t* stack;
+    long long stack_allocated;
+    //meshlets that survived this frame, and the frame stamp of each that did
+    uint32_t* visible_meshlets;
+    long long number_of_visible_meshlets;
+    uint32_t* meshlet_stamps;
+    long long meshlet_stamps_allocated;
+    uint32_t meshlet_stamp;
+    long long meshlets_culled;
+    //pieces of the bvh runs inside visible meshlets, with the meshlet of each
+    polygon_run_t* meshlet_runs;
+    uint32_t* meshlet_run_owners;
+    long long number_of_meshlet_runs;
+    long long meshlet_runs_allocated;
+    //hi-z: the meshlets drawn last frame are drawn first, the farthest depth they leave is reduced into a pyramid and the
+    //others are tested against it before they are transformed; phases are valid for meshlets stamped this frame
+    uint8_t* meshlet_phases;
+    uint32_t* meshlet_seen; //meshlet stamp of the last frame each meshlet was found not occluded
+    mesh_t* occlusion_mesh;
+    long long meshlets_occluded;
+    long long occlusion_culled;
+    int phase; //0 draws the frame at once, 1 the early meshlets, 2 the late ones
+    long long visible_base; //where this phase's culled polygons start in visible
+    long long early_visible;
+    long long* chunk_early_visible;
+    //level k > 0 halves level k - 1 and holds the smallest depth under each cell, level 0 is the depth buffer
+    float* pyramid;
+    long long pyramid_allocated;
+    int pyramid_levels;
+    int pyramid_width[16];
+    int pyramid_height[16];
+    long long pyramid_offsets[16];
+    //frame stamp per vertex, when only a few vertices are in view they are transformed one by one
+    uint32_t* vertex_stamps;
+    long long vertex_stamps_allocated;
+    uint32_t stamp;
+    //outside EDGES_ALL: frame stamp per polygon that survived the cull, and the edges each of them draws
+    int edges;
+    uint32_t* polygon_stamps;
+    uint8_t* edge_masks;
+    long long polygon_stamps_allocated;
+    uint32_t polygon_stamp;
+    long long* chunk_lines;
+    //polygons surviving the cull, each chunk writes from the start of its own range
+    uint32_t* visible;
+    long long visible_allocated;
+    cull_counts_t* chunk_culls;
+    long long* chunk_visible;
+    long long* tile_polygons;
+    long long* tile_pixels;
+    double* tile_ms;
+} raster_state_t;
+
+typedef void (*transform_kernel_t)(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count);
+
+typedef void (*quantized_kernel_t)(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count);
+
+typedef void (*project_kernel_t)(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count);
+
 typedef struct
 {
     int x;
@@ -53,9 +493,30 @@ typedef struct
     int width;
     int occlude;
     float perspective;
-    long long ms_delay_per_frame;
+    int target_fps; //0 follows the display refresh rate
+    int idle_timeout_ms; //longest wait for an event while nothing changes
+    float frame_budget_ms; //drawing time a moving view is held to by lowering the resolution, 0 uses the frame interval
+    float min_resolution; //smallest fraction of the window size drawn while moving
+    float still_resolution; //fraction of the window size drawn once the view stops, above 1 supersamples
     float sensitivity;
+    float weld_tolerance; //fraction of the bounding box diagonal
+    int lod; //-1 picks a level by screen size, otherwise the level to draw
+    float lod_pixel_area; //a level is used while its average polygon covers at most this many pixels
+    long long lod_motion_polygons; //while rotating, coarser levels are used until this many polygons are left
+    int threads; //0 uses every core
+    int parallel_threads; //most threads one parallel_for splits into, 0 for one per core
+    int tile_size; //multiple of 8
     uint8_t rendermode;
+    int edges; //EDGES_ALL, EDGES_UNIQUE, EDGES_FEATURE or EDGES_SILHOUETTE
+    int feature_angle; //degrees between two normals above which their shared edge is a feature edge
+    int headless;
+    int profiler; //draws the rolling stage timings and counters
+    int mesh_cache; //reopen models from a mapped cache file written next to them
+    int compact; //16 bit positions and indices, packed normals, palette colors and a quantized bvh, about 0.6 of the memory
+    int meshlets; //cull meshlets whole before transforming, when the mesh has them
+    int hiz; //filled frames draw last frame's meshlets first and test the rest against the depth they leave
+    const char* trace_path;
+    const char* generate; //"sphere:n" or "grid:n", a generated model of about n triangles opened instead of the default cube
 
     //SDL_Keycode for non-repeat events and SDL_Scancode for repeat events
     SDL_Keycode keybind_exit;
@@ -64,6 +525,11 @@ typedef struct
     SDL_Keycode keybind_default_view;
     SDL_Keycode keybind_switch_xyz;
     SDL_Keycode keybind_debug;
+    SDL_Keycode keybind_rendermode;
+    SDL_Keycode keybind_edges;
+    SDL_Keycode keybind_occlude;
+    SDL_Keycode keybind_profiler;
+    SDL_Keycode keybind_trace;
 
     SDL_Scancode keybind_xrotate_plus;
     SDL_Scancode keybind_xrotate_minus;
@@ -73,6 +539,211 @@ typedef struct
     SDL_Scancode keybind_zoom_out;
 } settings_t;
 
+typedef struct
+{
+    double event_ms;
+    double clear_ms;
+    double transform_ms;
+    double cull_ms;
+    double raster_ms;
+    double upload_ms;
+    double present_ms;
+} frame_timing_t;
+
+typedef struct
+{
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+    long long value;
+    int thread;
+    char kind; //'X' for a timed scope, 'C' for a counter
+} profile_event_t;
+
+typedef struct
+{
+    //writers claim a slot with one atomic increment, so workers never wait on each other
+    profile_event_t events[PROFILE_EVENTS];
+    SDL_AtomicInt next;
+    //the last frames, stages in frame_timing_t order then the counters
+    double stage_ms[PROFILE_HISTORY][PROFILE_STAGES];
+    long long counters[PROFILE_HISTORY][4];
+    int frames;
+} profiler_t;
+
+typedef struct
+{
+    float xangle;
+    float yangle;
+    float scale;
+    float perspective;
+} camera_t;
+
+typedef struct
+{
+    //one microbenchmark, timed per call
+    const char* name;
+    long long items; //lines, points, numbers, triangles or bytes handled per call
+    int calls;
+    double min_ms;
+    double median_ms;
+    double p95_ms;
+} bench_result_t;
+
+typedef struct batch_model_s
+{
+    mesh_t mesh;
+    int path; //index into the model list
+    long long charge; //bytes taken from the memory budget
+    struct batch_model_s* next;
+} batch_model_t;
+
+typedef struct
+{
+    //models are loaded on several threads and drawn on the calling one in whatever order they become ready
+    char** paths;
+    int number_of_paths;
+    SDL_AtomicInt next_path;
+    SDL_Mutex* mutex;
+    SDL_Condition* changed;
+    batch_model_t* ready;
+    int loaders; //loader threads still running
+    //estimated bytes of the models being loaded or waiting to be drawn, a loader waits while a model would go over the
+    //budget unless nothing else is in memory, so one model larger than the budget still gets drawn on its own
+    long long budget;
+    long long used;
+    int failed;
+} batch_t;
+
+typedef struct
+{
+    void (*job)(void* data, long long first, long long last);
+    void* data;
+    long long first;
+    long long last;
+} parallel_range_t;
+
+typedef struct
+{
+    //a supersampled scene and the window size target its rows are box filtered into
+    const render_target_t* source;
+    render_target_t* target;
+} resolve_job_t;
+
+typedef struct
+{
+    const uint8_t* records;
+    polygon_t* polygonlist;
+    SDL_AtomicInt corrupt;
+} stl_decode_t;
+
+typedef struct
+{
+    //the loader thread decodes the file in batches and publishes how many polygons are ready, the renderer never waits on it
+    const char* path;
+    SDL_Thread* thread;
+    SDL_AtomicInt total; //polygons in the file, 0 until it is known
+    SDL_AtomicInt ready; //polygons copied into the preview
+    SDL_AtomicInt status; //STREAM_LOADING, STREAM_DONE or STREAM_FAILED
+    SDL_AtomicInt cancel;
+    //unwelded, three vertices per polygon; the loader writes the arrays, the renderer owns the counts and bounds
+    mesh_t preview;
+    //welded with its bvh, taken over by the renderer once the status is STREAM_DONE
+    mesh_t final;
+} mesh_stream_t;
+
+typedef struct
+{
+    const char* data;
+    size_t size;
+    //chunk i covers [boundaries[i], boundaries[i + 1]) and writes from first_polygon[i]
+    size_t* boundaries;
+    int chunks;
+    long long first_chunk; //added to the chunk numbers handed to the jobs
+    long long* first_polygon;
+    long long* chunk_polygons;
+    polygon_t* polygonlist;
+    SDL_AtomicInt corrupt;
+} stl_ascii_t;
+
+typedef struct
+{
+    //one thread decompresses into a ring of blocks, the loader parses them in order and hands them back
+    const uint8_t* data;
+    size_t size;
+    int format;
+    SDL_Thread* thread;
+    SDL_Mutex* mutex;
+    SDL_Condition* filled;
+    SDL_Condition* emptied;
+    //every block has COMPRESSED_CARRY bytes in front, where the tail of the block before it is put back
+    uint8_t* blocks[COMPRESSED_BLOCKS];
+    size_t lengths[COMPRESSED_BLOCKS];
+    long long produced;
+    long long consumed;
+    int finished; //1 once every block is in, -1 when the data is corrupt
+    int cancel;
+} decompress_t;
+
+typedef struct
+{
+    //a model decoded block by block, the polygon list grows as they come in
+    int ascii; //-1 until the first block is seen
+    long long announced; //polygons a binary header says there are
+    long long count;
+    long long capacity;
+    polygon_t* polygonlist;
+    int corrupt; //binary triangles with non-finite vertices
+    stl_ascii_t chunks;
+} compressed_stl_t;
+
+typedef struct
+{
+    //everything a frame is drawn from, taken on the SDL thread before the frame is submitted and never changed after
+    float xangle;
+    float yangle;
+    float scale;
+    float perspective;
+    int occlude;
+    uint8_t rendermode;
+    int edges;
+    int profiler;
+    int moving;
+    mesh_t* mesh; //the mesh or the preview, not touched by the SDL thread until the frame is done
+    int loading; //mesh is the preview
+    long long loaded;
+    long long total;
+    long long fps;
+    //the SDL thread's share of the frame before, for the profiler
+    double event_ms;
+    double upload_ms;
+    double present_ms;
+    float resolution; //fraction of the window size the scene is drawn at
+    Uint64 submitted_ns;
+} view_state_t;
+
+typedef struct
+{
+    //the render thread draws into a free buffer while the SDL thread uploads and presents the one before it
+    SDL_Thread* thread; //NULL draws on the SDL thread when submitted
+    SDL_Mutex* mutex;
+    SDL_Condition* wake;
+    SDL_Condition* idle;
+    //the scene at the resolution the frame was drawn at, and the hud at window size, clear where nothing is drawn
+    render_target_t scenes[FRAME_BUFFERS];
+    render_target_t huds[FRAME_BUFFERS];
+    render_target_t hud_layer; //the parts of the hud that never change, drawn once and copied back over what was drawn on top
+    render_target_t resolved[FRAME_BUFFERS]; //a supersampled scene filtered down to window size, no pixels without supersampling
+    double frame_ms[FRAME_BUFFERS]; //time the render thread spent on the frame
+    int state[FRAME_BUFFERS];
+    long long sequence[FRAME_BUFFERS];
+    view_state_t views[FRAME_BUFFERS];
+    long long submitted;
+    int job; //buffer being drawn, -1 when idle
+    int quit;
+    Uint32 frame_event; //pushed when a frame is ready
+} render_thread_t;
+
 point3d rotatex(float angle, point3d point);
 
 point3d rotatey(float angle, point3d point);
@@ -81,573 +752,7823 @@ point3d rotatez(float angle, point3d point);
 
 polygon_t newpolygon(color_t color, point3d a, point3d b, point3d c);
 
-void polyrender(uint32_t* screen, polygon_t* polygonlist, long long number_of_polygons, float xangle, float yangle, uint8_t mode);
+void polyrender(render_target_t* target, mesh_t* mesh, float xangle, float yangle, uint8_t mode);
 
-void line(uint32_t* screen, point3d a, point3d b, color_t color);
+void line(render_target_t* target, point3d a, point3d b, color_t color);
 
-point3d calculated_position_to_screen_position(point3d point);
+int line_depth(render_target_t* target, float* depth, point3d a, point3d b, color_t color, float bias, rect_t clip);
 
-void put_pixel(uint32_t* screen, unsigned x, unsigned y, uint32_t color);
+long long draw_lines(render_target_t* target, float* depth, const vertex_stream_t* points, const uint32_t* ends, const color_t* colors, long long count, float bias, rect_t clip);
 
-point3d model_to_2d(point3d point, float xangle, float yangle);
+void clip_line_steps(int64_t start, int64_t step, int low, int high, int* first, int* last);
 
-void numberrender(uint32_t* screen, int number, point3d offset, int count);
+int64_t floor_div(int64_t a, int64_t b);
 
-button_t new_button(int x, int y, int width, int height, char *text);
+int fill_triangle(render_target_t* target, float* depth, point3d a, point3d b, point3d c, color_t color, point3d normal, rect_t clip);
 
-void renderbutton(uint32_t* screen, button_t button);
+int clip_to_guard(point3d* polygon, int count, float guard);
 
-int check_button_pressed(button_t button, int x, int y);
+void draw_phase(raster_state_t* state, thread_pool_t* pool, int tiles);
 
-point3d addpoint(point3d a, float x, float y, float z)
+void cull_chunk(void* data, int chunk, int worker);
+
+void bin_polygons(void* data, int chunk, int worker);
+
+long long cull_polygons(raster_state_t* state, long long first, long long last, uint32_t* visible, cull_counts_t* culled);
+
+long long cull_polygons_sse2(raster_state_t* state, long long first, long long last, uint32_t* visible, cull_counts_t* culled);
+
+void raster_tile(void* data, int tile, int worker);
+
+long long raster_polygon(raster_state_t* state, long long i, rect_t clip, uint8_t mode);
+
+long long outline_tile(raster_state_t* state, int tile, rect_t clip, int sets);
+
+int polygon_edges(const raster_state_t* state, uint32_t i);
+
+int faces_viewer(const raster_state_t* state, uint32_t i);
+
+thread_pool_t* get_thread_pool(void);
+
+void stop_thread_pool(void);
+
+void pool_run(thread_pool_t* pool, void (*job)(void* data, int item, int worker), void* data, int items);
+
+void pool_drain(thread_pool_t* pool, int self);
+
+int pool_worker_thread(void* data);
+
+color_t shade_color(color_t color, point3d normal);
+
+static inline int64_t to_fixed(float value)
 {
-    point3d ret;
-    ret.x = a.x + x;
-    ret.y = a.y + y;
-    ret.z = a.z + z;
-    return ret;
+    //28.4 fixed point, rounded to nearest
+    return (int64_t) (value * 16.0f + (value >= 0 ? 0.5f : -0.5f));
 }
 
+static inline int64_t to_fixed32(float value)
+{
+    //32.32 fixed point rounded down, exact for |value| < 2^31
+    double scaled = value * 4294967296.0;
+    int64_t fixed = (int64_t) scaled;
+    return fixed > scaled ? fixed - 1 : fixed;
+}
 
-settings_t settings;
+static inline int64_t to_fixed32_rounded(double scaled)
+{
+    //an already scaled value to the nearest integer
+    return (int64_t) (scaled + (scaled >= 0 ? 0.5 : -0.5));
+}
 
-int main(int argc, char** argv)
+//fminf and fmaxf are library calls without fast math, these are single instructions but do not skip nan
+static inline float min_float(float a, float b)
 {
-    settings.width = 1280;
-    settings.height = 720;
-    settings.ms_delay_per_frame = 10;
-    settings.occlude = 0;
-    settings.perspective = 0; //between 0 and 1
-    settings.scale = 300;
-    settings.sensitivity = 0.02;
-    settings.rendermode = RENDER_LINES | FILL_POLYGONS;
+    return a < b ? a : b;
+}
 
-    settings.keybind_yrotate_minus = SDL_SCANCODE_RIGHT;
-    settings.keybind_yrotate_plus = SDL_SCANCODE_LEFT;
-    settings.keybind_xrotate_minus = SDL_SCANCODE_DOWN;
-    settings.keybind_xrotate_plus = SDL_SCANCODE_UP;
-    settings.keybind_zoom_out = SDL_SCANCODE_MINUS;
-    settings.keybind_zoom_in = SDL_SCANCODE_EQUALS;
+static inline float max_float(float a, float b)
+{
+    return a > b ? a : b;
+}
 
-    settings.keybind_exit = SDLK_X;
-    settings.keybind_default_view = SDLK_D;
-    settings.keybind_settings = SDLK_S;
-    settings.keybind_switch_xyz = SDLK_F;
-    settings.keybind_show_view = SDLK_V;
-    settings.keybind_debug = SDLK_9;
-    
-    //<initilize SDL>
-    if (!SDL_Init(SDL_INIT_VIDEO))
-    {
-        SDL_Log("Unable to Initilize SDL: %s", SDL_GetError());
-        return 1;
-    }
+point3d calculated_position_to_screen_position(const render_target_t* target, point3d point);
 
-    SDL_Window* window = SDL_CreateWindow("Prospect Software 3D model viewer", settings.width, settings.height, 0);
-    if (!window) {SDL_Log("Unable to create window: %s", SDL_GetError()); return 1;}
+point3d window_to_target(const render_target_t* target, float x, float y);
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, NULL);
-    if (!renderer)
-    {
-        SDL_Log("Renderer Error: %s", SDL_GetError());
-        SDL_Quit();
-        return 1;
-    }
+void put_pixel(render_target_t* target, unsigned x, unsigned y, uint32_t color);
 
-    //icon
-    SDL_Surface* icon = SDL_LoadBMP("icon.bmp");
-    if (icon == NULL)
-    {
-        printf("No Icon\n");
-    }
-    else
-    {
-        SDL_SetWindowIcon(window, icon);
-    }
+rect_t union_rect(rect_t a, rect_t b);
 
-    //create screen texture
-    SDL_Texture* screen_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, settings.width, settings.height);
-    //<initilize SDL>
+void mark_dirty(render_target_t* target, rect_t rect);
 
-    int number_of_polygons = 0;
-    polygon_t* polygonlist = NULL;
-    if (argc > 1)
-    {
-        //load file
-        FILE* file = fopen(argv[1], "r");
-        if (file == NULL)
-        {
-            SDL_Log("Error 01: File Not Open");
-            number_of_polygons = 0;
-        }
+void clear_rect(render_target_t* target, int width, rect_t rect);
 
-        fseek(file, 80, SEEK_SET);
-        fread(&number_of_polygons, sizeof(uint32_t), 1, file);
+void copy_rect(render_target_t* target, const render_target_t* source, rect_t rect);
 
-        polygonlist = malloc(sizeof(polygon_t) * number_of_polygons);
-        
-        uint16_t *trash = malloc(2);
-        for (int i = 0; i < number_of_polygons; i++)
-        {
-            //read vectors
-            fread(&(polygonlist[i]), sizeof(float), 12, file);
-            polygonlist[i].color = WHITE;
-            //Attribute byte count
-            fread(trash, 2, 1, file);
-        }
-        free(trash);
-        
-        fclose(file);
-    }
-    else
-    {
-        //front
-        point3d p1 = {1.0f, 1.0f, 1.0f}; //top right
-        point3d p2 = {1.0f, -1.0f, 1.0f}; //bottom right
-        point3d p3 = {-1.0f, 1.0f, 1.0f}; //top left
-        point3d p4 = {-1.0f, -1.0f, 1.0f}; //bottom left
-        //back
-        point3d p5 = {1.0f, 1.0f, -1.0f}; //top right
-        point3d p6 = {1.0f, -1.0f, -1.0f}; //bottom right
-        point3d p7 = {-1.0f, 1.0f, -1.0f}; //top left
-        point3d p8 = {-1.0f, -1.0f, -1.0f}; //bottom left
-
-        polygon_t polygon = newpolygon(RED, p1, p4, p3);
-        polygon_t polygon2 = newpolygon(WHITE, p2, p1, p4);
-
-        number_of_polygons = 12;
-        polygonlist = malloc(sizeof(polygon_t) * number_of_polygons);
-        //front face
-        polygonlist[0] = polygon;
-        polygonlist[1] = polygon2;
-        //left face
-        polygonlist[2] = newpolygon(RED, p3, p4, p8);
-        polygonlist[3] = newpolygon(WHITE, p7, p8, p3);
-        //top face
-        polygonlist[4] = newpolygon(RED, p1, p3, p5);
-        polygonlist[5] = newpolygon(WHITE, p3, p5, p7);
-
-        //back face
-        polygonlist[6] = newpolygon(RED, p5, p7, p6);
-        polygonlist[7] = newpolygon(WHITE, p8, p7, p6);
-        //right face
-        polygonlist[8] = newpolygon(RED, p1, p2, p5);
-        polygonlist[9] = newpolygon(WHITE, p2, p5, p6);
-        //bottom face
-        polygonlist[10] = newpolygon(RED, p2, p8, p4);
-        polygonlist[11] = newpolygon(WHITE, p2, p8, p6);
-
-        /*for (int i = 0; i < 480; i++)
-        {
-            printf("%02x", *(i + (uint8_t*) polygonlist));
-        }*/
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Message", "There is no file selected. Default cube opened.", window);
-    }
-    
+void resolve_scene(render_target_t* target, const render_target_t* source);
 
-    char running = 1;
-    SDL_Event event;
-    float yrotation = 0.35f;
-    float xrotation = 0.35f;
-    long long fps = 0;
-    long long frame_latency_ms = 0;
-    float mouse_x_new = 0;
-    float mouse_y_new = 0;
-    float mouse_x_old = 0;
-    float mouse_y_old = 0;
+void resolve_rows(void* data, long long first, long long last);
 
-    //define buttons
-    button_t buttonup = new_button(0, 100, 30, 20, "Up");
-    button_t buttondown = new_button(0, 150, 30, 20, "Down");
-    while (running)
-    {
-        SDL_Time start_time;
-        SDL_GetCurrentTime(&start_time);
-        //handle events
-        while (SDL_PollEvent(&event))
-        {
-            switch (event.type)
-            {
-                case SDL_EVENT_QUIT:
-                    running = 0;
-                    break;
-                case SDL_EVENT_MOUSE_BUTTON_DOWN:
-                    //event.button.x and event.button.y for positions in window
-                    if (event.button.button == 1) //left click
-                    {
-                        if (check_button_pressed(buttonup, event.button.x, event.button.y))
-                        {
-                            settings.perspective += 0.01;
-                        }
-                        if (check_button_pressed(buttondown, event.button.x, event.button.y))
-                        {
-                            settings.perspective -= 0.01;
-                        }
-                    }
-                    else if (event.button.button == 2) //middle click
-                    {
+point3d model_to_2d(point3d point, float xangle, float yangle);
+
+view_matrix_t build_view_matrix(const render_target_t* target, float xangle, float yangle);
+
+point3d rotate_normal(const view_matrix_t* matrix, point3d normal);
+
+void transform_scalar(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count);
+
+#ifdef HAVE_X86_SIMD
+void transform_sse2(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count);
+
+void transform_avx2(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count);
+#endif
+
+transform_kernel_t select_transform_kernel(void);
+
+view_matrix_t quantized_matrix(const view_matrix_t* matrix, const mesh_t* mesh);
+
+void transform_quantized_scalar(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count);
+
+#ifdef HAVE_X86_SIMD
+void transform_quantized_sse2(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count);
+
+void transform_quantized_avx2(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count);
+#endif
+
+quantized_kernel_t select_quantized_kernel(void);
+
+int reserve_vertex_stream(vertex_stream_t* stream, long long count);
+
+projection_t build_projection(const render_target_t* target);
+
+view_matrix_t rotation_matrix(const view_matrix_t* matrix);
+
+void project_scalar(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count);
+
+#ifdef HAVE_X86_SIMD
+void project_sse2(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count);
+
+void project_avx2(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count);
+#endif
+
+project_kernel_t select_project_kernel(void);
+
+void update_transform_cache(raster_state_t* state, const mesh_t* mesh);
+
+void transform_range(raster_state_t* state, const mesh_t* mesh, const view_matrix_t* vertex_matrix, long long first, long long count, int rotate);
+
+void numberrender(render_target_t* target, int number, point3d offset, int count);
+
+button_t new_button(int x, int y, int width, int height, char *text);
+
+void renderbutton(render_target_t* target, button_t button);
+
+int check_button_pressed(button_t button, int x, int y);
+
+polygon_t* load_model(const char* path, int* number_of_polygons, mesh_stream_t* stream);
+
+polygon_t* default_cube(int* number_of_polygons);
+
+polygon_t* generate_model(const char* spec, int* number_of_polygons);
+
+polygon_t* generate_sphere(int triangles, int* number_of_polygons);
+
+point3d sphere_point(float theta, float phi);
+
+polygon_t* generate_grid(int triangles, int* number_of_polygons);
+
+int load_mesh(const char* path, mesh_t* mesh);
+
+int start_mesh_stream(mesh_stream_t* stream, const char* path);
+
+int mesh_stream_thread(void* data);
+
+void stream_begin(mesh_stream_t* stream, long long total);
+
+void stream_publish(mesh_stream_t* stream, const polygon_t* polygonlist, long long first, long long last);
+
+int poll_mesh_stream(mesh_stream_t* stream, mesh_t* mesh);
+
+void stop_mesh_stream(mesh_stream_t* stream);
+
+void render_progress(render_target_t* target, long long done, long long total);
+
+int init_render_target(render_target_t* target, float resolution);
+
+void upload_rect(SDL_Texture* texture, const render_target_t* target, rect_t rect);
+
+void size_render_target(render_target_t* target, float resolution);
+
+float adjust_resolution(float resolution, double frame_ms, double budget_ms);
+
+int start_render_thread(render_thread_t* render, const button_t* buttons, int number_of_buttons);
+
+int render_thread(void* data);
+
+void render_frame(render_target_t* scene, render_target_t* hud, render_target_t* resolved, const view_state_t* view, const render_target_t* hud_layer);
+
+int submit_frame(render_thread_t* render, const view_state_t* view);
+
+int take_frame(render_thread_t* render);
+
+void release_frame(render_thread_t* render, int index);
+
+int render_idle(render_thread_t* render);
+
+void wait_render_idle(render_thread_t* render);
+
+void stop_render_thread(render_thread_t* render);
+
+int mesh_from_polygons(polygon_t* polygonlist, long long number_of_polygons, mesh_t* mesh);
+
+void repair_normals(void* data, long long first, long long last);
+
+int build_edges(mesh_t* mesh);
+
+long long orient_polygons(mesh_t* mesh);
+
+void flip_polygon(mesh_t* mesh, uint32_t i);
+
+int renumber_vertices(mesh_t* mesh);
+
+int build_meshlets(mesh_t* mesh);
+
+void meshlet_bounds(void* data, long long first, long long last);
+
+void pair_edges(void* data, long long first, long long last);
+
+int edge_angle(const mesh_t* mesh, uint32_t i, uint32_t j, int consistent);
+
+point3d face_normal(const mesh_t* mesh, uint32_t i);
+
+void free_mesh(mesh_t* mesh);
+
+int compact_mesh(mesh_t* mesh);
+
+uint32_t encode_normal(point3d normal);
+
+point3d decode_normal(uint32_t packed);
+
+void set_mesh_color(mesh_t* mesh, long long i, color_t color);
+
+long long mesh_bytes(const mesh_t* mesh);
+
+//readers of a mesh that may be compact go through these
+static inline point3d mesh_vertex(const mesh_t* mesh, uint32_t v)
+{
+    if (mesh->qx)
+    {
+        return (point3d) {mesh->quant_low.x + mesh->qx[v] * mesh->quant_step.x, mesh->quant_low.y + mesh->qy[v] * mesh->quant_step.y, mesh->quant_low.z + mesh->qz[v] * mesh->quant_step.z};
+    }
+    return (point3d) {mesh->x[v], mesh->y[v], mesh->z[v]};
+}
+
+static inline point3d mesh_normal(const mesh_t* mesh, long long i)
+{
+    return mesh->packed_normals ? decode_normal(mesh->packed_normals[i]) : mesh->normals[i];
+}
+
+static inline color_t mesh_color(const mesh_t* mesh, long long i)
+{
+    return mesh->color_index ? mesh->palette[mesh->color_index[i]] : mesh->colors[i];
+}
+
+static inline void mesh_indices(const mesh_t* mesh, long long i, uint32_t index[3])
+{
+    if (mesh->indices)
+    {
+        index[0] = mesh->indices[i * 3];
+        index[1] = mesh->indices[i * 3 + 1];
+        index[2] = mesh->indices[i * 3 + 2];
+        return;
+    }
+    uint32_t base = mesh->index_base[i / INDEX_BLOCK];
+    if (base & WIDE_INDEX_BLOCK)
+    {
+        const uint32_t* wide = &mesh->wide_indices[((long long) (base & ~WIDE_INDEX_BLOCK) * INDEX_BLOCK + i % INDEX_BLOCK) * 3];
+        index[0] = wide[0];
+        index[1] = wide[1];
+        index[2] = wide[2];
+        return;
+    }
+    const uint16_t* packed = &mesh->packed_indices[i * 3];
+    index[0] = base + packed[0];
+    index[1] = base + packed[1];
+    index[2] = base + packed[2];
+}
+
+static inline bvh_node_t mesh_bvh_node(const mesh_t* mesh, uint32_t k)
+{
+    //dequantized like mesh_vertex, so a box holds the positions it was made from exactly
+    if (mesh->quantized_bvh == NULL) {return mesh->bvh[k];}
+    const quantized_bvh_node_t* node = &mesh->quantized_bvh[k];
+    point3d low = mesh->quant_low;
+    point3d step = mesh->quant_step;
+    return (bvh_node_t) {{low.x + node->low[0] * step.x, low.y + node->low[1] * step.y, low.z + node->low[2] * step.z},
+                         {low.x + node->high[0] * step.x, low.y + node->high[1] * step.y, low.z + node->high[2] * step.z}, node->first, node->count};
+}
+
+uint32_t weld_hash(long long x, long long y, long long z);
+
+int build_bvh(mesh_t* mesh);
+
+void start_lod_build(mesh_t* mesh);
+
+void wait_lod_build(mesh_t* mesh);
+
+int lod_build_thread(void* data);
+
+int simplify_mesh(const mesh_t* source, long long target, mesh_t* level);
+
+void radix_sort(uint32_t* keys, uint32_t* values, uint32_t* keys_temp, uint32_t* values_temp, long long count);
+
+mesh_t* select_lod(mesh_t* mesh, int moving);
+
+void switch_mesh_axes(mesh_t* mesh);
+
+void bvh_polygon_bounds(void* data, long long first, long long last);
+
+void bvh_build_subtrees(void* data, long long first, long long last);
+
+void bvh_build_from(bvh_build_t* build, uint32_t root, long long task_size);
+
+int bvh_split_node(bvh_build_t* build, bvh_node_t* node);
+
+void bvh_collect_runs(raster_state_t* state, mesh_t* mesh);
+
+void view_planes(const raster_state_t* state, float planes[5][4]);
+
+int cull_meshlets(raster_state_t* state, mesh_t* mesh);
+
+int meshlet_visible(const raster_state_t* state, const meshlet_t* meshlet, float planes[5][4]);
+
+void select_meshlet_runs(raster_state_t* state, int phase);
+
+int split_meshlets(raster_state_t* state, mesh_t* mesh);
+
+void transform_meshlets(raster_state_t* state, mesh_t* mesh, const view_matrix_t* vertex_matrix, int phase);
+
+void build_depth_pyramid(raster_state_t* state, thread_pool_t* pool);
+
+void reduce_depth_rows(void* data, int band, int worker);
+
+void occlude_meshlets(raster_state_t* state, mesh_t* mesh);
+
+int sphere_occluded(const raster_state_t* state, point3d center, float radius);
+
+long long pick_polygon(mesh_t* mesh, const view_matrix_t* matrix, float x, float y, point3d* hit);
+
+int ray_box(point3d origin, point3d inverse, point3d low, point3d high, float t_min, float t_max);
+
+float ray_triangle(point3d origin, point3d direction, point3d a, point3d b, point3d c);
+
+int map_file(const char* path, mapped_file_t* file, int copy_on_write);
+
+int file_stamp(const char* path, uint64_t* size, int64_t* mtime);
+
+int load_mesh_cache(const char* path, mesh_t* mesh);
+
+int check_mesh_cache(const mesh_t* mesh);
+
+int write_mesh_cache(const char* path, const mesh_t* mesh);
+
+void unmap_file(mapped_file_t* file);
+
+polygon_t* load_stl_binary(const uint8_t* data, size_t size, int* number_of_polygons, mesh_stream_t* stream);
+
+void decode_stl_records(void* data, long long first, long long last);
+
+int looks_like_ascii_stl(const uint8_t* data, size_t size);
+
+polygon_t* load_stl_ascii(const uint8_t* data, size_t size, int* number_of_polygons, mesh_stream_t* stream);
+
+void count_stl_ascii_chunks(void* data, long long first, long long last);
+
+void parse_stl_ascii_chunks(void* data, long long first, long long last);
+
+long long split_stl_ascii(stl_ascii_t* ascii, const char* data, size_t size, int chunks);
+
+int compression_format(const uint8_t* data, size_t size);
+
+polygon_t* load_compressed_stl(const uint8_t* data, size_t size, int format, int* number_of_polygons, mesh_stream_t* stream);
+
+long long decode_stl_binary_block(compressed_stl_t* load, const uint8_t* data, size_t size, mesh_stream_t* stream);
+
+long long parse_stl_ascii_block(compressed_stl_t* load, const char* data, size_t size, int last);
+
+int reserve_polygons(compressed_stl_t* load, long long count);
+
+int decompress_thread(void* data);
+
+int inflate_blocks(decompress_t* decompress);
+
+int zstd_blocks(decompress_t* decompress);
+
+uint8_t* next_free_block(decompress_t* decompress);
+
+void publish_block(decompress_t* decompress, size_t length);
+
+uint8_t* take_block(decompress_t* decompress, size_t* length);
+
+void return_block(decompress_t* decompress);
+
+const char* next_word(const char* p, const char* end, size_t* length);
+
+const char* find_word(const char* p, const char* end, const char* word, size_t word_length);
+
+int parse_float(const char* p, size_t length, float* out);
+
+int nonfinite_word(const char* p, size_t length);
+
+void parallel_for(long long count, long long min_per_thread, void (*job)(void* data, long long first, long long last), void* data);
+
+int parallel_range_thread(void* data);
+
+int run_headless(mesh_t* mesh, int frames, const char* camera_path, const char* snapshot_path, const char* reference_path, int tolerance);
+
+int run_bench(const char* json_path);
+
+void bench_record(bench_result_t* result, const char* name, long long items, double* samples, int calls);
+
+uint8_t* stl_image(const polygon_t* polygons, int number_of_polygons, int ascii, size_t* size);
+
+int run_batch(const char* list_path, const char* out_dir, int angles, const char* format, long long budget);
+
+int batch_loader_thread(void* data);
+
+int batch_load_next(batch_t* batch, int wait);
+
+char** list_models(const char* path, int* count);
+
+int has_model_extension(const char* name);
+
+void center_mesh(mesh_t* mesh);
+
+void touch_mesh(mesh_t* mesh);
+
+float fit_scale(const mesh_t* mesh, int width, int height);
+
+camera_t* load_camera_path(const char* path, int* count);
+
+int write_ppm(const char* path, uint32_t* pixels, int width, int height);
+
+uint32_t* read_ppm(const char* path, int* width, int* height);
+
+long long compare_image(const uint32_t* pixels, const uint32_t* reference, long long count, int tolerance, int* worst);
+
+int write_png(const char* path, uint32_t* pixels, int width, int height);
+
+int write_snapshot(const char* path, uint32_t* pixels, int width, int height);
+
+int frame_path(const char* pattern, int frame, char* name, size_t size);
+
+double elapsed_ms(Uint64 start);
+
+double profile_end(const char* name, Uint64 start, int thread);
+
+void profile_count(const char* name, long long value);
+
+void profile_frame(void);
+
+void profile_overlay(render_target_t* target);
+
+int write_trace(const char* path);
+
+int compare_double(const void* a, const void* b);
+
+double percentile(double* sorted, int count, double p);
+
+uint32_t png_crc(uint32_t crc, const uint8_t* data, size_t length);
+
+void png_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t length);
+
+point3d addpoint(point3d a, float x, float y, float z)
+{
+    point3d ret;
+    ret.x = a.x + x;
+    ret.y = a.y + y;
+    ret.z = a.z + z;
+    return ret;
+}
+
+
+settings_t settings;
+frame_timing_t frame_timing;
+raster_stats_t raster_stats;
+raster_state_t raster_state;
+profiler_t profiler;
+SDL_AtomicInt mesh_revisions;
+Uint32 redraw_event; //pushed by background work that changes what is on screen
+
+int main(int argc, char** argv)
+{
+    settings.width = 1280;
+    settings.height = 720;
+    settings.target_fps = 0;
+    settings.idle_timeout_ms = 1000;
+    settings.frame_budget_ms = 0;
+    settings.min_resolution = 0.25f;
+    settings.still_resolution = 1;
+    settings.occlude = 0;
+    settings.perspective = 0; //between 0 and 1
+    settings.scale = 300;
+    settings.sensitivity = 0.02;
+    settings.weld_tolerance = 1e-6f;
+    settings.lod = -1;
+    settings.lod_pixel_area = 1.0f;
+    settings.lod_motion_polygons = 500000;
+    settings.threads = 0;
+    settings.tile_size = 64;
+    settings.rendermode = RENDER_LINES | FILL_POLYGONS;
+    settings.edges = EDGES_UNIQUE;
+    settings.feature_angle = 30;
+    settings.meshlets = 1;
+    settings.hiz = 1;
+
+    settings.keybind_yrotate_minus = SDL_SCANCODE_RIGHT;
+    settings.keybind_yrotate_plus = SDL_SCANCODE_LEFT;
+    settings.keybind_xrotate_minus = SDL_SCANCODE_DOWN;
+    settings.keybind_xrotate_plus = SDL_SCANCODE_UP;
+    settings.keybind_zoom_out = SDL_SCANCODE_MINUS;
+    settings.keybind_zoom_in = SDL_SCANCODE_EQUALS;
+
+    settings.keybind_exit = SDLK_X;
+    settings.keybind_default_view = SDLK_D;
+    settings.keybind_settings = SDLK_S;
+    settings.keybind_switch_xyz = SDLK_F;
+    settings.keybind_show_view = SDLK_V;
+    settings.keybind_debug = SDLK_9;
+    settings.keybind_rendermode = SDLK_R;
+    settings.keybind_edges = SDLK_E;
+    settings.keybind_occlude = SDLK_O;
+    settings.keybind_profiler = SDLK_P;
+    settings.keybind_trace = SDLK_T;
+    settings.headless = 0;
+    settings.profiler = 0;
+    settings.trace_path = "trace.json";
+    settings.generate = NULL;
+    settings.mesh_cache = 1;
+    settings.compact = 0;
+
+    //command line: [--headless] [--frames n] [--camera-path file] [--snapshot file] [--compare file.ppm [--tolerance n]] [--trace file] [--no-cache] [--compact] [--no-meshlets] [--no-hiz] [--mode lines|fill|both] [--edges all|unique|feature|silhouette] [--feature-angle degrees] [--occlude] [--lod auto|n] [--threads n] [--tile-size n] [--budget ms] [--min-resolution f] [--supersample f] [--size WxH]
+    //              [--batch dir|list [--out dir] [--angles n] [--format png|ppm] [--batch-memory MB]] [--bench file.json] [--generate sphere|grid[:n]] [model.stl]
+    //--batch-memory bounds the models loaded ahead of drawing; one model larger than it is still loaded, on its own, so
+    //memory then goes up to what that model takes
+    const char* model_path = NULL;
+    const char* batch_path = NULL;
+    const char* out_dir = ".";
+    const char* format = "png";
+    int angles = 8;
+    long long batch_memory = 2048;
+    const char* camera_path = NULL;
+    const char* snapshot_path = NULL;
+    const char* trace_path = NULL;
+    const char* reference_path = NULL;
+    const char* bench_path = NULL;
+    int tolerance = 0;
+    int frames = 500;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            settings.headless = 1;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+        {
+            camera_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc)
+        {
+            snapshot_path = argv[++i];
+            char name[1024];
+            if (frame_path(snapshot_path, 0, name, sizeof(name)) < 0)
+            {
+                SDL_Log("Error 32: Snapshot Name May Hold One %%d Or %%0Nd And %%%% Only");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+        {
+            reference_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = atoi(argv[++i]);
+            if (tolerance < 0 || tolerance > 255)
+            {
+                SDL_Log("Error 27: Tolerance Must Be Between 0 And 255");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+        {
+            bench_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+        {
+            settings.generate = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+            settings.trace_path = trace_path;
+        }
+        else if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc)
+        {
+            i++;
+            settings.lod = strcmp(argv[i], "auto") == 0 ? -1 : atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--no-cache") == 0)
+        {
+            settings.mesh_cache = 0;
+        }
+        else if (strcmp(argv[i], "--no-meshlets") == 0)
+        {
+            settings.meshlets = 0;
+        }
+        else if (strcmp(argv[i], "--no-hiz") == 0)
+        {
+            settings.hiz = 0;
+        }
+        else if (strcmp(argv[i], "--compact") == 0)
+        {
+            settings.compact = 1;
+        }
+        else if (strcmp(argv[i], "--occlude") == 0)
+        {
+            settings.occlude = 1;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            settings.threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc)
+        {
+            settings.tile_size = atoi(argv[++i]);
+            if (settings.tile_size < 8 || settings.tile_size % 8 != 0)
+            {
+                SDL_Log("Error 11: Tile Size Must Be A Multiple Of 8");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+        {
+            settings.frame_budget_ms = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-resolution") == 0 && i + 1 < argc)
+        {
+            settings.min_resolution = atof(argv[++i]);
+            if (!(settings.min_resolution > 0 && settings.min_resolution <= 1))
+            {
+                SDL_Log("Error 16: Resolution Must Be Between 0 And 1");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--supersample") == 0 && i + 1 < argc)
+        {
+            settings.still_resolution = atof(argv[++i]);
+            if (!(settings.still_resolution >= 1 && settings.still_resolution <= 4))
+            {
+                SDL_Log("Error 17: Supersampling Must Be Between 1 And 4");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "lines") == 0) {settings.rendermode = RENDER_LINES;}
+            else if (strcmp(argv[i], "fill") == 0) {settings.rendermode = FILL_POLYGONS;}
+            else if (strcmp(argv[i], "both") == 0) {settings.rendermode = RENDER_LINES | FILL_POLYGONS;}
+            else
+            {
+                SDL_Log("Error 34: Unknown Value %s For %s", argv[i], argv[i - 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "all") == 0) {settings.edges = EDGES_ALL;}
+            else if (strcmp(argv[i], "unique") == 0) {settings.edges = EDGES_UNIQUE;}
+            else if (strcmp(argv[i], "feature") == 0) {settings.edges = EDGES_FEATURE;}
+            else if (strcmp(argv[i], "silhouette") == 0) {settings.edges = EDGES_SILHOUETTE;}
+            else
+            {
+                SDL_Log("Error 34: Unknown Value %s For %s", argv[i], argv[i - 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--feature-angle") == 0 && i + 1 < argc)
+        {
+            settings.feature_angle = atoi(argv[++i]);
+            if (settings.feature_angle < 0 || settings.feature_angle > 180)
+            {
+                SDL_Log("Error 18: Feature Angle Must Be Between 0 And 180");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (sscanf(argv[i], "%dx%d", &settings.width, &settings.height) != 2 || settings.width < 16 || settings.height < 16 || settings.width > 16384 || settings.height > 16384)
+            {
+                SDL_Log("Error 22: Size Must Be WIDTHxHEIGHT Between 16 And 16384");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batch_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--angles") == 0 && i + 1 < argc)
+        {
+            angles = atoi(argv[++i]);
+            if (angles < 1) {angles = 1;}
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "ppm") == 0) {format = "ppm";}
+            else if (strcmp(argv[i], "png") == 0) {format = "png";}
+            else
+            {
+                SDL_Log("Error 34: Unknown Value %s For %s", argv[i], argv[i - 1]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--batch-memory") == 0 && i + 1 < argc)
+        {
+            batch_memory = atoll(argv[++i]);
+            if (batch_memory < 1) {batch_memory = 1;}
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            SDL_Log("Error 03: Unknown Option %s", argv[i]);
+            return 1;
+        }
+        else
+        {
+            model_path = argv[i];
+        }
+    }
+
+    mesh_t mesh = {0};
+
+    if (batch_path)
+    {
+        //thumbnails for a whole library, no window either
+        return run_batch(batch_path, out_dir, angles, format, batch_memory << 20);
+    }
+
+    if (bench_path)
+    {
+        //the kernels on their own and the whole frame on fixed models, no window either
+        return run_bench(bench_path);
+    }
+
+    if (settings.headless)
+    {
+        //no window, no renderer: draw into a plain heap framebuffer
+        if (load_mesh(model_path, &mesh) != 0) {return 1;}
+        int result = run_headless(&mesh, frames, camera_path, snapshot_path, reference_path, tolerance);
+        if (result == 0 && trace_path && write_trace(trace_path) != 0) {result = 1;}
+        free_mesh(&mesh);
+        return result;
+    }
+    
+    //<initilize SDL>
+    if (!SDL_Init(SDL_INIT_VIDEO))
+    {
+        SDL_Log("Unable to Initilize SDL: %s", SDL_GetError());
+        return 1;
+    }
+
+    SDL_Window* window = SDL_CreateWindow("Prospect Software 3D model viewer", settings.width, settings.height, 0);
+    if (!window) {SDL_Log("Unable to create window: %s", SDL_GetError()); return 1;}
+
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, NULL);
+    if (!renderer)
+    {
+        SDL_Log("Renderer Error: %s", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    //icon
+    SDL_Surface* icon = SDL_LoadBMP("icon.bmp");
+    if (icon == NULL)
+    {
+        printf("No Icon\n");
+    }
+    else
+    {
+        SDL_SetWindowIcon(window, icon);
+    }
+
+    redraw_event = SDL_RegisterEvents(1);
+    int target_fps = settings.target_fps;
+    if (target_fps <= 0)
+    {
+        const SDL_DisplayMode* display_mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+        target_fps = display_mode && display_mode->refresh_rate > 0 ? (int) display_mode->refresh_rate : 60;
+    }
+    Uint64 frame_interval_ns = 1000000000ull / target_fps;
+
+    //create screen texture
+    //the scene texture is window size, a lower resolution uses its top left part and is scaled up to the window; supersampled
+    //frames are filtered down to window size before they are uploaded
+    SDL_Texture* screen_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, settings.width, settings.height);
+    SDL_SetTextureScaleMode(screen_texture, SDL_SCALEMODE_LINEAR);
+    //the hud goes over it at window size, blended so the scene shows where nothing is drawn
+    SDL_Texture* hud_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, settings.width, settings.height);
+    SDL_SetTextureBlendMode(hud_texture, SDL_BLENDMODE_BLEND);
+    //<initilize SDL>
+
+    mesh_stream_t stream = {0};
+    if (model_path)
+    {
+        //the window stays responsive while the file loads, whatever has arrived is drawn
+        if (start_mesh_stream(&stream, model_path) != 0 && load_mesh(model_path, &mesh) != 0)
+        {
+            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The selected file could not be loaded.", window);
+        }
+    }
+    else
+    {
+        load_mesh(NULL, &mesh);
+        if (settings.generate == NULL) {SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Message", "There is no file selected. Default cube opened.", window);}
+    }
+    
+
+    char running = 1;
+    SDL_Event event;
+    long long fps = 0;
+    long long frame_latency_ms = 0;
+    float mouse_x_new = 0;
+    float mouse_y_new = 0;
+    float mouse_x_old = 0;
+    float mouse_y_old = 0;
+    long long highlighted = -1;
+    color_t highlighted_color = WHITE;
+    //a frame is only drawn when something on screen changed, or while keys are moving the view
+    int redraw = 1;
+    int was_moving = 0;
+    int loading = 0;
+    Uint64 next_frame_ns = 0;
+    Uint64 last_frame_ns = 0;
+    double event_ms = 0;
+    double upload_ms = 0;
+    double present_ms = 0;
+    //outside what was uploaded last the textures are clear, so a frame only uploads where it or the one before drew
+    rect_t scene_uploaded = {0, 0, 0, 0};
+    rect_t hud_uploaded = {0, 0, 0, 0};
+    int uploaded_width = 0; //0 until the first upload, which sends everything
+    int uploaded_height = 0;
+    //fraction of the window size drawn while moving, lowered when frames take longer than the budget
+    float resolution = 1;
+    double budget_ms = settings.frame_budget_ms > 0 ? settings.frame_budget_ms : frame_interval_ns / 1000000.0;
+    //the SDL thread changes only this, each frame is drawn from a copy of it
+    view_state_t view = {.xangle = 0.35f, .yangle = 0.35f, .scale = settings.scale, .perspective = settings.perspective, .occlude = settings.occlude, .rendermode = settings.rendermode, .edges = settings.edges, .profiler = settings.profiler};
+
+    //define buttons
+    button_t buttons[2] = {new_button(0, 100, 30, 20, "Up"), new_button(0, 150, 30, 20, "Down")};
+    button_t buttonup = buttons[0];
+    button_t buttondown = buttons[1];
+
+    //frames are drawn on their own thread while the one before is uploaded and presented here
+    render_thread_t render;
+    if (start_render_thread(&render, buttons, 2) != 0)
+    {
+        stop_mesh_stream(&stream);
+        SDL_Quit();
+        return 1;
+    }
+    while (running)
+    {
+        //sleep until an event when idle, or until the next frame is due when animating; a finished frame is an event too
+        Uint64 now = SDL_GetTicksNS();
+        Sint32 timeout_ms = settings.idle_timeout_ms;
+        if ((redraw || was_moving) && render_idle(&render)) {timeout_ms = next_frame_ns > now ? (Sint32) ((next_frame_ns - now + 999999) / 1000000) : 0;}
+
+        //handle events
+        int have_event = SDL_WaitEventTimeout(&event, timeout_ms);
+        //waiting is not counted, events are added up until the next frame is drawn
+        Uint64 event_start = SDL_GetPerformanceCounter();
+        while (have_event)
+        {
+            if (event.type == redraw_event) {redraw = 1;}
+            switch (event.type)
+            {
+                case SDL_EVENT_QUIT:
+                    running = 0;
+                    break;
+                case SDL_EVENT_WINDOW_EXPOSED:
+                case SDL_EVENT_WINDOW_RESTORED:
+                case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+                    redraw = 1;
+                    break;
+                case SDL_EVENT_MOUSE_BUTTON_DOWN:
+                    //event.button.x and event.button.y for positions in window
+                    if (event.button.button == 1) //left click
+                    {
+                        //kept between 0 and 1, a negative perspective puts the eye behind the model and turns faces_viewer around
+                        if (check_button_pressed(buttonup, event.button.x, event.button.y))
+                        {
+                            view.perspective = min_float(view.perspective + 0.01f, 1);
+                            redraw = 1;
+                        }
+                        if (check_button_pressed(buttondown, event.button.x, event.button.y))
+                        {
+                            view.perspective = max_float(view.perspective - 0.01f, 0);
+                            redraw = 1;
+                        }
+                    }
+                    else if (event.button.button == 2) //middle click
+                    {
+                        //highlight the polygon under the cursor, clicking empty space clears it
+                        wait_render_idle(&render);
+                        if (highlighted >= 0 && highlighted < mesh.number_of_polygons) {set_mesh_color(&mesh, highlighted, highlighted_color);}
+                        point3d at = window_to_target(raster_state.target, event.button.x + 0.5f, event.button.y + 0.5f);
+                        highlighted = pick_polygon(&mesh, &raster_state.matrix, at.x, at.y, NULL);
+                        if (highlighted >= 0)
+                        {
+                            highlighted_color = mesh_color(&mesh, highlighted);
+                            set_mesh_color(&mesh, highlighted, RED);
+                        }
+                        redraw = 1;
+                    }
+                    else if (event.button.button == 3) //right click
+                    {
+                        point3d hit;
+                        wait_render_idle(&render);
+                        point3d at = window_to_target(raster_state.target, event.button.x + 0.5f, event.button.y + 0.5f);
+                        long long picked = pick_polygon(&mesh, &raster_state.matrix, at.x, at.y, &hit);
+                        if (picked >= 0)
+                        {
+                            char buffer[256];
+                            point3d normal = mesh_normal(&mesh, picked);
+                            snprintf(buffer, sizeof(buffer), "Polygon: %lld\nHit: %f %f %f\nNormal: %f %f %f\n", picked, hit.x, hit.y, hit.z, normal.x, normal.y, normal.z);
+                            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Picked Polygon", buffer, window);
+                        }
+                    }
+                    break;
+                case SDL_EVENT_KEY_DOWN:
+                    SDL_Keycode key = event.key.key;
+                    if (event.key.repeat == 0) //one time event
+                    {
+                        if (key == settings.keybind_exit)
+                        {
+                            running = 0;
+                        }
+                        else if (key == settings.keybind_default_view)
+                        {
+                            view.yangle = 0.35;
+                            view.xangle = 0.35;
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_show_view)
+                        {
+                            char buffer[64];
+                            snprintf(buffer, sizeof(buffer), "Xrot: %f\nYrot: %f\nZoom/Scale: %f\n", view.xangle, view.yangle, view.scale);
+                            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Current Rotation", buffer, NULL);
+                        }
+                        else if (key == settings.keybind_switch_xyz)
+                        {
+                            wait_render_idle(&render);
+                            switch_mesh_axes(&mesh);
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_rendermode)
+                        {
+                            //lines, filled, filled with lines
+                            view.rendermode = view.rendermode == RENDER_LINES ? FILL_POLYGONS : view.rendermode == FILL_POLYGONS ? (RENDER_LINES | FILL_POLYGONS) : RENDER_LINES;
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_edges)
+                        {
+                            //every outline, each edge once, feature edges, silhouettes
+                            view.edges = (view.edges + 1) % 4;
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_occlude)
+                        {
+                            view.occlude = !view.occlude;
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_profiler)
+                        {
+                            view.profiler = !view.profiler;
+                            redraw = 1;
+                        }
+                        else if (key == settings.keybind_trace)
+                        {
+                            wait_render_idle(&render);
+                            if (write_trace(settings.trace_path) == 0)
+                            {
+                                char buffer[1100];
+                                snprintf(buffer, sizeof(buffer), "Trace written to %s\nOpen it in chrome://tracing or ui.perfetto.dev", settings.trace_path);
+                                SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Trace", buffer, window);
+                            }
+                            else
+                            {
+                                SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The trace could not be written.", window);
+                            }
+                        }
+                        else if (key == settings.keybind_debug)
+                        {
+                            char buffer[512];
+                            wait_render_idle(&render);
+                            snprintf(buffer, sizeof(buffer), "Frames Per Second: %lld\nLatency: %lldms\nEvents: %.2fms\nClear: %.2fms\nTransform: %.2fms\nCull: %.2fms\nRaster: %.2fms\nUpload: %.2fms\nPresent: %.2fms\n"
+                                "LOD: %d/%d Drawn: %lld Culled: %lld/%lld/%lld Skipped: %lld Meshlets: %lld/%lld Occluded: %lld\nTiles: %d Threads: %d Steals: %d\nTile ms max/mean: %.2f/%.2f\nThread ms max/mean: %.2f/%.2f",
+                                fps, frame_latency_ms, frame_timing.event_ms, frame_timing.clear_ms, frame_timing.transform_ms, frame_timing.cull_ms, frame_timing.raster_ms, frame_timing.upload_ms, frame_timing.present_ms,
+                                raster_stats.lod_level, raster_stats.lod_levels, raster_stats.visible_polygons, raster_stats.culled.backface, raster_stats.culled.outside, raster_stats.culled.behind, raster_stats.bvh_skipped, raster_stats.meshlets_culled, raster_stats.meshlets, raster_stats.occlusion_culled,
+                                raster_stats.tiles, raster_stats.threads, raster_stats.steals, raster_stats.max_tile_ms, raster_stats.mean_tile_ms, raster_stats.max_thread_ms, raster_stats.mean_thread_ms);
+                            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "DEBUG", buffer, NULL);
+                        }
+                    }
+                    break;
+            }
+            have_event = SDL_PollEvent(&event);
+        }
+        event_ms += profile_end("events", event_start, -1);
+
+        //never waits on the loader, a finished mesh is swapped in here while nothing is being drawn from the old one
+        if (render_idle(&render))
+        {
+            int streaming = stream.thread != NULL;
+            loading = poll_mesh_stream(&stream, &mesh);
+            //a highlight picked before the swap names a polygon of the mesh that was replaced
+            if (streaming && loading == 0) {highlighted = -1;}
+            if (loading < 0)
+            {
+                SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "The selected file could not be loaded.", window);
+                loading = 0;
+            }
+        }
+
+        //held keys move the view every frame, and the full detail level is drawn once they are let go
+        const bool* keystate = SDL_GetKeyboardState(NULL);
+        int moving = keystate[settings.keybind_yrotate_minus] || keystate[settings.keybind_yrotate_plus] || keystate[settings.keybind_xrotate_plus] || keystate[settings.keybind_xrotate_minus]
+            || keystate[settings.keybind_zoom_in] || keystate[settings.keybind_zoom_out];
+        if (was_moving && !moving) {redraw = 1;}
+        was_moving = moving;
+
+        //the newest finished frame is kept out of the ring until it has been uploaded
+        int shown = take_frame(&render);
+        if (shown >= 0 && render.views[shown].moving) {resolution = adjust_resolution(resolution, render.frame_ms[shown], budget_ms);}
+
+        //the next frame is started before the finished one is uploaded, so both run at once
+        now = SDL_GetTicksNS();
+        if (running && (redraw || moving) && now >= next_frame_ns && render_idle(&render))
+        {
+            //real-time keys
+            if (keystate[settings.keybind_yrotate_minus]) {view.yangle -= settings.sensitivity;}
+            if (keystate[settings.keybind_yrotate_plus]) {view.yangle += settings.sensitivity;}
+            if (keystate[settings.keybind_xrotate_plus]) {view.xangle += settings.sensitivity;}
+            if (keystate[settings.keybind_xrotate_minus]) {view.xangle -= settings.sensitivity;}
+            if (keystate[settings.keybind_zoom_in]) {view.scale = view.scale + (100 * settings.sensitivity);}
+            if (keystate[settings.keybind_zoom_out]) {view.scale = view.scale < 1 ? 1: view.scale - (100 * settings.sensitivity);}
+
+            //check if right mouse button is being held for mouse rotation
+            SDL_MouseButtonFlags mbf = SDL_GetMouseState(&mouse_x_new, &mouse_y_new);
+            if (((mbf & 0b0100) >> 2) == 1)
+            {
+                //rotate based on difference of new and old mouse positions
+
+            }
+
+            view.moving = moving;
+            view.mesh = loading ? &stream.preview : &mesh;
+            view.loading = loading;
+            view.loaded = stream.preview.number_of_polygons;
+            view.total = SDL_GetAtomicInt(&stream.total);
+            view.fps = fps;
+            view.event_ms = event_ms;
+            view.upload_ms = upload_ms;
+            view.present_ms = present_ms;
+            view.resolution = moving ? resolution : settings.still_resolution;
+            view.submitted_ns = now;
+            if (submit_frame(&render, &view) == 0)
+            {
+                redraw = 0;
+                event_ms = 0;
+                //the next frame is due one interval after this one started, so a slow frame is not delayed further
+                next_frame_ns = now + frame_interval_ns;
+            }
+        }
+
+        if (shown >= 0)
+        {
+            Uint64 upload_start = SDL_GetPerformanceCounter();
+            //a supersampled frame is shown filtered down, the texture then holds all of it
+            int resolved = render.views[shown].resolution > 1 && render.resolved[shown].pixels;
+            render_target_t* scene = resolved ? &render.resolved[shown] : &render.scenes[shown];
+            render_target_t* hud = &render.huds[shown];
+            rect_t scene_rect = union_rect(scene_uploaded, scene->dirty);
+            rect_t hud_rect = union_rect(hud_uploaded, hud->dirty);
+            if (uploaded_width == 0) {hud_rect = (rect_t) {0, 0, hud->width, hud->height};}
+            if (scene->width != uploaded_width || scene->height != uploaded_height) {scene_rect = (rect_t) {0, 0, scene->width, scene->height};}
+            upload_rect(screen_texture, scene, scene_rect);
+            upload_rect(hud_texture, hud, hud_rect);
+            scene_uploaded = scene->dirty;
+            hud_uploaded = hud->dirty;
+            uploaded_width = scene->width;
+            uploaded_height = scene->height;
+            SDL_RenderClear(renderer);
+            SDL_RenderTexture(renderer, screen_texture, &(SDL_FRect) {0, 0, (float) scene->width, (float) scene->height}, NULL);
+            SDL_RenderTexture(renderer, hud_texture, NULL, NULL);
+            upload_ms = profile_end("upload", upload_start, -1);
+            Uint64 present_start = SDL_GetPerformanceCounter();
+            SDL_RenderPresent(renderer);
+            present_ms = profile_end("present", present_start, -1);
+
+            //latency from the input being taken to the frame on screen, fps from one presented frame to the next
+            Uint64 shown_ns = SDL_GetTicksNS();
+            frame_latency_ms = (shown_ns - render.views[shown].submitted_ns) / 1000000;
+            fps = last_frame_ns ? 1000000000 / (shown_ns - last_frame_ns > 0 ? shown_ns - last_frame_ns : 1) : 0;
+            last_frame_ns = shown_ns;
+            release_frame(&render, shown);
+        }
+    }
+
+    //end the SDL stuff and heap
+    stop_render_thread(&render);
+    stop_thread_pool();
+    stop_mesh_stream(&stream);
+    free_mesh(&mesh);
+
+    SDL_DestroySurface(icon);
+    SDL_DestroyTexture(screen_texture);
+    SDL_DestroyTexture(hud_texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
+
+
+
+void polyrender(render_target_t* target, mesh_t* mesh, float xangle, float yangle, uint8_t mode)
+{
+    raster_state_t* state = &raster_state;
+    thread_pool_t* pool = get_thread_pool();
+
+    //screen positions of the unique vertices and their rotated positions, kept between frames so they only grow with the mesh
+    if (reserve_vertex_stream(&state->projected, mesh->number_of_vertices) != 0) {return;}
+    if (reserve_vertex_stream(&state->rotated, mesh->number_of_vertices) != 0) {return;}
+
+    //bvh nodes outside the view are skipped before anything is transformed
+    Uint64 bvh_start = SDL_GetPerformanceCounter();
+    state->target = target;
+    state->matrix = build_view_matrix(target, xangle, yangle);
+    state->projection = build_projection(target);
+    bvh_collect_runs(state, mesh);
+    long long bvh_in_view = state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+    frame_timing.cull_ms = profile_end("bvh", bvh_start, 0);
+    //then the meshlets in them that are off screen or turned away
+    Uint64 meshlet_start = SDL_GetPerformanceCounter();
+    int meshlets = settings.meshlets && mesh->meshlets && cull_meshlets(state, mesh) == 0;
+    long long meshlets_in_view = state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+    //a filled frame with meshlets can leave the ones hidden behind last frame's visible set for later
+    int hiz = meshlets && settings.hiz && (mode & FILL_POLYGONS) && split_meshlets(state, mesh);
+    frame_timing.cull_ms += profile_end("meshlets", meshlet_start, 0);
+
+    //every shared vertex is transformed once, with one matrix built per frame
+    Uint64 transform_start = SDL_GetPerformanceCounter();
+    //what was rotated in this rotation is kept, compact positions are dequantized by the rotation itself
+    update_transform_cache(state, mesh);
+    view_matrix_t rotation = rotation_matrix(&state->matrix);
+    view_matrix_t vertex_matrix = mesh->qx ? quantized_matrix(&rotation, mesh) : rotation;
+    long long in_view = state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+    if (mesh->number_of_vertices > state->vertex_stamps_allocated)
+    {
+        uint32_t* stamps = calloc(mesh->number_of_vertices, sizeof(uint32_t));
+        if (stamps)
+        {
+            free(state->vertex_stamps);
+            state->vertex_stamps = stamps;
+            state->vertex_stamps_allocated = mesh->number_of_vertices;
+            state->stamp = 0;
+        }
+    }
+    if (meshlets)
+    {
+        if (state->vertex_stamps_allocated >= mesh->number_of_vertices && ++state->stamp == 0)
+        {
+            memset(state->vertex_stamps, 0, sizeof(uint32_t) * state->vertex_stamps_allocated);
+            state->stamp = 1;
+        }
+        transform_meshlets(state, mesh, &vertex_matrix, MESHLET_EARLY);
+    }
+    else if (in_view < mesh->number_of_polygons / 8 && state->vertex_stamps_allocated >= mesh->number_of_vertices)
+    {
+        //zoomed in on a small part, only its vertices are transformed; the scalar kernel gives the same bits as the others
+        if (++state->stamp == 0)
+        {
+            memset(state->vertex_stamps, 0, sizeof(uint32_t) * state->vertex_stamps_allocated);
+            state->stamp = 1;
+        }
+        for (long long r = 0; r < state->number_of_runs; r++)
+        {
+            for (long long i = state->runs[r].first; i < state->runs[r].last; i++)
+            {
+                uint32_t index[3];
+                mesh_indices(mesh, i, index);
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = index[k];
+                    if (state->vertex_stamps[v] == state->stamp) {continue;}
+                    state->vertex_stamps[v] = state->stamp;
+                    transform_range(state, mesh, &vertex_matrix, v, 1, 1);
+                }
+            }
+        }
+    }
+    else if (state->projected_all != state->projection_epoch)
+    {
+        transform_range(state, mesh, &vertex_matrix, 0, mesh->number_of_vertices, state->rotated_all != state->rotation_epoch);
+        state->rotated_all = state->rotation_epoch;
+        state->projected_all = state->projection_epoch;
+    }
+    frame_timing.transform_ms = profile_end("transform", transform_start, 0);
+
+    //depth buffer next to the framebuffer, larger z is nearer, each tile clears its own part
+    long long target_pixels = (long long) target->width * target->height;
+    if ((mode & FILL_POLYGONS) && state->depth_allocated < target_pixels)
+    {
+        free(state->depth);
+        state->depth = malloc(sizeof(float) * target_pixels);
+        state->depth_allocated = state->depth ? target_pixels : 0;
+        if (state->depth == NULL) {return;}
+    }
+    state->mesh = mesh;
+    state->mode = mode;
+    //lines sit exactly on the filled surface, so they get a little depth slack
+    point3d size = {mesh->high.x - mesh->low.x, mesh->high.y - mesh->low.y, mesh->high.z - mesh->low.z};
+    state->line_bias = 0.002f * sqrtf(size.x * size.x + size.y * size.y + size.z * size.z);
+
+    if (mesh->number_of_polygons > state->visible_allocated)
+    {
+        uint32_t* visible = realloc(state->visible, sizeof(uint32_t) * mesh->number_of_polygons);
+        if (visible == NULL) {return;}
+        state->visible = visible;
+        state->visible_allocated = mesh->number_of_polygons;
+    }
+    //every edge has two polygons, the frame stamps of the ones that were drawn decide which of them draws it
+    state->edges = settings.edges != EDGES_ALL && mesh->neighbors && (mode & RENDER_LINES);
+    if (state->edges && mesh->number_of_polygons > state->polygon_stamps_allocated)
+    {
+        uint32_t* stamps = calloc(mesh->number_of_polygons, sizeof(uint32_t));
+        uint8_t* masks = malloc(mesh->number_of_polygons);
+        if (stamps && masks)
+        {
+            free(state->polygon_stamps);
+            free(state->edge_masks);
+            state->polygon_stamps = stamps;
+            state->edge_masks = masks;
+            state->polygon_stamps_allocated = mesh->number_of_polygons;
+            state->polygon_stamp = 0;
+        }
+        else
+        {
+            //falls back to drawing every outline
+            free(stamps);
+            free(masks);
+            state->edges = 0;
+        }
+    }
+    if (state->edges && ++state->polygon_stamp == 0)
+    {
+        memset(state->polygon_stamps, 0, sizeof(uint32_t) * state->polygon_stamps_allocated);
+        state->polygon_stamp = 1;
+    }
+
+    state->tile_size = settings.tile_size;
+    state->tiles_x = (target->width + state->tile_size - 1) / state->tile_size;
+    state->tiles_y = (target->height + state->tile_size - 1) / state->tile_size;
+    int tiles = state->tiles_x * state->tiles_y;
+    state->chunks = pool->number_of_threads + 1;
+    if (state->chunk_culls == NULL)
+    {
+        state->chunk_culls = calloc(state->chunks, sizeof(cull_counts_t));
+        state->chunk_visible = calloc(state->chunks, sizeof(long long));
+        state->chunk_early_visible = calloc(state->chunks, sizeof(long long));
+        state->chunk_lines = calloc(state->chunks, sizeof(long long));
+        if (state->chunk_culls == NULL || state->chunk_visible == NULL || state->chunk_early_visible == NULL || state->chunk_lines == NULL)
+        {
+            free(state->chunk_culls);
+            free(state->chunk_visible);
+            free(state->chunk_early_visible);
+            free(state->chunk_lines);
+            state->chunk_culls = NULL;
+            state->chunk_visible = NULL;
+            state->chunk_early_visible = NULL;
+            state->chunk_lines = NULL;
+            return;
+        }
+    }
+    //the late phase bins into a second set, the early bins still have to outline their polygons after it
+    int bin_sets = hiz ? 2 : 1;
+    if (bin_sets * state->chunks * tiles > state->bins_allocated)
+    {
+        //tile counts change with the tile size and the resolution, bins keep their capacity between frames
+        tile_bin_t* bins = realloc(state->bins, sizeof(tile_bin_t) * bin_sets * state->chunks * tiles);
+        long long* tile_polygons = realloc(state->tile_polygons, sizeof(long long) * tiles);
+        long long* tile_pixels = realloc(state->tile_pixels, sizeof(long long) * tiles);
+        double* tile_ms = realloc(state->tile_ms, sizeof(double) * tiles);
+        if (bins) {state->bins = bins;}
+        if (tile_polygons) {state->tile_polygons = tile_polygons;}
+        if (tile_pixels) {state->tile_pixels = tile_pixels;}
+        if (tile_ms) {state->tile_ms = tile_ms;}
+        if (bins == NULL || tile_polygons == NULL || tile_pixels == NULL || tile_ms == NULL) {return;}
+        memset(state->bins + state->bins_allocated, 0, sizeof(tile_bin_t) * (bin_sets * state->chunks * tiles - state->bins_allocated));
+        state->bins_allocated = bin_sets * state->chunks * tiles;
+    }
+
+    frame_timing.raster_ms = 0;
+    state->phase = hiz ? 1 : 0;
+    state->visible_base = 0;
+    draw_phase(state, pool, tiles);
+    cull_counts_t culled = {0};
+    state->meshlets_occluded = 0;
+    state->occlusion_culled = 0;
+    if (meshlets && settings.hiz && (mode & FILL_POLYGONS))
+    {
+        //the depth of the early meshlets becomes the pyramid, drawn at once the frame only tells the next one what is seen
+        Uint64 hiz_start = SDL_GetPerformanceCounter();
+        build_depth_pyramid(state, pool);
+        occlude_meshlets(state, mesh);
+        frame_timing.cull_ms += profile_end("hi-z", hiz_start, 0);
+    }
+    if (hiz)
+    {
+        //the late meshlets that were not occluded are transformed and drawn into the same depth, early edges wait for them
+        for (int chunk = 0; chunk < state->chunks; chunk++)
+        {
+            culled.backface += state->chunk_culls[chunk].backface;
+            culled.outside += state->chunk_culls[chunk].outside;
+            culled.behind += state->chunk_culls[chunk].behind;
+            state->chunk_early_visible[chunk] = state->chunk_visible[chunk];
+        }
+        state->early_visible = in_view;
+        select_meshlet_runs(state, MESHLET_LATE);
+        transform_start = SDL_GetPerformanceCounter();
+        transform_meshlets(state, mesh, &vertex_matrix, MESHLET_LATE);
+        frame_timing.transform_ms += profile_end("transform", transform_start, 0);
+        state->phase = 2;
+        state->visible_base = in_view;
+        in_view += state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+        draw_phase(state, pool, tiles);
+    }
+
+    raster_stats.tiles = tiles;
+    raster_stats.threads = state->chunks;
+    raster_stats.steals = SDL_GetAtomicInt(&pool->steals);
+    raster_stats.max_tile_polygons = 0;
+    raster_stats.mean_tile_polygons = 0;
+    raster_stats.max_tile_ms = 0;
+    raster_stats.mean_tile_ms = 0;
+    raster_stats.pixels = 0;
+    for (int tile = 0; tile < tiles; tile++)
+    {
+        if (state->tile_pixels[tile] > 0)
+        {
+            rect_t rect;
+            rect.x0 = (tile % state->tiles_x) * state->tile_size;
+            rect.y0 = (tile / state->tiles_x) * state->tile_size;
+            rect.x1 = rect.x0 + state->tile_size;
+            rect.y1 = rect.y0 + state->tile_size;
+            mark_dirty(target, rect);
+        }
+        raster_stats.pixels += state->tile_pixels[tile];
+        if (state->tile_polygons[tile] > raster_stats.max_tile_polygons) {raster_stats.max_tile_polygons = state->tile_polygons[tile];}
+        if (state->tile_ms[tile] > raster_stats.max_tile_ms) {raster_stats.max_tile_ms = state->tile_ms[tile];}
+        raster_stats.mean_tile_polygons += (double) state->tile_polygons[tile] / tiles;
+        raster_stats.mean_tile_ms += state->tile_ms[tile] / tiles;
+    }
+    raster_stats.visible_polygons = in_view;
+    raster_stats.bvh_skipped = mesh->number_of_polygons - bvh_in_view;
+    raster_stats.meshlets = meshlets ? mesh->number_of_meshlets : 0;
+    raster_stats.meshlets_culled = meshlets ? state->meshlets_culled : 0;
+    raster_stats.meshlet_skipped = bvh_in_view - meshlets_in_view;
+    raster_stats.meshlets_occluded = state->meshlets_occluded;
+    raster_stats.rotated_vertices = state->rotated_count;
+    raster_stats.projected_vertices = state->projected_count;
+    raster_stats.occlusion_culled = state->occlusion_culled;
+    raster_stats.culled = culled;
+    for (int chunk = 0; chunk < state->chunks; chunk++)
+    {
+        raster_stats.culled.backface += state->chunk_culls[chunk].backface;
+        raster_stats.culled.outside += state->chunk_culls[chunk].outside;
+        raster_stats.culled.behind += state->chunk_culls[chunk].behind;
+    }
+    raster_stats.visible_polygons -= raster_stats.culled.backface + raster_stats.culled.outside + raster_stats.culled.behind;
+    raster_stats.submitted = mesh->number_of_polygons;
+    //each tile draws the part of an edge inside it, so lines are counted per polygon rather than per tile
+    raster_stats.lines = (mode & RENDER_LINES) ? raster_stats.visible_polygons * 3 : 0;
+    if (state->edges)
+    {
+        raster_stats.lines = 0;
+        for (int chunk = 0; chunk < state->chunks; chunk++) {raster_stats.lines += state->chunk_lines[chunk];}
+    }
+    raster_stats.max_thread_ms = 0;
+    raster_stats.mean_thread_ms = 0;
+    for (int k = 0; k < state->chunks; k++)
+    {
+        if (pool->busy_ms[k] > raster_stats.max_thread_ms) {raster_stats.max_thread_ms = pool->busy_ms[k];}
+        raster_stats.mean_thread_ms += pool->busy_ms[k] / state->chunks;
+    }
+}
+
+void draw_phase(raster_state_t* state, thread_pool_t* pool, int tiles)
+{
+    //cull, bin every polygon into the tiles its screen bounds touch, then rasterize tiles independently
+    Uint64 cull_start = SDL_GetPerformanceCounter();
+    pool_run(pool, cull_chunk, state, state->chunks);
+    frame_timing.cull_ms += profile_end("cull", cull_start, 0);
+    Uint64 raster_start = SDL_GetPerformanceCounter();
+    pool_run(pool, bin_polygons, state, state->chunks);
+    profile_end("bin", raster_start, 0);
+    pool_run(pool, raster_tile, state, tiles);
+    frame_timing.raster_ms += profile_end("raster", raster_start, 0);
+}
+
+void cull_chunk(void* data, int chunk, int worker)
+{
+    raster_state_t* state = data;
+
+    //this chunk takes an equal share of the polygons in the bvh runs
+    long long total = state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+    long long share_first = total * chunk / state->chunks;
+    long long share_last = total * (chunk + 1) / state->chunks;
+    uint32_t* visible = state->visible + state->visible_base + share_first;
+    state->chunk_culls[chunk] = (cull_counts_t) {0};
+    long long low = 0;
+    long long high = state->number_of_runs;
+    while (high - low > 1)
+    {
+        long long middle = (low + high) / 2;
+        if (state->run_offsets[middle] <= share_first) {low = middle;}
+        else {high = middle;}
+    }
+    long long count = 0;
+    for (long long r = low; r < state->number_of_runs && state->run_offsets[r] < share_last; r++)
+    {
+        long long first = state->runs[r].first + (share_first > state->run_offsets[r] ? share_first - state->run_offsets[r] : 0);
+        long long last = state->runs[r].first + (share_last < state->run_offsets[r + 1] ? share_last - state->run_offsets[r] : state->runs[r].last - state->runs[r].first);
+#ifdef HAVE_X86_SIMD
+        count += SDL_HasSSE2() ? cull_polygons_sse2(state, first, last, visible + count, &state->chunk_culls[chunk])
+                               : cull_polygons(state, first, last, visible + count, &state->chunk_culls[chunk]);
+#else
+        count += cull_polygons(state, first, last, visible + count, &state->chunk_culls[chunk]);
+#endif
+    }
+    state->chunk_visible[chunk] = count;
+    if (state->edges)
+    {
+        for (long long k = 0; k < count; k++) {state->polygon_stamps[visible[k]] = state->polygon_stamp;}
+    }
+}
+
+void bin_polygons(void* data, int chunk, int worker)
+{
+    raster_state_t* state = data;
+    int tiles = state->tiles_x * state->tiles_y;
+    tile_bin_t* bins = state->bins + ((state->phase == 2 ? state->chunks : 0) + (long long) chunk) * tiles;
+    for (int tile = 0; tile < tiles; tile++) {bins[tile].count = 0;}
+
+    //the polygons this chunk kept in cull_chunk
+    long long total = state->number_of_runs ? state->run_offsets[state->number_of_runs] : 0;
+    uint32_t* visible = state->visible + state->visible_base + total * chunk / state->chunks;
+    long long count = state->chunk_visible[chunk];
+    float* x = state->projected.x;
+    float* y = state->projected.y;
+    long long lines = 0;
+    if (state->edges && state->phase == 2)
+    {
+        //the early polygons were binned before the late ones were stamped, their edges are settled here
+        uint32_t* early = state->visible + state->early_visible * chunk / state->chunks;
+        for (long long k = 0; k < state->chunk_early_visible[chunk]; k++)
+        {
+            int mask = polygon_edges(state, early[k]);
+            state->edge_masks[early[k]] = (uint8_t) mask;
+            lines += (mask & 1) + (mask >> 1 & 1) + (mask >> 2);
+        }
+    }
+    for (long long k = 0; k < count; k++)
+    {
+        uint32_t i = visible[k];
+        if (state->edges && state->phase != 1)
+        {
+            //every chunk has finished culling, so the stamps of the polygons across the edges are final
+            int mask = polygon_edges(state, i);
+            state->edge_masks[i] = (uint8_t) mask;
+            lines += (mask & 1) + (mask >> 1 & 1) + (mask >> 2);
+            //a polygon that is only outlined and draws none of its edges has nothing to do in any tile
+            if (mask == 0 && !(state->mode & FILL_POLYGONS)) {continue;}
+        }
+        uint32_t index[3];
+        mesh_indices(state->mesh, i, index);
+        float min_x = min_float(x[index[0]], min_float(x[index[1]], x[index[2]]));
+        float max_x = max_float(x[index[0]], max_float(x[index[1]], x[index[2]]));
+        float min_y = min_float(y[index[0]], min_float(y[index[1]], y[index[2]]));
+        float max_y = max_float(y[index[0]], max_float(y[index[1]], y[index[2]]));
+
+        int tile_x0 = min_x < 0 ? 0 : (int) min_x / state->tile_size;
+        int tile_y0 = min_y < 0 ? 0 : (int) min_y / state->tile_size;
+        int tile_x1 = max_x >= state->target->width ? state->tiles_x - 1 : (int) max_x / state->tile_size;
+        int tile_y1 = max_y >= state->target->height ? state->tiles_y - 1 : (int) max_y / state->tile_size;
+        for (int ty = tile_y0; ty <= tile_y1; ty++)
+        {
+            for (int tx = tile_x0; tx <= tile_x1; tx++)
+            {
+                tile_bin_t* bin = &bins[tx + ty * state->tiles_x];
+                if (bin->count == bin->capacity)
+                {
+                    int capacity = bin->capacity ? bin->capacity * 2 : 256;
+                    uint32_t* items = realloc(bin->items, sizeof(uint32_t) * capacity);
+                    if (items == NULL) {continue;}
+                    bin->items = items;
+                    bin->capacity = capacity;
+                }
+                bin->items[bin->count++] = i;
+            }
+        }
+    }
+    state->chunk_lines[chunk] = lines;
+}
+
+long long cull_polygons(raster_state_t* state, long long first, long long last, uint32_t* visible, cull_counts_t* culled)
+{
+    //keeps polygons that are in front of the perspective plane, touch the screen and, with occlude, face the viewer
+    float* x = state->projected.x;
+    float* y = state->projected.y;
+    float* z = state->projected.z;
+    float p = settings.perspective;
+    long long count = 0;
+    for (long long i = first; i < last; i++)
+    {
+        uint32_t index[3];
+        mesh_indices(state->mesh, i, index);
+        uint32_t a = index[0];
+        uint32_t b = index[1];
+        uint32_t c = index[2];
+        //w = 2 - z * p, a vertex at or past w = 0 has no usable screen position
+        if (p * z[a] >= 2 || p * z[b] >= 2 || p * z[c] >= 2) {culled->behind++; continue;}
+        float min_x = min_float(x[a], min_float(x[b], x[c]));
+        float max_x = max_float(x[a], max_float(x[b], x[c]));
+        float min_y = min_float(y[a], min_float(y[b], y[c]));
+        float max_y = max_float(y[a], max_float(y[b], y[c]));
+        //min_float and max_float do not see nan, so the sums catch it
+        float sum = x[a] + x[b] + x[c] + y[a] + y[b] + y[c];
+        if (!(sum == sum && max_x >= 0 && max_y >= 0 && min_x < state->target->width && min_y < state->target->height)) {culled->outside++; continue;}
+        //screen y points down, so a polygon facing the viewer winds clockwise and has negative area
+        float area = (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
+        if (settings.occlude && !(area < 0)) {culled->backface++; continue;}
+        visible[count++] = (uint32_t) i;
+    }
+    return count;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+long long cull_polygons_sse2(raster_state_t* state, long long first, long long last, uint32_t* visible, cull_counts_t* culled)
+{
+    //the same tests as cull_polygons on four polygons at a time, only the vertex fetch is scalar
+    float* x = state->projected.x;
+    float* y = state->projected.y;
+    float* z = state->projected.z;
+    const mesh_t* mesh = state->mesh;
+    __m128 p = _mm_set1_ps(settings.perspective);
+    __m128 two = _mm_set1_ps(2);
+    __m128 zero = _mm_setzero_ps();
+    __m128 width = _mm_set1_ps(state->target->width);
+    __m128 height = _mm_set1_ps(state->target->height);
+    int occlude = settings.occlude ? 0xf : 0;
+    long long count = 0;
+    long long i = first;
+    for (; i + 4 <= last; i += 4)
+    {
+        uint32_t index[12];
+        for (int k = 0; k < 4; k++) {mesh_indices(mesh, i + k, &index[k * 3]);}
+        __m128 ax = _mm_setr_ps(x[index[0]], x[index[3]], x[index[6]], x[index[9]]);
+        __m128 bx = _mm_setr_ps(x[index[1]], x[index[4]], x[index[7]], x[index[10]]);
+        __m128 cx = _mm_setr_ps(x[index[2]], x[index[5]], x[index[8]], x[index[11]]);
+        __m128 ay = _mm_setr_ps(y[index[0]], y[index[3]], y[index[6]], y[index[9]]);
+        __m128 by = _mm_setr_ps(y[index[1]], y[index[4]], y[index[7]], y[index[10]]);
+        __m128 cy = _mm_setr_ps(y[index[2]], y[index[5]], y[index[8]], y[index[11]]);
+        __m128 az = _mm_setr_ps(z[index[0]], z[index[3]], z[index[6]], z[index[9]]);
+        __m128 bz = _mm_setr_ps(z[index[1]], z[index[4]], z[index[7]], z[index[10]]);
+        __m128 cz = _mm_setr_ps(z[index[2]], z[index[5]], z[index[8]], z[index[11]]);
+
+        __m128 behind = _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(_mm_mul_ps(p, az), two), _mm_cmpge_ps(_mm_mul_ps(p, bz), two)), _mm_cmpge_ps(_mm_mul_ps(p, cz), two));
+        __m128 min_x = _mm_min_ps(ax, _mm_min_ps(bx, cx));
+        __m128 max_x = _mm_max_ps(ax, _mm_max_ps(bx, cx));
+        __m128 min_y = _mm_min_ps(ay, _mm_min_ps(by, cy));
+        __m128 max_y = _mm_max_ps(ay, _mm_max_ps(by, cy));
+        //min/max can drop a nan, so the sums catch it
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(ax, bx), _mm_add_ps(cx, ay)), _mm_add_ps(by, cy));
+        __m128 inside = _mm_and_ps(_mm_cmpord_ps(sum, sum), _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(max_x, zero), _mm_cmpge_ps(max_y, zero)), _mm_and_ps(_mm_cmplt_ps(min_x, width), _mm_cmplt_ps(min_y, height))));
+        __m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(bx, ax), _mm_sub_ps(cy, ay)), _mm_mul_ps(_mm_sub_ps(by, ay), _mm_sub_ps(cx, ax)));
+        __m128 front = _mm_cmplt_ps(area, zero);
+
+        int behind_mask = _mm_movemask_ps(behind);
+        int outside_mask = ~_mm_movemask_ps(inside) & ~behind_mask & 0xf;
+        int backface_mask = ~_mm_movemask_ps(front) & occlude & ~behind_mask & ~outside_mask & 0xf;
+        int keep = ~(behind_mask | outside_mask | backface_mask) & 0xf;
+        culled->behind += __builtin_popcount(behind_mask);
+        culled->outside += __builtin_popcount(outside_mask);
+        culled->backface += __builtin_popcount(backface_mask);
+        for (int k = 0; k < 4; k++)
+        {
+            if (keep & (1 << k)) {visible[count++] = (uint32_t) (i + k);}
+        }
+    }
+    return count + cull_polygons(state, i, last, visible + count, culled);
+}
+#endif
+
+void raster_tile(void* data, int tile, int worker)
+{
+    //a tile owns its pixels and depth, so no locking; chunks are walked in order to keep submission order
+    raster_state_t* state = data;
+    Uint64 start = SDL_GetPerformanceCounter();
+    int tiles = state->tiles_x * state->tiles_y;
+    rect_t clip;
+    clip.x0 = (tile % state->tiles_x) * state->tile_size;
+    clip.y0 = (tile / state->tiles_x) * state->tile_size;
+    clip.x1 = clip.x0 + state->tile_size > state->target->width ? state->target->width : clip.x0 + state->tile_size;
+    clip.y1 = clip.y0 + state->tile_size > state->target->height ? state->target->height : clip.y0 + state->tile_size;
+
+    if ((state->mode & FILL_POLYGONS) && state->phase != 2)
+    {
+        for (int y = clip.y0; y < clip.y1; y++)
+        {
+            float* row = state->depth + y * state->target->width;
+            for (int x = clip.x0; x < clip.x1; x++) {row[x] = -FLT_MAX;}
+        }
+    }
+
+    long long polygons = 0;
+    long long pixels = 0;
+    //edges go over every fill in the tile, an edge drawn once would otherwise be painted over by the fill of the polygon across it
+    uint8_t passes[2] = {state->mode, 0};
+    if ((state->mode & FILL_POLYGONS) && (state->mode & RENDER_LINES)) {passes[0] = FILL_POLYGONS; passes[1] = RENDER_LINES;}
+    //with hi-z the early phase leaves the edges to the late one, which fills its own bins and then outlines both sets
+    if (state->phase == 1) {passes[1] = 0;}
+    int set = state->phase == 2 ? 1 : 0;
+    for (int chunk = 0; chunk < state->chunks; chunk++)
+    {
+        tile_bin_t* bin = &state->bins[((long long) set * state->chunks + chunk) * tiles + tile];
+        for (int k = 0; k < bin->count; k++)
+        {
+            pixels += raster_polygon(state, bin->items[k], clip, passes[0]);
+        }
+        polygons += bin->count;
+    }
+    if (passes[1]) {pixels += outline_tile(state, tile, clip, state->phase == 2 ? 2 : 1);}
+    //the late phase adds to what the early one drew in the tile
+    double ms = profile_end("tile", start, worker);
+    state->tile_polygons[tile] = (state->phase == 2 ? state->tile_polygons[tile] : 0) + polygons;
+    state->tile_pixels[tile] = (state->phase == 2 ? state->tile_pixels[tile] : 0) + pixels;
+    state->tile_ms[tile] = (state->phase == 2 ? state->tile_ms[tile] : 0) + ms;
+}
+
+long long outline_tile(raster_state_t* state, int tile, rect_t clip, int sets)
+{
+    //outlines the polygons binned into the tile by the first sets bin sets, merged into polygon order: where lines cross the
+    //last one drawn wins, so the order must not depend on which phase a polygon was drawn in. Each set is in polygon order
+    //already, chunk after chunk
+    int tiles = state->tiles_x * state->tiles_y;
+    int chunks[2] = {0, 0};
+    int next[2] = {0, 0};
+    long long pixels = 0;
+    for (;;)
+    {
+        int pick = -1;
+        uint32_t lowest = 0;
+        for (int set = 0; set < sets; set++)
+        {
+            tile_bin_t* bin = NULL;
+            while (chunks[set] < state->chunks)
+            {
+                bin = &state->bins[((long long) set * state->chunks + chunks[set]) * tiles + tile];
+                if (next[set] < bin->count) {break;}
+                chunks[set]++;
+                next[set] = 0;
+            }
+            if (chunks[set] == state->chunks) {continue;}
+            if (pick < 0 || bin->items[next[set]] < lowest)
+            {
+                pick = set;
+                lowest = bin->items[next[set]];
+            }
+        }
+        if (pick < 0) {break;}
+        next[pick]++;
+        pixels += raster_polygon(state, lowest, clip, RENDER_LINES);
+    }
+    return pixels;
+}
+
+long long raster_polygon(raster_state_t* state, long long i, rect_t clip, uint8_t mode)
+{
+    //returns the pixels written
+    mesh_t* mesh = state->mesh;
+    uint32_t index[3];
+    mesh_indices(mesh, i, index);
+    vertex_stream_t* projected = &state->projected;
+    point3d a = {projected->x[index[0]], projected->y[index[0]], projected->z[index[0]]};
+    point3d b = {projected->x[index[1]], projected->y[index[1]], projected->z[index[1]]};
+    point3d c = {projected->x[index[2]], projected->y[index[2]], projected->z[index[2]]};
+    color_t color = mesh_color(mesh, i);
+    long long pixels = 0;
+
+    //render the polygon
+    if (mode & FILL_POLYGONS)
+    {
+        point3d normal = mesh_normal(mesh, i);
+        if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+        {
+            //the file had no normal, take it from the winding
+            point3d p0 = mesh_vertex(mesh, index[0]);
+            point3d p1 = mesh_vertex(mesh, index[1]);
+            point3d p2 = mesh_vertex(mesh, index[2]);
+            point3d u = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+            point3d v = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+            normal = (point3d) {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+        }
+        pixels += fill_triangle(state->target, state->depth, a, b, c, color, rotate_normal(&state->matrix, normal), clip);
+    }
+    if (mode & RENDER_LINES)
+    {
+        //without a fill there is nothing to depth test against
+        float* depth = (state->mode & FILL_POLYGONS) ? state->depth : NULL;
+        uint32_t edges[6] = {index[0], index[1], index[0], index[2], index[2], index[1]};
+        uint32_t ends[6];
+        color_t colors[3];
+        int mask = state->edges ? state->edge_masks[i] : 7;
+        int count = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (!(mask & (1 << k))) {continue;}
+            //the same pixels whichever of its polygons draws an edge: from the lower vertex and in the lower polygon's color
+            uint32_t from = edges[k * 2];
+            uint32_t to = edges[k * 2 + 1];
+            ends[count * 2] = from < to ? from : to;
+            ends[count * 2 + 1] = from < to ? to : from;
+            uint32_t other = mesh->neighbors ? mesh->neighbors[i * 3 + k] : NO_NEIGHBOR;
+            colors[count] = other != NO_NEIGHBOR && other < i ? mesh_color(mesh, other) : color;
+            count++;
+        }
+        if (count) {pixels += draw_lines(state->target, depth, projected, ends, colors, count, state->line_bias, clip);}
+    }
+    return pixels;
+}
+
+int polygon_edges(const raster_state_t* state, uint32_t i)
+{
+    //bit k set when polygon i draws its edge k this frame; an edge between two drawn polygons belongs to the lower one and
+    //otherwise to whichever of them was drawn, so each edge is drawn once however the cull went
+    const mesh_t* mesh = state->mesh;
+    int mask = 0;
+    int front = -1;
+    for (int k = 0; k < 3; k++)
+    {
+        uint32_t other = mesh->neighbors[(long long) i * 3 + k];
+        if (other != NO_NEIGHBOR)
+        {
+            if (other < i && state->polygon_stamps[other] == state->polygon_stamp) {continue;}
+            if (settings.edges == EDGES_FEATURE && mesh->edge_angles[(long long) i * 3 + k] <= settings.feature_angle) {continue;}
+            if (settings.edges == EDGES_SILHOUETTE)
+            {
+                if (front < 0) {front = faces_viewer(state, i);}
+                if (faces_viewer(state, other) == front) {continue;}
+            }
+        }
+        mask |= 1 << k;
+    }
+    return mask;
+}
+
+int faces_viewer(const raster_state_t* state, uint32_t i)
+{
+    //which side of polygon i the eye is on, worked out in model space so polygons that were not transformed can be asked too;
+    //the eye is 2 / perspective out along the view axis, or infinitely far along it without perspective
+    const mesh_t* mesh = state->mesh;
+    point3d normal = face_normal(mesh, i);
+    uint32_t index[3];
+    mesh_indices(mesh, i, index);
+    point3d corner = mesh_vertex(mesh, index[0]);
+    const float* axis = state->matrix.rotation[2];
+    float p = settings.perspective;
+    point3d eye = {2 * axis[0] - p * corner.x, 2 * axis[1] - p * corner.y, 2 * axis[2] - p * corner.z};
+    return normal.x * eye.x + normal.y * eye.y + normal.z * eye.z > 0;
+}
+
+void line(render_target_t* target, point3d a, point3d b, color_t color)
+{
+    //both ends included, anything outside the target is clipped off before a pixel is written
+    rect_t whole = {0, 0, target->width, target->height};
+    if (line_depth(target, NULL, a, b, color, 0, whole) > 0)
+    {
+        //the fixed point ends can round a pixel past the float ones
+        rect_t bounds;
+        bounds.x0 = (int) floorf(a.x < b.x ? a.x : b.x) - 1;
+        bounds.y0 = (int) floorf(a.y < b.y ? a.y : b.y) - 1;
+        bounds.x1 = (int) floorf(a.x > b.x ? a.x : b.x) + 2;
+        bounds.y1 = (int) floorf(a.y > b.y ? a.y : b.y) + 2;
+        mark_dirty(target, bounds);
+    }
+}
+
+int line_depth(render_target_t* target, float* depth, point3d a, point3d b, color_t color, float bias, rect_t clip)
+{
+    //32.32 fixed point dda with interpolated z, a pixel is drawn when it is not behind the filled surface (when depth is given)
+    //the steps are clipped to clip up front, so the loops write without bounds checks; returns the pixels written
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float length = max_float(fabsf(dx), fabsf(dy));
+    //a line this long or this far away cannot reach the screen, nan fails here too
+    if (!(length < 1 << 24 && fabsf(a.x) < 1 << 25 && fabsf(a.y) < 1 << 25)) {return 0;}
+    int steps = (int) length;
+    int64_t x = to_fixed32(a.x);
+    int64_t y = to_fixed32(a.y);
+    double inverse = steps ? 4294967296.0 / steps : 0;
+    int64_t step_x = to_fixed32_rounded(dx * inverse);
+    int64_t step_y = to_fixed32_rounded(dy * inverse);
+    float step_z = steps ? (b.z - a.z) / steps : 0;
+
+    //integer steps make a running sum exact, so every tile sees the same pixels
+    int first = 0;
+    int last = steps;
+    int64_t end_x = x + step_x * steps;
+    int64_t end_y = y + step_y * steps;
+    //most lines are short and lie inside the tile, the step range only needs narrowing for the rest
+    int inside = (x >> 32) >= clip.x0 && (x >> 32) < clip.x1 && (y >> 32) >= clip.y0 && (y >> 32) < clip.y1
+        && (end_x >> 32) >= clip.x0 && (end_x >> 32) < clip.x1 && (end_y >> 32) >= clip.y0 && (end_y >> 32) < clip.y1;
+    if (!inside)
+    {
+        clip_line_steps(x, step_x, clip.x0, clip.x1, &first, &last);
+        clip_line_steps(y, step_y, clip.y0, clip.y1, &first, &last);
+        if (first > last) {return 0;}
+    }
+    x += step_x * first;
+    y += step_y * first;
+    uint32_t* screen = target->pixels;
+    int width = target->width;
+
+    if (depth == NULL && (step_x == 0 || step_y == 0))
+    {
+        //horizontal and vertical lines are plain spans, from the first pixel in the clip to the last
+        int x0 = (int) (x >> 32);
+        int y0 = (int) (y >> 32);
+        int x1 = (int) ((x + step_x * (last - first)) >> 32);
+        int y1 = (int) ((y + step_y * (last - first)) >> 32);
+        if (x0 > x1) {int t = x0; x0 = x1; x1 = t;}
+        if (y0 > y1) {int t = y0; y0 = y1; y1 = t;}
+        if (y0 == y1)
+        {
+            uint32_t* row = screen + y0 * width;
+            for (int px = x0; px <= x1; px++) {row[px] = color;}
+            return x1 - x0 + 1;
+        }
+        uint32_t* column = screen + y0 * width + x0;
+        for (int py = y0; py <= y1; py++, column += width) {*column = color;}
+        return y1 - y0 + 1;
+    }
+
+    int pixels = 0;
+    for (int i = first; i <= last; i++, x += step_x, y += step_y)
+    {
+        int offset = (int) (x >> 32) + (int) (y >> 32) * width;
+        if (depth == NULL || a.z + step_z * i + bias >= depth[offset])
+        {
+            screen[offset] = color;
+            pixels++;
+        }
+    }
+    return pixels;
+}
+
+long long draw_lines(render_target_t* target, float* depth, const vertex_stream_t* points, const uint32_t* ends, const color_t* colors, long long count, float bias, rect_t clip)
+{
+    //segment k runs between the projected points ends[2k] and ends[2k + 1], so edges can be fed straight from the transform
+    long long pixels = 0;
+    for (long long k = 0; k < count; k++)
+    {
+        uint32_t p = ends[k * 2];
+        uint32_t q = ends[k * 2 + 1];
+        point3d a = {points->x[p], points->y[p], points->z[p]};
+        point3d b = {points->x[q], points->y[q], points->z[q]};
+        pixels += line_depth(target, depth, a, b, colors[k], bias, clip);
+    }
+    return pixels;
+}
+
+void clip_line_steps(int64_t start, int64_t step, int low, int high, int* first, int* last)
+{
+    //narrow [first, last] to the steps i whose pixel, (start + step * i) >> 32, lies in [low, high)
+    int64_t min = (int64_t) low << 32;
+    int64_t max = ((int64_t) high << 32) - 1;
+    if (step == 0)
+    {
+        if (start < min || start > max) {*last = -1;}
+        return;
+    }
+    //min <= start + step * i <= max, solved for i rounding inwards
+    int64_t enter = step > 0 ? -floor_div(start - min, step) : -floor_div(max - start, -step);
+    int64_t leave = step > 0 ? floor_div(max - start, step) : floor_div(start - min, -step);
+    if (enter > *first) {*first = enter > INT32_MAX ? INT32_MAX : (int) enter;}
+    if (leave < *last) {*last = leave < 0 ? -1 : (int) leave;}
+}
+
+int64_t floor_div(int64_t a, int64_t b)
+{
+    //rounds towards minus infinity, b is positive
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+int clip_to_guard(point3d* polygon, int count, float guard)
+{
+    //sutherland-hodgman against the square of half size guard, in place; z is interpolated along the edges, which keeps it
+    //on the triangle's depth plane. polygon has room for count + 6 points, returns how many are left
+    point3d scratch[9];
+    for (int side = 0; side < 4 && count > 0; side++)
+    {
+        //sides x <= guard, x >= -guard, y <= guard, y >= -guard as a signed distance that is >= 0 inside
+        int axis_y = side >= 2;
+        float sign = side % 2 ? 1.0f : -1.0f;
+        int kept = 0;
+        for (int k = 0; k < count; k++)
+        {
+            point3d p = polygon[k];
+            point3d q = polygon[(k + 1) % count];
+            double dp = guard + sign * (axis_y ? p.y : p.x);
+            double dq = guard + sign * (axis_y ? q.y : q.x);
+            if (dp >= 0) {scratch[kept++] = p;}
+            if ((dp >= 0) != (dq >= 0))
+            {
+                double t = dp / (dp - dq);
+                point3d crossing;
+                crossing.x = (float) (p.x + (q.x - (double) p.x) * t);
+                crossing.y = (float) (p.y + (q.y - (double) p.y) * t);
+                crossing.z = (float) (p.z + (q.z - (double) p.z) * t);
+                //exactly on the side, not a rounding step past it
+                if (axis_y) {crossing.y = -sign * guard;}
+                else {crossing.x = -sign * guard;}
+                scratch[kept++] = crossing;
+            }
+        }
+        memcpy(polygon, scratch, sizeof(point3d) * kept);
+        count = kept;
+    }
+    return count;
+}
+
+int fill_triangle(render_target_t* target, float* depth, point3d a, point3d b, point3d c, color_t color, point3d normal, rect_t clip)
+{
+    //half-space rasterizer: 28.4 fixed point edge functions, top-left fill rule, walked in 8x8 blocks
+    //returns the pixels that passed the depth test
+    uint32_t* screen = target->pixels;
+    int width = target->width;
+    const float guard = 16384.0f;
+    if (!(fabsf(a.x) <= guard && fabsf(a.y) <= guard && fabsf(b.x) <= guard && fabsf(b.y) <= guard && fabsf(c.x) <= guard && fabsf(c.y) <= guard))
+    {
+        //past the guard band the fixed point would overflow: clip to it and fill the pieces, nan and infinity give nothing
+        if (!(isfinite(a.x) && isfinite(a.y) && isfinite(b.x) && isfinite(b.y) && isfinite(c.x) && isfinite(c.y))) {return 0;}
+        point3d polygon[9] = {a, b, c};
+        int count = clip_to_guard(polygon, 3, guard);
+        int pixels = 0;
+        for (int k = 1; k + 1 < count; k++)
+        {
+            pixels += fill_triangle(target, depth, polygon[0], polygon[k], polygon[k + 1], color, normal, clip);
+        }
+        return pixels;
+    }
+
+    int64_t vx[3] = {to_fixed(a.x), to_fixed(b.x), to_fixed(c.x)};
+    int64_t vy[3] = {to_fixed(a.y), to_fixed(b.y), to_fixed(c.y)};
+    float vz[3] = {a.z, b.z, c.z};
+    int64_t area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if (area == 0) {return 0;}
+    if (area < 0)
+    {
+        //both windings are filled, make this one positive
+        int64_t t = vx[1]; vx[1] = vx[2]; vx[2] = t;
+        t = vy[1]; vy[1] = vy[2]; vy[2] = t;
+        float tz = vz[1]; vz[1] = vz[2]; vz[2] = tz;
+        area = -area;
+    }
+
+    int64_t min_x = vx[0] < vx[1] ? (vx[0] < vx[2] ? vx[0] : vx[2]) : (vx[1] < vx[2] ? vx[1] : vx[2]);
+    int64_t max_x = vx[0] > vx[1] ? (vx[0] > vx[2] ? vx[0] : vx[2]) : (vx[1] > vx[2] ? vx[1] : vx[2]);
+    int64_t min_y = vy[0] < vy[1] ? (vy[0] < vy[2] ? vy[0] : vy[2]) : (vy[1] < vy[2] ? vy[1] : vy[2]);
+    int64_t max_y = vy[0] > vy[1] ? (vy[0] > vy[2] ? vy[0] : vy[2]) : (vy[1] > vy[2] ? vy[1] : vy[2]);
+    //range of pixel centres (px * 16 + 8) inside the bounding box, most small triangles cover none
+    int64_t first_x = (min_x + 7) >> 4;
+    int64_t first_y = (min_y + 7) >> 4;
+    int64_t last_x = (max_x - 8) >> 4;
+    int64_t last_y = (max_y - 8) >> 4;
+    //clip is aligned to 8 on its left and top, so blocks never leave it there
+    int x0 = first_x < clip.x0 ? clip.x0 : (int) first_x;
+    int y0 = first_y < clip.y0 ? clip.y0 : (int) first_y;
+    int x1 = last_x >= clip.x1 ? clip.x1 - 1 : (int) last_x;
+    int y1 = last_y >= clip.y1 ? clip.y1 - 1 : (int) last_y;
+    if (x0 > x1 || y0 > y1) {return 0;}
+    //shaded only once the triangle is known to cover a pixel
+    color = shade_color(color, normal);
+
+    //edge k runs from vertex k to vertex k+1, inside is e >= 0, e changes by step_x per pixel in x and step_y in y
+    int64_t step_x[3];
+    int64_t step_y[3];
+    int64_t origin[3];
+    int64_t bias[3];
+    for (int k = 0; k < 3; k++)
+    {
+        int n = k == 2 ? 0 : k + 1;
+        int64_t dx = vx[n] - vx[k];
+        int64_t dy = vy[n] - vy[k];
+        step_x[k] = -dy * 16;
+        step_y[k] = dx * 16;
+        //value at the centre of pixel (0, 0)
+        origin[k] = dx * (8 - vy[k]) - dy * (8 - vx[k]);
+        //pixels exactly on an edge belong to top and left edges only
+        bias[k] = ((dy == 0 && dx > 0) || dy < 0) ? 0 : -1;
+    }
+
+    //depth plane, z = z_origin + z_step_x * px + z_step_y * py
+    double inverse_area = 1.0 / (double) area;
+    double z_step_x = 0;
+    double z_step_y = 0;
+    double z_origin = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        //edge k is opposite vertex k+2
+        float weight = vz[k == 0 ? 2 : k - 1];
+        z_step_x += step_x[k] * inverse_area * weight;
+        z_step_y += step_y[k] * inverse_area * weight;
+        z_origin += origin[k] * inverse_area * weight;
+    }
+
+    int pixels = 0;
+    for (int by = y0 & ~7; by <= y1; by += 8)
+    {
+        for (int bx = x0 & ~7; bx <= x1; bx += 8)
+        {
+            int64_t e[3];
+            int accepted = 0;
+            int rejected = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                e[k] = origin[k] + step_x[k] * bx + step_y[k] * by + bias[k];
+                int64_t high = e[k] + (step_x[k] > 0 ? step_x[k] * 7 : 0) + (step_y[k] > 0 ? step_y[k] * 7 : 0);
+                int64_t low = e[k] + (step_x[k] < 0 ? step_x[k] * 7 : 0) + (step_y[k] < 0 ? step_y[k] * 7 : 0);
+                if (high < 0) {rejected = 1;}
+                if (low >= 0) {accepted |= 1 << k;}
+            }
+            if (rejected) {continue;}
+
+            int row_end = by + 8 > clip.y1 ? clip.y1 : by + 8;
+            int column_end = bx + 8 > clip.x1 ? clip.x1 : bx + 8;
+            float z_block = (float) (z_origin + z_step_x * bx + z_step_y * by);
+#ifdef __SSE2__
+            if (column_end == bx + 8)
+            {
+                //edges that cross the block stay within int32 here, edges that fully accept it are zeroed
+                __m128i edge_row[3];
+                __m128i edge_step_x[3];
+                __m128i edge_step_y[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    int inside = accepted & (1 << k);
+                    int32_t sx = inside ? 0 : (int32_t) step_x[k];
+                    int32_t base = inside ? 0 : (int32_t) e[k];
+                    edge_row[k] = _mm_setr_epi32(base, base + sx, base + sx * 2, base + sx * 3);
+                    edge_step_x[k] = _mm_set1_epi32(sx * 4);
+                    edge_step_y[k] = _mm_set1_epi32(inside ? 0 : (int32_t) step_y[k]);
+                }
+                __m128 z_lane = _mm_setr_ps(0, (float) z_step_x, (float) z_step_x * 2, (float) z_step_x * 3);
+                __m128 z_quad_step = _mm_set1_ps((float) z_step_x * 4);
+                __m128i fill = _mm_set1_epi32(color);
+                for (int y = by; y < row_end; y++)
+                {
+                    float z_row = z_block + (float) z_step_y * (y - by);
+                    __m128 z = _mm_add_ps(_mm_set1_ps(z_row), z_lane);
+                    __m128i e0 = edge_row[0];
+                    __m128i e1 = edge_row[1];
+                    __m128i e2 = edge_row[2];
+                    for (int quad = 0; quad < 2; quad++)
+                    {
+                        int offset = bx + quad * 4 + y * width;
+                        __m128i covered = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(e0, e1), e2), _mm_set1_epi32(-1));
+                        //early depth test, flat shading leaves nothing else to compute per pixel
+                        __m128 old_depth = _mm_loadu_ps(depth + offset);
+                        __m128 pass = _mm_and_ps(_mm_cmpgt_ps(z, old_depth), _mm_castsi128_ps(covered));
+                        int lanes = _mm_movemask_ps(pass);
+                        if (lanes)
+                        {
+                            pixels += (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + (lanes >> 3);
+                            _mm_storeu_ps(depth + offset, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old_depth)));
+                            __m128i old_color = _mm_loadu_si128((__m128i*) (screen + offset));
+                            __m128i pass_mask = _mm_castps_si128(pass);
+                            _mm_storeu_si128((__m128i*) (screen + offset), _mm_or_si128(_mm_and_si128(pass_mask, fill), _mm_andnot_si128(pass_mask, old_color)));
+                        }
+                        e0 = _mm_add_epi32(e0, edge_step_x[0]);
+                        e1 = _mm_add_epi32(e1, edge_step_x[1]);
+                        e2 = _mm_add_epi32(e2, edge_step_x[2]);
+                        z = _mm_add_ps(z, z_quad_step);
+                    }
+                    edge_row[0] = _mm_add_epi32(edge_row[0], edge_step_y[0]);
+                    edge_row[1] = _mm_add_epi32(edge_row[1], edge_step_y[1]);
+                    edge_row[2] = _mm_add_epi32(edge_row[2], edge_step_y[2]);
+                }
+                continue;
+            }
+#endif
+            //scalar path, also used for blocks cut by the right edge of the clip
+            for (int y = by; y < row_end; y++)
+            {
+                float z_row = z_block + (float) z_step_y * (y - by);
+                for (int x = bx; x < column_end; x++)
+                {
+                    int inside = 1;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        if (!(accepted & (1 << k)) && e[k] + step_x[k] * (x - bx) + step_y[k] * (y - by) < 0) {inside = 0;}
+                    }
+                    float z = z_row + (float) z_step_x * (x - bx);
+                    int offset = x + y * width;
+                    if (inside && z > depth[offset])
+                    {
+                        depth[offset] = z;
+                        screen[offset] = color;
+                        pixels++;
+                    }
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+color_t shade_color(color_t color, point3d normal)
+{
+    //flat shading, light from the viewer, both sides lit
+    float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    float intensity = length > 0 ? 0.2f + 0.8f * fabsf(normal.z) / length : 1.0f;
+    uint32_t r = ((color >> 16) & 0xff) * intensity;
+    uint32_t g = ((color >> 8) & 0xff) * intensity;
+    uint32_t b = (color & 0xff) * intensity;
+    return (color & 0xff000000) | (r << 16) | (g << 8) | b;
+}
+
+void numberrender(render_target_t* target, int number, point3d offset, int count)
+{
+    //loop over each char
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t character = (number / (int)pow(10, (count - (i + 1)))) % 10;
+        switch (character)
+        {
+            case 0: // Actually good coding by Noah (discord: whyareyoureadingthis)
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, addpoint(offset, 10, 20, 0), addpoint(offset, 10, 0, 0), WHITE);
+                line(target, offset, addpoint(offset, 0, 20, 0), WHITE);
+                line(target, addpoint(offset, 10, 20, 0), addpoint(offset, 0, 20, 0), WHITE);
+                break;
+            case 1:
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 2:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 10, 10, 0), addpoint(offset, 0, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 0, 20, 0), WHITE);
+                line(target, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 3:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 4:
+                line(target, offset, addpoint(offset, 0, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 5:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, addpoint(offset, 0, 0, 0), addpoint(offset, 0, 10, 0), WHITE);
+                line(target, addpoint(offset, 10, 10, 0), addpoint(offset, 0, 10, 0), WHITE);
+                line(target, addpoint(offset, 10, 10, 0), addpoint(offset, 10, 20, 0), WHITE);
+                line(target, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 6:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, offset, addpoint(offset, 0, 20, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
+                line(target, addpoint(offset, 10, 10, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 7:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 8:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, offset, addpoint(offset, 0, 20, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            case 9:
+                line(target, offset, addpoint(offset, 10, 0, 0), WHITE);
+                line(target, offset, addpoint(offset, 0, 10, 0), WHITE);
+                line(target, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
+                line(target, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
+                break;
+            default:
+                break;
+        }
+        offset.x += 14;
+    }
+}
+
+point3d calculated_position_to_screen_position(const render_target_t* target, point3d point)
+{
+    //the zoom is in window pixels, a smaller target shrinks it with the picture
+    float scale = settings.scale * ((float) target->width / settings.width);
+    point3d ret;
+    ret.x = roundf(point.x * scale) + (target->width / 2);
+    ret.y = roundf(0 - point.y * scale) + (target->height / 2);
+    ret.z = point.z;
+    return ret;
+}
+
+point3d window_to_target(const render_target_t* target, float x, float y)
+{
+    //a window position, such as a click, in the pixels of a target that may be drawn smaller or larger than the window
+    if (target == NULL) {return (point3d) {x, y, 0};}
+    return (point3d) {x * target->width / settings.width, y * target->height / settings.height, 0};
+}
+
+point3d model_to_2d(point3d point, float xangle, float yangle)
+{
+    point3d ret = rotatex(xangle, rotatey(yangle, point));
+    if (settings.perspective)
+    {
+        ret.x = ret.x / (2 - ret.z * settings.perspective);
+        ret.y = ret.y / (2 - ret.z * settings.perspective);
+    }
+    return ret;
+}
+
+view_matrix_t build_view_matrix(const render_target_t* target, float xangle, float yangle)
+{
+    //rotatey then rotatex as in model_to_2d, then scale, perspective and the centre of the target folded in
+    float scale = settings.scale * ((float) target->width / settings.width);
+    float cx = cosf(xangle);
+    float sx = sinf(xangle);
+    float cy = cosf(yangle);
+    float sy = sinf(yangle);
+    float rotation[3][3] = {
+        {cy, 0, sy},
+        {sx * sy, cx, -sx * cy},
+        {-cx * sy, sx, cx * cy},
+    };
+
+    view_matrix_t matrix;
+    memcpy(matrix.rotation, rotation, sizeof(rotation));
+    float p = settings.perspective;
+    for (int k = 0; k < 3; k++)
+    {
+        //w is 2 - z * perspective, or 1 without perspective
+        matrix.m[3][k] = p ? -rotation[2][k] * p : 0;
+        matrix.m[2][k] = rotation[2][k];
+    }
+    matrix.m[3][3] = p ? 2 : 1;
+    matrix.m[2][3] = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        //the centre offset is multiplied by w so it survives the divide
+        float rx = k < 3 ? rotation[0][k] : 0;
+        float ry = k < 3 ? rotation[1][k] : 0;
+        matrix.m[0][k] = rx * scale + matrix.m[3][k] * (target->width / 2);
+        matrix.m[1][k] = -ry * scale + matrix.m[3][k] * (target->height / 2);
+    }
+    return matrix;
+}
+
+point3d rotate_normal(const view_matrix_t* matrix, point3d normal)
+{
+    point3d ret;
+    ret.x = matrix->rotation[0][0] * normal.x + matrix->rotation[0][1] * normal.y + matrix->rotation[0][2] * normal.z;
+    ret.y = matrix->rotation[1][0] * normal.x + matrix->rotation[1][1] * normal.y + matrix->rotation[1][2] * normal.z;
+    ret.z = matrix->rotation[2][0] * normal.x + matrix->rotation[2][1] * normal.y + matrix->rotation[2][2] * normal.z;
+    return ret;
+}
+
+void transform_scalar(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count)
+{
+    const float (*m)[4] = matrix->m;
+    for (long long i = 0; i < count; i++)
+    {
+        float w = m[3][0] * x[i] + m[3][1] * y[i] + m[3][2] * z[i] + m[3][3];
+        sx[i] = (m[0][0] * x[i] + m[0][1] * y[i] + m[0][2] * z[i] + m[0][3]) / w;
+        sy[i] = (m[1][0] * x[i] + m[1][1] * y[i] + m[1][2] * z[i] + m[1][3]) / w;
+        sz[i] = m[2][0] * x[i] + m[2][1] * y[i] + m[2][2] * z[i] + m[2][3];
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+void transform_sse2(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count)
+{
+    __m128 m[4][4];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++) {m[r][c] = _mm_set1_ps(matrix->m[r][c]);}
+    }
+
+    long long i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vz = _mm_loadu_ps(z + i);
+        __m128 row[4];
+        for (int r = 0; r < 4; r++)
+        {
+            row[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], vx), _mm_mul_ps(m[r][1], vy)), _mm_mul_ps(m[r][2], vz)), m[r][3]);
+        }
+        _mm_storeu_ps(sx + i, _mm_div_ps(row[0], row[3]));
+        _mm_storeu_ps(sy + i, _mm_div_ps(row[1], row[3]));
+        _mm_storeu_ps(sz + i, row[2]);
+    }
+    transform_scalar(matrix, x + i, y + i, z + i, sx + i, sy + i, sz + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void transform_avx2(const view_matrix_t* matrix, const float* x, const float* y, const float* z, float* sx, float* sy, float* sz, long long count)
+{
+    __m256 m[4][4];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++) {m[r][c] = _mm256_set1_ps(matrix->m[r][c]);}
+    }
+
+    long long i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 vz = _mm256_loadu_ps(z + i);
+        __m256 row[4];
+        for (int r = 0; r < 4; r++)
+        {
+            //separate mul and add, no fma, so every path gives the same bits
+            row[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r][0], vx), _mm256_mul_ps(m[r][1], vy)), _mm256_mul_ps(m[r][2], vz)), m[r][3]);
+        }
+        _mm256_storeu_ps(sx + i, _mm256_div_ps(row[0], row[3]));
+        _mm256_storeu_ps(sy + i, _mm256_div_ps(row[1], row[3]));
+        _mm256_storeu_ps(sz + i, row[2]);
+    }
+    transform_sse2(matrix, x + i, y + i, z + i, sx + i, sy + i, sz + i, count - i);
+}
+#endif
+
+transform_kernel_t select_transform_kernel(void)
+{
+    //picked once from the cpu features SDL reports
+    static transform_kernel_t kernel = NULL;
+    if (kernel == NULL)
+    {
+        kernel = transform_scalar;
+#ifdef HAVE_X86_SIMD
+        if (SDL_HasSSE2()) {kernel = transform_sse2;}
+        if (SDL_HasAVX2()) {kernel = transform_avx2;}
+#endif
+    }
+    return kernel;
+}
+
+view_matrix_t quantized_matrix(const view_matrix_t* matrix, const mesh_t* mesh)
+{
+    //m * (low + q * step) = (m * step) * q + m * low, so the kernels take q as it is
+    view_matrix_t quantized = *matrix;
+    float low[3] = {mesh->quant_low.x, mesh->quant_low.y, mesh->quant_low.z};
+    float step[3] = {mesh->quant_step.x, mesh->quant_step.y, mesh->quant_step.z};
+    for (int r = 0; r < 4; r++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            quantized.m[r][k] = matrix->m[r][k] * step[k];
+            quantized.m[r][3] += matrix->m[r][k] * low[k];
+        }
+    }
+    return quantized;
+}
+
+void transform_quantized_scalar(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count)
+{
+    const float (*m)[4] = matrix->m;
+    for (long long i = 0; i < count; i++)
+    {
+        float fx = x[i];
+        float fy = y[i];
+        float fz = z[i];
+        float w = m[3][0] * fx + m[3][1] * fy + m[3][2] * fz + m[3][3];
+        sx[i] = (m[0][0] * fx + m[0][1] * fy + m[0][2] * fz + m[0][3]) / w;
+        sy[i] = (m[1][0] * fx + m[1][1] * fy + m[1][2] * fz + m[1][3]) / w;
+        sz[i] = m[2][0] * fx + m[2][1] * fy + m[2][2] * fz + m[2][3];
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+void transform_quantized_sse2(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count)
+{
+    __m128 m[4][4];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++) {m[r][c] = _mm_set1_ps(matrix->m[r][c]);}
+    }
+
+    __m128i zero = _mm_setzero_si128();
+    long long i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        //widened to int32 then converted, which is exact for 16 bits
+        __m128 vx = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (x + i)), zero));
+        __m128 vy = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (y + i)), zero));
+        __m128 vz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (z + i)), zero));
+        __m128 row[4];
+        for (int r = 0; r < 4; r++)
+        {
+            row[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], vx), _mm_mul_ps(m[r][1], vy)), _mm_mul_ps(m[r][2], vz)), m[r][3]);
+        }
+        _mm_storeu_ps(sx + i, _mm_div_ps(row[0], row[3]));
+        _mm_storeu_ps(sy + i, _mm_div_ps(row[1], row[3]));
+        _mm_storeu_ps(sz + i, row[2]);
+    }
+    transform_quantized_scalar(matrix, x + i, y + i, z + i, sx + i, sy + i, sz + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void transform_quantized_avx2(const view_matrix_t* matrix, const uint16_t* x, const uint16_t* y, const uint16_t* z, float* sx, float* sy, float* sz, long long count)
+{
+    __m256 m[4][4];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++) {m[r][c] = _mm256_set1_ps(matrix->m[r][c]);}
+    }
+
+    long long i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 vx = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (x + i))));
+        __m256 vy = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (y + i))));
+        __m256 vz = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (z + i))));
+        __m256 row[4];
+        for (int r = 0; r < 4; r++)
+        {
+            row[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r][0], vx), _mm256_mul_ps(m[r][1], vy)), _mm256_mul_ps(m[r][2], vz)), m[r][3]);
+        }
+        _mm256_storeu_ps(sx + i, _mm256_div_ps(row[0], row[3]));
+        _mm256_storeu_ps(sy + i, _mm256_div_ps(row[1], row[3]));
+        _mm256_storeu_ps(sz + i, row[2]);
+    }
+    transform_quantized_sse2(matrix, x + i, y + i, z + i, sx + i, sy + i, sz + i, count - i);
+}
+#endif
+
+quantized_kernel_t select_quantized_kernel(void)
+{
+    static quantized_kernel_t kernel = NULL;
+    if (kernel == NULL)
+    {
+        kernel = transform_quantized_scalar;
+#ifdef HAVE_X86_SIMD
+        if (SDL_HasSSE2()) {kernel = transform_quantized_sse2;}
+        if (SDL_HasAVX2()) {kernel = transform_quantized_avx2;}
+#endif
+    }
+    return kernel;
+}
+
+projection_t build_projection(const render_target_t* target)
+{
+    //the scale and centre build_view_matrix folds into its rows
+    projection_t projection;
+    projection.scale = settings.scale * ((float) target->width / settings.width);
+    projection.perspective = settings.perspective;
+    projection.center_x = (float) (target->width / 2);
+    projection.center_y = (float) (target->height / 2);
+    return projection;
+}
+
+view_matrix_t rotation_matrix(const view_matrix_t* matrix)
+{
+    //the rotation alone with w = 1, which the kernels divide by exactly
+    view_matrix_t rotation = {0};
+    memcpy(rotation.rotation, matrix->rotation, sizeof(rotation.rotation));
+    for (int r = 0; r < 3; r++)
+    {
+        for (int k = 0; k < 3; k++) {rotation.m[r][k] = matrix->rotation[r][k];}
+    }
+    rotation.m[3][3] = 1;
+    return rotation;
+}
+
+void project_scalar(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count)
+{
+    float p = projection->perspective;
+    float base = p ? 2 : 1;
+    for (long long i = 0; i < count; i++)
+    {
+        float k = projection->scale / (base - p * z[i]);
+        sx[i] = x[i] * k + projection->center_x;
+        sy[i] = projection->center_y - y[i] * k;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+void project_sse2(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count)
+{
+    __m128 p = _mm_set1_ps(projection->perspective);
+    __m128 base = _mm_set1_ps(projection->perspective ? 2 : 1);
+    __m128 scale = _mm_set1_ps(projection->scale);
+    __m128 center_x = _mm_set1_ps(projection->center_x);
+    __m128 center_y = _mm_set1_ps(projection->center_y);
+    long long i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 k = _mm_div_ps(scale, _mm_sub_ps(base, _mm_mul_ps(p, _mm_loadu_ps(z + i))));
+        _mm_storeu_ps(sx + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), k), center_x));
+        _mm_storeu_ps(sy + i, _mm_sub_ps(center_y, _mm_mul_ps(_mm_loadu_ps(y + i), k)));
+    }
+    project_scalar(projection, x + i, y + i, z + i, sx + i, sy + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void project_avx2(const projection_t* projection, const float* x, const float* y, const float* z, float* sx, float* sy, long long count)
+{
+    __m256 p = _mm256_set1_ps(projection->perspective);
+    __m256 base = _mm256_set1_ps(projection->perspective ? 2 : 1);
+    __m256 scale = _mm256_set1_ps(projection->scale);
+    __m256 center_x = _mm256_set1_ps(projection->center_x);
+    __m256 center_y = _mm256_set1_ps(projection->center_y);
+    long long i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 k = _mm256_div_ps(scale, _mm256_sub_ps(base, _mm256_mul_ps(p, _mm256_loadu_ps(z + i))));
+        _mm256_storeu_ps(sx + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), k), center_x));
+        _mm256_storeu_ps(sy + i, _mm256_sub_ps(center_y, _mm256_mul_ps(_mm256_loadu_ps(y + i), k)));
+    }
+    project_sse2(projection, x + i, y + i, z + i, sx + i, sy + i, count - i);
+}
+#endif
+
+project_kernel_t select_project_kernel(void)
+{
+    static project_kernel_t kernel = NULL;
+    if (kernel == NULL)
+    {
+        kernel = project_scalar;
+#ifdef HAVE_X86_SIMD
+        if (SDL_HasSSE2()) {kernel = project_sse2;}
+        if (SDL_HasAVX2()) {kernel = project_avx2;}
+#endif
+    }
+    return kernel;
+}
+
+void update_transform_cache(raster_state_t* state, const mesh_t* mesh)
+{
+    //moves the rotation epoch on when the mesh or the rotation changed, and the projection epoch with it or when the scale,
+    //perspective or target size did
+    int same_mesh = mesh->revision != 0 && mesh == state->cached_mesh && mesh->revision == state->cached_revision && mesh->number_of_vertices == state->cached_vertices;
+    int same_rotation = same_mesh && memcmp(state->cached_rotation, state->matrix.rotation, sizeof(state->cached_rotation)) == 0;
+    int same_projection = same_rotation && memcmp(&state->cached_projection, &state->projection, sizeof(projection_t)) == 0;
+    if (!same_rotation)
+    {
+        state->cached_mesh = mesh;
+        state->cached_revision = mesh->revision;
+        state->cached_vertices = mesh->number_of_vertices;
+        memcpy(state->cached_rotation, state->matrix.rotation, sizeof(state->cached_rotation));
+        if (++state->rotation_epoch == 0)
+        {
+            if (state->meshlet_rotated) {memset(state->meshlet_rotated, 0, sizeof(uint32_t) * state->meshlet_stamps_allocated);}
+            state->rotated_all = 0;
+            state->rotation_epoch = 1;
+        }
+    }
+    if (!same_projection)
+    {
+        state->cached_projection = state->projection;
+        if (++state->projection_epoch == 0)
+        {
+            if (state->meshlet_projected) {memset(state->meshlet_projected, 0, sizeof(uint32_t) * state->meshlet_stamps_allocated);}
+            state->projected_all = 0;
+            state->projection_epoch = 1;
+        }
+    }
+    state->rotated_count = 0;
+    state->projected_count = 0;
+}
+
+void transform_range(raster_state_t* state, const mesh_t* mesh, const view_matrix_t* vertex_matrix, long long first, long long count, int rotate)
+{
+    //vertices [first, first + count) rotated into the view unless they still are, then projected; the scalar kernels do
+    //the same operations in the same order as the vector ones, so a vertex gets the same bits whichever did it
+    vertex_stream_t* rotated = &state->rotated;
+    vertex_stream_t* projected = &state->projected;
+    //too short for the vector kernels to pay for setting up their registers
+    int short_range = count < 8;
+    project_kernel_t project = short_range ? project_scalar : select_project_kernel();
+    if (!rotate)
+    {
+        project(&state->projection, rotated->x + first, rotated->y + first, projected->z + first, projected->x + first, projected->y + first, count);
+        state->projected_count += count;
+        return;
+    }
+    //in blocks, so the projection reads what the rotation just wrote while it is still in the cache
+    quantized_kernel_t rotate_quantized = short_range ? transform_quantized_scalar : select_quantized_kernel();
+    transform_kernel_t rotate_float = short_range ? transform_scalar : select_transform_kernel();
+    for (long long i = first; i < first + count; i += TRANSFORM_BLOCK)
+    {
+        long long n = first + count - i < TRANSFORM_BLOCK ? first + count - i : TRANSFORM_BLOCK;
+        if (mesh->qx) {rotate_quantized(vertex_matrix, mesh->qx + i, mesh->qy + i, mesh->qz + i, rotated->x + i, rotated->y + i, projected->z + i, n);}
+        else {rotate_float(vertex_matrix, mesh->x + i, mesh->y + i, mesh->z + i, rotated->x + i, rotated->y + i, projected->z + i, n);}
+        project(&state->projection, rotated->x + i, rotated->y + i, projected->z + i, projected->x + i, projected->y + i, n);
+    }
+    state->rotated_count += count;
+    state->projected_count += count;
+}
+
+int reserve_vertex_stream(vertex_stream_t* stream, long long count)
+{
+    if (count <= stream->capacity) {return 0;}
+    float* x = realloc(stream->x, sizeof(float) * count);
+    if (x) {stream->x = x;}
+    float* y = realloc(stream->y, sizeof(float) * count);
+    if (y) {stream->y = y;}
+    float* z = realloc(stream->z, sizeof(float) * count);
+    if (z) {stream->z = z;}
+    if (x == NULL || y == NULL || z == NULL) {return 1;}
+    stream->capacity = count;
+    return 0;
+}
+
+point3d rotatex(float angle, point3d point)
+{
+    point3d ret;
+    float cosa = cosf(angle);
+    float sina = sinf(angle);
+
+    ret.x = point.x;
+    ret.y = (point.y * cosa) - (point.z * sina);
+    ret.z = (point.y * sina) + (point.z * cosa);
+    return ret;
+}
+
+point3d rotatey(float angle, point3d point)
+{
+    point3d ret;
+    float cosa = cosf(angle);
+    float sina = sinf(angle);
+
+    ret.x = (point.x * cosa) + (point.z * sina);
+    ret.y = point.y;
+    ret.z = (point.z * cosa) - (point.x * sina);
+    return ret;
+}
+
+point3d rotatez(float angle, point3d point)
+{
+    point3d ret;
+    float cosa = cosf(angle);
+    float sina = sinf(angle);
+
+    ret.x = (point.x * cosa) - (point.y * sina);
+    ret.y = (point.x * sina) + (point.y * cosa);
+    ret.z = point.x;
+    return ret;
+}
+
+polygon_t newpolygon(color_t color, point3d a, point3d b, point3d c)
+{
+    polygon_t ret;
+    //zero, so repair_normals puts the face normal in
+    ret.normal_vector = (point3d) {0, 0, 0};
+    ret.color = color;
+    ret.a = a;
+    ret.b = b;
+    ret.c = c;
+    return ret;
+}
+
+void put_pixel(render_target_t* target, unsigned x, unsigned y, uint32_t color)
+{
+    if (x < (unsigned) target->width && y < (unsigned) target->height)
+    {
+        target->pixels[x + (y * target->width)] = color;
+        mark_dirty(target, (rect_t) {(int) x, (int) y, (int) x + 1, (int) y + 1});
+    }
+}
+
+rect_t union_rect(rect_t a, rect_t b)
+{
+    if (a.x0 >= a.x1 || a.y0 >= a.y1) {return b;}
+    if (b.x0 >= b.x1 || b.y0 >= b.y1) {return a;}
+    rect_t ret;
+    ret.x0 = a.x0 < b.x0 ? a.x0 : b.x0;
+    ret.y0 = a.y0 < b.y0 ? a.y0 : b.y0;
+    ret.x1 = a.x1 > b.x1 ? a.x1 : b.x1;
+    ret.y1 = a.y1 > b.y1 ? a.y1 : b.y1;
+    return ret;
+}
+
+void mark_dirty(render_target_t* target, rect_t rect)
+{
+    //the part of rect inside the target joins what has to be cleared and uploaded
+    if (rect.x0 < 0) {rect.x0 = 0;}
+    if (rect.y0 < 0) {rect.y0 = 0;}
+    if (rect.x1 > target->width) {rect.x1 = target->width;}
+    if (rect.y1 > target->height) {rect.y1 = target->height;}
+    target->dirty = union_rect(target->dirty, rect);
+}
+
+void clear_rect(render_target_t* target, int width, rect_t rect)
+{
+    //rect as it was when rows were width pixels apart, which is not the current width after a resolution change
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) {return;}
+    if (rect.x0 == 0 && rect.x1 == width)
+    {
+        memset(target->pixels + (long long) rect.y0 * width, 0, sizeof(uint32_t) * width * (rect.y1 - rect.y0));
+        return;
+    }
+    for (int y = rect.y0; y < rect.y1; y++)
+    {
+        memset(target->pixels + (long long) y * width + rect.x0, 0, sizeof(uint32_t) * (rect.x1 - rect.x0));
+    }
+}
+
+void copy_rect(render_target_t* target, const render_target_t* source, rect_t rect)
+{
+    //both the same size
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) {return;}
+    for (int y = rect.y0; y < rect.y1; y++)
+    {
+        long long offset = (long long) y * target->width + rect.x0;
+        memcpy(target->pixels + offset, source->pixels + offset, sizeof(uint32_t) * (rect.x1 - rect.x0));
+    }
+}
+
+void resolve_scene(render_target_t* target, const render_target_t* source)
+{
+    //box filters the larger source into the whole target, which becomes window size; every pixel is written, so the target
+    //needs no clearing
+    size_render_target(target, 1);
+    resolve_job_t job = {source, target};
+    parallel_for(target->height, 64, resolve_rows, &job);
+    target->dirty = (rect_t) {0, 0, target->width, target->height};
+}
+
+void resolve_rows(void* data, long long first, long long last)
+{
+    //each target pixel is the mean of the source pixels from its own top left corner up to the next pixel's, at most 4 by 4
+    resolve_job_t* job = data;
+    const render_target_t* source = job->source;
+    render_target_t* target = job->target;
+    for (long long y = first; y < last; y++)
+    {
+        long long y0 = y * source->height / target->height;
+        long long y1 = (y + 1) * source->height / target->height;
+        if (y1 <= y0) {y1 = y0 + 1;}
+        uint32_t* row = target->pixels + y * target->width;
+        for (long long x = 0; x < target->width; x++)
+        {
+            long long x0 = x * source->width / target->width;
+            long long x1 = (x + 1) * source->width / target->width;
+            if (x1 <= x0) {x1 = x0 + 1;}
+            uint32_t a = 0, r = 0, g = 0, b = 0;
+            for (long long sy = y0; sy < y1; sy++)
+            {
+                const uint32_t* pixel = source->pixels + sy * source->width;
+                for (long long sx = x0; sx < x1; sx++)
+                {
+                    a += pixel[sx] >> 24;
+                    r += (pixel[sx] >> 16) & 0xff;
+                    g += (pixel[sx] >> 8) & 0xff;
+                    b += pixel[sx] & 0xff;
+                }
+            }
+            uint32_t count = (uint32_t) ((y1 - y0) * (x1 - x0));
+            row[x] = ((a + count / 2) / count) << 24 | ((r + count / 2) / count) << 16 | ((g + count / 2) / count) << 8 | (b + count / 2) / count;
+        }
+    }
+}
+
+button_t new_button(int x, int y, int width, int height, char *text)
+{
+    button_t ret;
+    ret.height = height;
+    strcpy(ret.text, text);
+    ret.width = width;
+    ret.x = x;
+    ret.y = y;
+    return ret;
+}
+
+void renderbutton(render_target_t* target, button_t button)
+{
+    point3d topleft = (point3d) {.x = button.x, .y = button.y, .z = 0.0f};
+    line(target, topleft, addpoint(topleft, button.width, 0, 0), WHITE);
+    line(target, addpoint(topleft, button.width, button.height, 0), addpoint(topleft, button.width, 0, 0), WHITE);
+    line(target, addpoint(topleft, 0, button.height, 0), addpoint(topleft, button.width, button.height, 0), WHITE);
+    line(target, topleft, addpoint(topleft, 0, button.height, 0), WHITE);
+}
+
+int check_button_pressed(button_t button, int x, int y)
+{
+    return ((x >= button.x) && ((button.x + button.width) >= x)) && ((y >= button.y) && ((button.y + button.height) >= y));
+}
+
+polygon_t* load_model(const char* path, int* number_of_polygons, mesh_stream_t* stream)
+{
+    //with a stream, batches are published to its preview as they are decoded
+    *number_of_polygons = 0;
+    mapped_file_t file;
+    if (map_file(path, &file, 0) != 0)
+    {
+        SDL_Log("Error 01: File Not Open");
+        return NULL;
+    }
+
+    //compressed models are recognised by their magic number, whatever they are called
+    int format = compression_format(file.data, file.size);
+    int supported = format == COMPRESSION_NONE;
+#ifdef HAVE_ZLIB
+    supported |= format == COMPRESSION_GZIP;
+#endif
+#ifdef HAVE_ZSTD
+    supported |= format == COMPRESSION_ZSTD;
+#endif
+    polygon_t* polygonlist;
+    if (!supported)
+    {
+        SDL_Log("Error 20: This Build Cannot Read %s Compressed Models", format == COMPRESSION_GZIP ? "Gzip" : "Zstandard");
+        polygonlist = NULL;
+    }
+    else if (format != COMPRESSION_NONE)
+    {
+        polygonlist = load_compressed_stl(file.data, file.size, format, number_of_polygons, stream);
+    }
+    else if (looks_like_ascii_stl(file.data, file.size))
+    {
+        polygonlist = load_stl_ascii(file.data, file.size, number_of_polygons, stream);
+    }
+    else
+    {
+        polygonlist = load_stl_binary(file.data, file.size, number_of_polygons, stream);
+    }
+    unmap_file(&file);
+    return polygonlist;
+}
+
+int load_mesh(const char* path, mesh_t* mesh)
+{
+    //no path opens the generated model if one was asked for, otherwise the default cube
+    if (path && settings.mesh_cache && load_mesh_cache(path, mesh) == 0)
+    {
+        if (settings.compact) {compact_mesh(mesh);}
+        start_lod_build(mesh);
+        return 0;
+    }
+    int number_of_polygons = 0;
+    polygon_t* polygonlist = path ? load_model(path, &number_of_polygons, NULL) : settings.generate ? generate_model(settings.generate, &number_of_polygons) : default_cube(&number_of_polygons);
+    if (polygonlist == NULL) {return 1;}
+    int result = mesh_from_polygons(polygonlist, number_of_polygons, mesh);
+    free(polygonlist);
+    if (result == 0 && path && settings.mesh_cache) {write_mesh_cache(path, mesh);}
+    if (result == 0 && settings.compact) {compact_mesh(mesh);}
+    if (result == 0) {start_lod_build(mesh);}
+    return result;
+}
+
+int start_mesh_stream(mesh_stream_t* stream, const char* path)
+{
+    //loads on its own thread, returns 1 if that thread could not be started
+    memset(stream, 0, sizeof(mesh_stream_t));
+    stream->path = path;
+    SDL_SetAtomicInt(&stream->status, STREAM_LOADING);
+    stream->thread = SDL_CreateThread(mesh_stream_thread, "mesh loader", stream);
+    return stream->thread == NULL;
+}
+
+int mesh_stream_thread(void* data)
+{
+    mesh_stream_t* stream = data;
+    int result = 1;
+    if (settings.mesh_cache && load_mesh_cache(stream->path, &stream->final) == 0)
+    {
+        //nothing to preview, the cached mesh is ready as soon as it is mapped
+        result = 0;
+        if (settings.compact) {compact_mesh(&stream->final);}
+    }
+    else
+    {
+        int number_of_polygons = 0;
+        polygon_t* polygonlist = load_model(stream->path, &number_of_polygons, stream);
+        if (polygonlist && !SDL_GetAtomicInt(&stream->cancel))
+        {
+            //welding and the bvh are done here too, the preview is drawn meanwhile
+            result = mesh_from_polygons(polygonlist, number_of_polygons, &stream->final);
+            if (result == 0 && settings.mesh_cache) {write_mesh_cache(stream->path, &stream->final);}
+            if (result == 0 && settings.compact) {compact_mesh(&stream->final);}
+        }
+        free(polygonlist);
+    }
+    SDL_SetAtomicInt(&stream->status, result == 0 ? STREAM_DONE : STREAM_FAILED);
+    if (redraw_event)
+    {
+        SDL_Event event = {.type = redraw_event};
+        SDL_PushEvent(&event);
+    }
+    return result;
+}
+
+void stream_begin(mesh_stream_t* stream, long long total)
+{
+    //the preview is allocated whole before the total is published, so the renderer never sees it move
+    if (stream == NULL) {return;}
+    mesh_t* preview = &stream->preview;
+    long long corners = total * 3;
+    preview->x = malloc(sizeof(float) * (corners ? corners : 1));
+    preview->y = malloc(sizeof(float) * (corners ? corners : 1));
+    preview->z = malloc(sizeof(float) * (corners ? corners : 1));
+    preview->indices = malloc(sizeof(uint32_t) * (corners ? corners : 1));
+    preview->normals = malloc(sizeof(point3d) * (total ? total : 1));
+    preview->colors = malloc(sizeof(color_t) * (total ? total : 1));
+    if (preview->x == NULL || preview->y == NULL || preview->z == NULL || preview->indices == NULL || preview->normals == NULL || preview->colors == NULL)
+    {
+        //nothing is drawn until the welded mesh is done; the renderer only touches the counts and bounds
+        free(preview->x);
+        free(preview->y);
+        free(preview->z);
+        free(preview->indices);
+        free(preview->normals);
+        free(preview->colors);
+        //free_mesh runs on the preview again when the stream ends
+        preview->x = preview->y = preview->z = NULL;
+        preview->indices = NULL;
+        preview->normals = NULL;
+        preview->colors = NULL;
+        return;
+    }
+    SDL_SetAtomicInt(&stream->total, (int) total);
+}
+
+void stream_publish(mesh_stream_t* stream, const polygon_t* polygonlist, long long first, long long last)
+{
+    //copy polygons [first, last) into the preview, then make them visible with one atomic store
+    if (stream == NULL || SDL_GetAtomicInt(&stream->total) == 0) {return;}
+    mesh_t* preview = &stream->preview;
+    for (long long i = first; i < last; i++)
+    {
+        const point3d* corner = &polygonlist[i].a;
+        for (int k = 0; k < 3; k++)
+        {
+            preview->x[i * 3 + k] = corner[k].x;
+            preview->y[i * 3 + k] = corner[k].y;
+            preview->z[i * 3 + k] = corner[k].z;
+            preview->indices[i * 3 + k] = (uint32_t) (i * 3 + k);
+        }
+        preview->normals[i] = polygonlist[i].normal_vector;
+        preview->colors[i] = polygonlist[i].color;
+    }
+    SDL_SetAtomicInt(&stream->ready, (int) last);
+    if (redraw_event)
+    {
+        SDL_Event event = {.type = redraw_event};
+        SDL_PushEvent(&event);
+    }
+}
+
+int poll_mesh_stream(mesh_stream_t* stream, mesh_t* mesh)
+{
+    //returns 1 while loading, 0 when the loaded mesh is in mesh (or nothing is loading) and -1 if loading failed
+    if (stream->thread == NULL) {return 0;}
+    int status = SDL_GetAtomicInt(&stream->status);
+    if (status == STREAM_LOADING)
+    {
+        //only the polygons published so far are read, the loader is still writing after them
+        mesh_t* preview = &stream->preview;
+        long long ready = SDL_GetAtomicInt(&stream->ready);
+        if (preview->number_of_polygons == 0)
+        {
+            preview->low = (point3d) {INFINITY, INFINITY, INFINITY};
+            preview->high = (point3d) {-INFINITY, -INFINITY, -INFINITY};
+        }
+        for (long long v = preview->number_of_polygons * 3; v < ready * 3; v++)
+        {
+            preview->low.x = min_float(preview->low.x, preview->x[v]); preview->high.x = max_float(preview->high.x, preview->x[v]);
+            preview->low.y = min_float(preview->low.y, preview->y[v]); preview->high.y = max_float(preview->high.y, preview->y[v]);
+            preview->low.z = min_float(preview->low.z, preview->z[v]); preview->high.z = max_float(preview->high.z, preview->z[v]);
+        }
+        preview->number_of_polygons = ready;
+        preview->number_of_vertices = ready * 3;
+        return 1;
+    }
+
+    SDL_WaitThread(stream->thread, NULL);
+    stream->thread = NULL;
+    free_mesh(&stream->preview);
+    if (status == STREAM_FAILED) {return -1;}
+    free_mesh(mesh);
+    *mesh = stream->final;
+    memset(&stream->final, 0, sizeof(mesh_t));
+    start_lod_build(mesh);
+    return 0;
+}
+
+void stop_mesh_stream(mesh_stream_t* stream)
+{
+    //the loader stops at its next batch, a weld or bvh build already running is finished first
+    if (stream->thread == NULL) {return;}
+    SDL_SetAtomicInt(&stream->cancel, 1);
+    SDL_WaitThread(stream->thread, NULL);
+    stream->thread = NULL;
+    free_mesh(&stream->preview);
+    free_mesh(&stream->final);
+}
+
+void render_progress(render_target_t* target, long long done, long long total)
+{
+    //percentage and a bar along the bottom of the screen
+    int percent = total ? (int) (done * 100 / total) : 0;
+    numberrender(target, percent, (point3d) {.x = 10.0f, .y = (float) (target->height - 40), .z = 0.0f}, 3);
+    int filled = total ? (int) (done * (target->width - 20) / total) : 0;
+    for (int y = target->height - 14; y < target->height - 8; y++)
+    {
+        for (int x = 0; x < target->width - 20; x++)
+        {
+            if (x < filled || y == target->height - 14 || y == target->height - 9) {put_pixel(target, x + 10, y, WHITE);}
+        }
+    }
+}
+
+int init_render_target(render_target_t* target, float resolution)
+{
+    //room for the window size times resolution, returns 1 if that could not be allocated
+    target->width = (int) (settings.width * resolution + 0.5f);
+    target->height = (int) (settings.height * resolution + 0.5f);
+    target->capacity = (long long) target->width * target->height;
+    //cleared once here, after that only what was drawn is cleared again
+    target->pixels = calloc(target->capacity, sizeof(uint32_t));
+    target->dirty = (rect_t) {0, 0, 0, 0};
+    return target->pixels == NULL;
+}
+
+void upload_rect(SDL_Texture* texture, const render_target_t* target, rect_t rect)
+{
+    //the rows of rect only, starting at its top left pixel
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) {return;}
+    SDL_Rect area = {rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0};
+    SDL_UpdateTexture(texture, &area, target->pixels + (long long) rect.y0 * target->width + rect.x0, target->width * sizeof(uint32_t));
+}
+
+void size_render_target(render_target_t* target, float resolution)
+{
+    //the window size times resolution, at least a pixel and never more than was allocated
+    int width = (int) (settings.width * resolution + 0.5f);
+    int height = (int) (settings.height * resolution + 0.5f);
+    target->width = width < 1 ? 1 : width;
+    target->height = height < 1 ? 1 : height;
+    if ((long long) target->width * target->height > target->capacity)
+    {
+        target->width = (int) (target->capacity / target->height);
+    }
+}
+
+float adjust_resolution(float resolution, double frame_ms, double budget_ms)
+{
+    //pixel work goes with the square of the resolution; half of the way to the budget per frame, so one slow frame does not make it jump
+    if (!(frame_ms > 0)) {return resolution;}
+    float target = resolution * (float) sqrt(budget_ms / frame_ms);
+    target = resolution + (target - resolution) * 0.5f;
+    target = target < settings.min_resolution ? settings.min_resolution : target > 1 ? 1 : target;
+    //small changes are not worth a different picture size
+    return fabsf(target - resolution) < 0.02f && target != 1 && target != settings.min_resolution ? resolution : target;
+}
+
+int start_render_thread(render_thread_t* render, const button_t* buttons, int number_of_buttons)
+{
+    //returns 1 if the buffers could not be allocated; without a thread every frame is drawn when it is submitted
+    memset(render, 0, sizeof(render_thread_t));
+    render->job = -1;
+    float largest = settings.still_resolution > 1 ? settings.still_resolution : 1;
+    for (int k = 0; k < FRAME_BUFFERS; k++)
+    {
+        if (init_render_target(&render->scenes[k], largest) != 0 || init_render_target(&render->huds[k], 1) != 0 || (k == 0 && init_render_target(&render->hud_layer, 1) != 0)
+            || (largest > 1 && init_render_target(&render->resolved[k], 1) != 0))
+        {
+            SDL_Log("Error 15: Frame Buffers Not Allocated");
+            for (int i = 0; i <= k; i++)
+            {
+                free(render->scenes[i].pixels);
+                free(render->huds[i].pixels);
+                free(render->resolved[i].pixels);
+            }
+            free(render->hud_layer.pixels);
+            return 1;
+        }
+    }
+    //test line
+    for (int i = 0; i < render->hud_layer.width; i++)
+    {
+        put_pixel(&render->hud_layer, i, 10, RED);
+    }
+    //display buttons
+    for (int i = 0; i < number_of_buttons; i++)
+    {
+        renderbutton(&render->hud_layer, buttons[i]);
+    }
+    //every hud starts as the layer, so only what is drawn on top has to be restored
+    for (int k = 0; k < FRAME_BUFFERS; k++)
+    {
+        memcpy(render->huds[k].pixels, render->hud_layer.pixels, sizeof(uint32_t) * render->hud_layer.capacity);
+    }
+    render->frame_event = SDL_RegisterEvents(1);
+    render->mutex = SDL_CreateMutex();
+    render->wake = SDL_CreateCondition();
+    render->idle = SDL_CreateCondition();
+    if (render->mutex && render->wake && render->idle)
+    {
+        render->thread = SDL_CreateThread(render_thread, "render", render);
+    }
+    return 0;
+}
+
+int render_thread(void* data)
+{
+    //draws one submitted frame at a time, the pool workers help it with the raster
+    render_thread_t* render = data;
+    SDL_LockMutex(render->mutex);
+    while (1)
+    {
+        while (render->job < 0 && !render->quit) {SDL_WaitCondition(render->wake, render->mutex);}
+        if (render->quit) {break;}
+        int index = render->job;
+        SDL_UnlockMutex(render->mutex);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        render_frame(&render->scenes[index], &render->huds[index], &render->resolved[index], &render->views[index], &render->hud_layer);
+        double frame_ms = elapsed_ms(start);
+
+        SDL_LockMutex(render->mutex);
+        render->frame_ms[index] = frame_ms;
+        render->state[index] = FRAME_READY;
+        render->job = -1;
+        SDL_BroadcastCondition(render->idle);
+        SDL_Event event = {.type = render->frame_event};
+        SDL_PushEvent(&event);
+    }
+    SDL_UnlockMutex(render->mutex);
+    return 0;
+}
+
+void render_frame(render_target_t* scene, render_target_t* hud, render_target_t* resolved, const view_state_t* view, const render_target_t* hud_layer)
+{
+    //a whole frame from the view alone, the globals the raster reads are set from it first
+    Uint64 frame_start = SDL_GetPerformanceCounter();
+    settings.scale = view->scale;
+    settings.perspective = view->perspective;
+    settings.occlude = view->occlude;
+    settings.edges = view->edges;
+    frame_timing.event_ms = view->event_ms;
+    frame_timing.upload_ms = view->upload_ms;
+    frame_timing.present_ms = view->present_ms;
+
+    //the scene is drawn at the resolution of the view and stretched over the window when shown, the hud always at window size
+    int drawn_width = scene->width;
+    size_render_target(scene, view->resolution);
+
+    //clear what the buffer's last frame drew with black, at the width it was drawn at; the hud goes back to its layer
+    Uint64 clear_start = SDL_GetPerformanceCounter();
+    clear_rect(scene, drawn_width, scene->dirty);
+    scene->dirty = (rect_t) {0, 0, 0, 0};
+    copy_rect(hud, hud_layer, hud->dirty);
+    hud->dirty = (rect_t) {0, 0, 0, 0};
+    frame_timing.clear_ms = profile_end("clear", clear_start, 0);
+
+    //display perspective number not float
+    numberrender(hud, (int) (view->perspective * 100.0f), (point3d) {.x = 100.0f, .y = 0.0f, .z = 0.0f}, 3);
+    //display fps
+    numberrender(hud, view->fps, (point3d) {.x=10.0f, .y=10.0f, .z=0.0f}, 3);
+    //render the polygons, a coarser level while the view is moving, or what has been loaded so far
+    polyrender(scene, view->loading ? view->mesh : select_lod(view->mesh, view->moving), view->xangle, view->yangle, view->rendermode);
+    //the texture's linear filter only blends the nearest four pixels, above 2 that would skip most of the samples
+    if (view->resolution > 1 && resolved->pixels) {resolve_scene(resolved, scene);}
+    if (view->loading) {render_progress(hud, view->loaded, view->total);}
+    //averages of the frames before this one
+    if (view->profiler) {profile_overlay(hud);}
+    profile_end("frame", frame_start, 0);
+    profile_frame();
+}
+
+int submit_frame(render_thread_t* render, const view_state_t* view)
+{
+    //returns 1 without drawing if a frame is still being drawn or no buffer is free
+    SDL_LockMutex(render->mutex);
+    int index = -1;
+    for (int k = 0; k < FRAME_BUFFERS && render->job < 0; k++)
+    {
+        if (render->state[k] == FRAME_FREE)
+        {
+            index = k;
+            break;
+        }
+    }
+    if (index < 0)
+    {
+        SDL_UnlockMutex(render->mutex);
+        return 1;
+    }
+    render->state[index] = FRAME_RENDERING;
+    render->views[index] = *view;
+    render->sequence[index] = ++render->submitted;
+    if (render->thread)
+    {
+        render->job = index;
+        SDL_SignalCondition(render->wake);
+    }
+    SDL_UnlockMutex(render->mutex);
+
+    if (render->thread == NULL)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        render_frame(&render->scenes[index], &render->huds[index], &render->resolved[index], &render->views[index], &render->hud_layer);
+        render->frame_ms[index] = elapsed_ms(start);
+        render->state[index] = FRAME_READY;
+    }
+    return 0;
+}
+
+int take_frame(render_thread_t* render)
+{
+    //the newest finished buffer, or -1; older finished ones are dropped, the taken one stays put until it is released
+    SDL_LockMutex(render->mutex);
+    int newest = -1;
+    for (int k = 0; k < FRAME_BUFFERS; k++)
+    {
+        if (render->state[k] == FRAME_READY && (newest < 0 || render->sequence[k] > render->sequence[newest])) {newest = k;}
+    }
+    for (int k = 0; k < FRAME_BUFFERS; k++)
+    {
+        if (render->state[k] == FRAME_READY && k != newest) {render->state[k] = FRAME_FREE;}
+    }
+    if (newest >= 0) {render->state[newest] = FRAME_SHOWN;}
+    SDL_UnlockMutex(render->mutex);
+    return newest;
+}
+
+void release_frame(render_thread_t* render, int index)
+{
+    SDL_LockMutex(render->mutex);
+    render->state[index] = FRAME_FREE;
+    SDL_UnlockMutex(render->mutex);
+}
+
+int render_idle(render_thread_t* render)
+{
+    //nothing is being drawn, so the mesh, the stream and the raster state may be touched
+    SDL_LockMutex(render->mutex);
+    int idle = render->job < 0;
+    SDL_UnlockMutex(render->mutex);
+    return idle;
+}
+
+void wait_render_idle(render_thread_t* render)
+{
+    SDL_LockMutex(render->mutex);
+    while (render->job >= 0) {SDL_WaitCondition(render->idle, render->mutex);}
+    SDL_UnlockMutex(render->mutex);
+}
+
+void stop_render_thread(render_thread_t* render)
+{
+    if (render->thread)
+    {
+        wait_render_idle(render);
+        SDL_LockMutex(render->mutex);
+        render->quit = 1;
+        SDL_SignalCondition(render->wake);
+        SDL_UnlockMutex(render->mutex);
+        SDL_WaitThread(render->thread, NULL);
+        render->thread = NULL;
+    }
+    SDL_DestroyCondition(render->wake);
+    SDL_DestroyCondition(render->idle);
+    SDL_DestroyMutex(render->mutex);
+    for (int k = 0; k < FRAME_BUFFERS; k++)
+    {
+        free(render->scenes[k].pixels);
+        free(render->huds[k].pixels);
+        free(render->resolved[k].pixels);
+    }
+    free(render->hud_layer.pixels);
+}
+
+int mesh_from_polygons(polygon_t* polygonlist, long long number_of_polygons, mesh_t* mesh)
+{
+    //weld corners that lie within weld_tolerance of each other into one vertex, using a hash grid
+    long long corners = number_of_polygons * 3;
+    memset(mesh, 0, sizeof(mesh_t));
+    mesh->x = malloc(sizeof(float) * (corners ? corners : 1));
+    mesh->y = malloc(sizeof(float) * (corners ? corners : 1));
+    mesh->z = malloc(sizeof(float) * (corners ? corners : 1));
+    mesh->indices = malloc(sizeof(uint32_t) * (corners ? corners : 1));
+    mesh->normals = malloc(sizeof(point3d) * (number_of_polygons ? number_of_polygons : 1));
+    mesh->colors = malloc(sizeof(color_t) * (number_of_polygons ? number_of_polygons : 1));
+
+    long long table_size = 1;
+    while (table_size < corners * 2) {table_size *= 2;}
+    uint32_t* heads = malloc(sizeof(uint32_t) * table_size);
+    uint32_t* next = malloc(sizeof(uint32_t) * (corners ? corners : 1));
+    if (mesh->x == NULL || mesh->y == NULL || mesh->z == NULL || mesh->indices == NULL || mesh->normals == NULL || mesh->colors == NULL || heads == NULL || next == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(heads);
+        free(next);
+        free_mesh(mesh);
+        return 1;
+    }
+    memset(heads, 0xff, sizeof(uint32_t) * table_size);
+
+    point3d low = {INFINITY, INFINITY, INFINITY};
+    point3d high = {-INFINITY, -INFINITY, -INFINITY};
+    for (long long i = 0; i < number_of_polygons; i++)
+    {
+        point3d* corner = &polygonlist[i].a;
+        for (int k = 0; k < 3; k++)
+        {
+            low.x = min_float(low.x, corner[k].x); high.x = max_float(high.x, corner[k].x);
+            low.y = min_float(low.y, corner[k].y); high.y = max_float(high.y, corner[k].y);
+            low.z = min_float(low.z, corner[k].z); high.z = max_float(high.z, corner[k].z);
+        }
+    }
+    mesh->low = low;
+    mesh->high = high;
+    float diagonal = corners ? sqrtf((high.x - low.x) * (high.x - low.x) + (high.y - low.y) * (high.y - low.y) + (high.z - low.z) * (high.z - low.z)) : 0;
+    float epsilon = diagonal * settings.weld_tolerance;
+    //cells twice the tolerance wide, so a match is at most one neighbouring cell away
+    float cell = epsilon > 0 ? epsilon * 2 : 1;
+
+    long long count = 0;
+    for (long long i = 0; i < number_of_polygons; i++)
+    {
+        point3d* corner = &polygonlist[i].a;
+        for (int k = 0; k < 3; k++)
+        {
+            point3d p = corner[k];
+            uint32_t found = UINT32_MAX;
+            long long x0 = floorf((p.x - epsilon - low.x) / cell), x1 = floorf((p.x + epsilon - low.x) / cell);
+            long long y0 = floorf((p.y - epsilon - low.y) / cell), y1 = floorf((p.y + epsilon - low.y) / cell);
+            long long z0 = floorf((p.z - epsilon - low.z) / cell), z1 = floorf((p.z + epsilon - low.z) / cell);
+            for (long long x = x0; x <= x1 && found == UINT32_MAX; x++)
+            {
+                for (long long y = y0; y <= y1 && found == UINT32_MAX; y++)
+                {
+                    for (long long z = z0; z <= z1 && found == UINT32_MAX; z++)
+                    {
+                        for (uint32_t v = heads[weld_hash(x, y, z) & (table_size - 1)]; v != UINT32_MAX; v = next[v])
+                        {
+                            if (fabsf(mesh->x[v] - p.x) <= epsilon && fabsf(mesh->y[v] - p.y) <= epsilon && fabsf(mesh->z[v] - p.z) <= epsilon)
+                            {
+                                found = v;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if (found == UINT32_MAX)
+            {
+                found = count++;
+                mesh->x[found] = p.x;
+                mesh->y[found] = p.y;
+                mesh->z[found] = p.z;
+                uint32_t bucket = weld_hash(floorf((p.x - low.x) / cell), floorf((p.y - low.y) / cell), floorf((p.z - low.z) / cell)) & (table_size - 1);
+                next[found] = heads[bucket];
+                heads[bucket] = found;
+            }
+            mesh->indices[i * 3 + k] = found;
+        }
+        mesh->normals[i] = polygonlist[i].normal_vector;
+        mesh->colors[i] = polygonlist[i].color;
+    }
+    free(heads);
+    free(next);
+
+    float* shrunk = realloc(mesh->x, sizeof(float) * (count ? count : 1));
+    if (shrunk) {mesh->x = shrunk;}
+    shrunk = realloc(mesh->y, sizeof(float) * (count ? count : 1));
+    if (shrunk) {mesh->y = shrunk;}
+    shrunk = realloc(mesh->z, sizeof(float) * (count ? count : 1));
+    if (shrunk) {mesh->z = shrunk;}
+    mesh->number_of_vertices = count;
+    mesh->number_of_polygons = number_of_polygons;
+
+    //many exporters write zero or stale normals, the winding is what the culling goes by
+    parallel_for(number_of_polygons, 65536, repair_normals, mesh);
+
+    //without a bvh every polygon is drawn every frame, which is slower but still correct
+    if (build_bvh(mesh) != 0)
+    {
+        SDL_Log("Error 12: Could Not Build The Bounding Volume Hierarchy");
+    }
+    //after the bvh, which reorders the polygons; without edges every polygon outline is drawn
+    build_edges(mesh);
+    //the culling goes by the winding, so a file that mixes both would show holes; turning a polygon reorders its corners,
+    //so the vertices are numbered by first use again for the meshlets
+    if (orient_polygons(mesh) > 0) {renumber_vertices(mesh);}
+    //after the bvh too, which numbers the vertices by first use
+    build_meshlets(mesh);
+    touch_mesh(mesh);
+    return 0;
+}
+
+void repair_normals(void* data, long long first, long long last)
+{
+    //replace normals that are missing or point away from the winding with the unit face normal
+    mesh_t* mesh = data;
+    for (long long i = first; i < last; i++)
+    {
+        uint32_t* index = &mesh->indices[i * 3];
+        point3d u = {mesh->x[index[1]] - mesh->x[index[0]], mesh->y[index[1]] - mesh->y[index[0]], mesh->z[index[1]] - mesh->z[index[0]]};
+        point3d v = {mesh->x[index[2]] - mesh->x[index[0]], mesh->y[index[2]] - mesh->y[index[0]], mesh->z[index[2]] - mesh->z[index[0]]};
+        point3d face = {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+        float length = sqrtf(face.x * face.x + face.y * face.y + face.z * face.z);
+        //degenerate after welding, keep whatever the file said
+        if (!(length > 0)) {continue;}
+
+        point3d normal = mesh->normals[i];
+        if (normal.x * face.x + normal.y * face.y + normal.z * face.z <= 0)
+        {
+            mesh->normals[i] = (point3d) {face.x / length, face.y / length, face.z / length};
+        }
+    }
+}
+
+int build_edges(mesh_t* mesh)
+{
+    //finds the polygon across every edge; edges are bucketed on their lower vertex, so a match is only looked for among the
+    //few edges around one vertex
+    static const int corners[3][2] = {{0, 1}, {0, 2}, {2, 1}};
+    long long polygons = mesh->number_of_polygons;
+    long long vertices = mesh->number_of_vertices;
+    long long edges = polygons * 3;
+    mesh->neighbors = malloc(sizeof(uint32_t) * (edges ? edges : 1));
+    mesh->edge_angles = malloc(edges ? edges : 1);
+    edge_build_t build = {mesh, calloc(vertices + 1, sizeof(uint32_t)), malloc(sizeof(uint32_t) * (edges ? edges : 1)), malloc(sizeof(uint32_t) * (edges ? edges : 1))};
+    if (mesh->neighbors == NULL || mesh->edge_angles == NULL || build.starts == NULL || build.entries == NULL || build.uppers == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(mesh->neighbors);
+        free(mesh->edge_angles);
+        free(build.starts);
+        free(build.entries);
+        free(build.uppers);
+        mesh->neighbors = NULL;
+        mesh->edge_angles = NULL;
+        return 1;
+    }
+
+    //count per lower vertex, sum to bucket ends, then fill backwards so each bucket lists its edges in polygon order
+    for (long long e = 0; e < edges; e++)
+    {
+        uint32_t* index = &mesh->indices[e - e % 3];
+        uint32_t a = index[corners[e % 3][0]];
+        uint32_t b = index[corners[e % 3][1]];
+        build.starts[a < b ? a : b]++;
+    }
+    for (long long v = 1; v <= vertices; v++) {build.starts[v] += build.starts[v - 1];}
+    for (long long e = edges - 1; e >= 0; e--)
+    {
+        uint32_t* index = &mesh->indices[e - e % 3];
+        uint32_t a = index[corners[e % 3][0]];
+        uint32_t b = index[corners[e % 3][1]];
+        uint32_t slot = --build.starts[a < b ? a : b];
+        build.entries[slot] = (uint32_t) e;
+        build.uppers[slot] = a < b ? b : a;
+    }
+    memset(mesh->neighbors, 0xff, sizeof(uint32_t) * edges);
+    memset(mesh->edge_angles, OPEN_EDGE, edges);
+    parallel_for(vertices, 65536, pair_edges, &build);
+    free(build.starts);
+    free(build.entries);
+    free(build.uppers);
+    return 0;
+}
+
+void pair_edges(void* data, long long first, long long last)
+{
+    //pairs the edges in the buckets of vertices [first, last); past the first two polygons on an edge the rest stay open,
+    //so a non-manifold edge is always drawn
+    static const int leaves[3] = {0, 2, 1}; //the corner each edge starts from going round the winding
+    edge_build_t* build = data;
+    mesh_t* mesh = build->mesh;
+    for (long long v = first; v < last; v++)
+    {
+        uint32_t end = build->starts[v + 1];
+        for (uint32_t k = build->starts[v]; k < end; k++)
+        {
+            uint32_t e = build->entries[k];
+            if (mesh->neighbors[e] != NO_NEIGHBOR) {continue;}
+            for (uint32_t m = k + 1; m < end; m++)
+            {
+                uint32_t f = build->entries[m];
+                if (build->uppers[m] != build->uppers[k] || mesh->neighbors[f] != NO_NEIGHBOR || f / 3 == e / 3) {continue;}
+                mesh->neighbors[e] = f / 3;
+                mesh->neighbors[f] = e / 3;
+                //polygons wound the same way go along their shared edge in opposite directions
+                int consistent = mesh->indices[e - e % 3 + leaves[e % 3]] != mesh->indices[f - f % 3 + leaves[f % 3]];
+                mesh->edge_angles[e] = mesh->edge_angles[f] = (uint8_t) edge_angle(mesh, e / 3, f / 3, consistent);
+                break;
+            }
+        }
+    }
+}
+
+long long orient_polygons(mesh_t* mesh)
+{
+    //walks every connected piece from its first polygon and turns each neighbour wound against the polygon it was reached
+    //from, then turns a closed piece that ended up inside out as a whole by the sign of its volume. Returns how many polygons
+    //were turned, or -1 without the edges
+    static const int leaves[3] = {0, 2, 1}; //the corner each edge starts from going round the winding
+    static const int ends[3] = {1, 0, 2}; //and the corner it goes to
+    long long polygons = mesh->number_of_polygons;
+    if (mesh->neighbors == NULL || polygons == 0) {return -1;}
+    uint32_t* queue = malloc(sizeof(uint32_t) * polygons);
+    uint8_t* reached = calloc(polygons, 1);
+    if (queue == NULL || reached == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(queue);
+        free(reached);
+        return -1;
+    }
+
+    long long flipped = 0;
+    for (long long seed = 0; seed < polygons; seed++)
+    {
+        if (reached[seed]) {continue;}
+        reached[seed] = 1;
+        queue[0] = (uint32_t) seed;
+        long long head = 0, tail = 1;
+        int closed = 1;
+        double volume = 0;
+        while (head < tail)
+        {
+            uint32_t i = queue[head++];
+            uint32_t* index = &mesh->indices[(long long) i * 3];
+            point3d a = mesh_vertex(mesh, index[0]), b = mesh_vertex(mesh, index[1]), c = mesh_vertex(mesh, index[2]);
+            volume += (double) a.x * ((double) b.y * c.z - (double) b.z * c.y) + (double) a.y * ((double) b.z * c.x - (double) b.x * c.z) + (double) a.z * ((double) b.x * c.y - (double) b.y * c.x);
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t other = mesh->neighbors[(long long) i * 3 + k];
+                if (other == NO_NEIGHBOR) {closed = 0; continue;}
+                if (reached[other]) {continue;}
+                //polygons wound the same way go along their shared edge in opposite directions
+                uint32_t from = index[leaves[k]], to = index[ends[k]];
+                uint32_t* across = &mesh->indices[(long long) other * 3];
+                for (int m = 0; m < 3; m++)
+                {
+                    if (mesh->neighbors[(long long) other * 3 + m] != i) {continue;}
+                    if (across[leaves[m]] == from && across[ends[m]] == to)
+                    {
+                        flip_polygon(mesh, other);
+                        flipped++;
+                        break;
                     }
-                    else if (event.button.button == 3) //right click
+                    if (across[leaves[m]] == to && across[ends[m]] == from) {break;}
+                }
+                reached[other] = 1;
+                queue[tail++] = other;
+            }
+        }
+        //an open piece has no inside, so it keeps the winding of its first polygon
+        if (closed && volume < 0)
+        {
+            for (long long k = 0; k < tail; k++)
+            {
+                flip_polygon(mesh, queue[k]);
+            }
+            flipped += tail;
+        }
+    }
+    free(queue);
+    free(reached);
+    return flipped;
+}
+
+void flip_polygon(mesh_t* mesh, uint32_t i)
+{
+    //swapping the last two corners turns the winding; edge 0-1 becomes 0-2 and the other way round while 2-1 stays, so
+    //their neighbours swap with them. The angles do not depend on the winding
+    long long base = (long long) i * 3;
+    uint32_t corner = mesh->indices[base + 1];
+    mesh->indices[base + 1] = mesh->indices[base + 2];
+    mesh->indices[base + 2] = corner;
+    uint32_t other = mesh->neighbors[base];
+    mesh->neighbors[base] = mesh->neighbors[base + 1];
+    mesh->neighbors[base + 1] = other;
+    uint8_t angle = mesh->edge_angles[base];
+    mesh->edge_angles[base] = mesh->edge_angles[base + 1];
+    mesh->edge_angles[base + 1] = angle;
+    mesh->normals[i] = (point3d) {-mesh->normals[i].x, -mesh->normals[i].y, -mesh->normals[i].z};
+}
+
+int renumber_vertices(mesh_t* mesh)
+{
+    //numbers the vertices in the order the polygons first use them, like build_bvh does; returns 1 without memory, the mesh
+    //then draws as before but without meshlets
+    long long vertices = mesh->number_of_vertices;
+    uint32_t* remap = malloc(sizeof(uint32_t) * (vertices ? vertices : 1));
+    float* scratch = malloc(sizeof(float) * (vertices ? vertices : 1));
+    if (remap == NULL || scratch == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(remap);
+        free(scratch);
+        return 1;
+    }
+    for (long long v = 0; v < vertices; v++) {remap[v] = UINT32_MAX;}
+    uint32_t next_vertex = 0;
+    for (long long i = 0; i < mesh->number_of_polygons * 3; i++)
+    {
+        uint32_t vertex = mesh->indices[i];
+        if (remap[vertex] == UINT32_MAX) {remap[vertex] = next_vertex++;}
+        mesh->indices[i] = remap[vertex];
+    }
+    float* streams[3] = {mesh->x, mesh->y, mesh->z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        //vertices no polygon uses keep their relative order at the end
+        uint32_t unused = next_vertex;
+        for (long long v = 0; v < vertices; v++)
+        {
+            scratch[remap[v] == UINT32_MAX ? unused++ : remap[v]] = streams[axis][v];
+        }
+        memcpy(streams[axis], scratch, sizeof(float) * vertices);
+    }
+    free(remap);
+    free(scratch);
+    return 0;
+}
+
+int edge_angle(const mesh_t* mesh, uint32_t i, uint32_t j, int consistent)
+{
+    //degrees between the normals of two polygons, rounded; 0 when either has no area. The normal of a polygon wound against
+    //its neighbour is turned around first, so a flat pair reads 0 whichever way the file wound them
+    point3d n = face_normal(mesh, i);
+    point3d m = face_normal(mesh, j);
+    if (!consistent) {m = (point3d) {-m.x, -m.y, -m.z};}
+    double lengths = sqrt(((double) n.x * n.x + (double) n.y * n.y + (double) n.z * n.z) * ((double) m.x * m.x + (double) m.y * m.y + (double) m.z * m.z));
+    if (!(lengths > 0)) {return 0;}
+    double cosine = ((double) n.x * m.x + (double) n.y * m.y + (double) n.z * m.z) / lengths;
+    cosine = cosine < -1 ? -1 : cosine > 1 ? 1 : cosine;
+    return (int) (acos(cosine) * 180 / PI + 0.5);
+}
+
+point3d face_normal(const mesh_t* mesh, uint32_t i)
+{
+    //from the winding and not normalized, the file's normals are not trusted for this
+    uint32_t index[3];
+    mesh_indices(mesh, i, index);
+    point3d a = mesh_vertex(mesh, index[0]);
+    point3d b = mesh_vertex(mesh, index[1]);
+    point3d c = mesh_vertex(mesh, index[2]);
+    point3d u = {b.x - a.x, b.y - a.y, b.z - a.z};
+    point3d v = {c.x - a.x, c.y - a.y, c.z - a.z};
+    return (point3d) {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+}
+
+int build_meshlets(mesh_t* mesh)
+{
+    //cuts the polygons, in leaf order, into meshlets of at most MESHLET_POLYGONS polygons and MESHLET_VERTICES vertices; a
+    //vertex numbered out of first use order leaves the mesh without meshlets
+    mesh->meshlets = NULL;
+    mesh->shared_vertices = NULL;
+    mesh->number_of_meshlets = 0;
+    mesh->number_of_shared_vertices = 0;
+    long long polygons = mesh->number_of_polygons;
+    long long vertices = mesh->number_of_vertices;
+    if (polygons == 0 || vertices >= UINT32_MAX) {return 1;}
+    long long meshlets_allocated = polygons / 64 + 1;
+    long long shared_allocated = polygons / 4 + 64;
+    meshlet_t* meshlets = malloc(sizeof(meshlet_t) * meshlets_allocated);
+    uint32_t* shared = malloc(sizeof(uint32_t) * 2 * shared_allocated);
+    //the last meshlet each vertex was listed in, and the one that brought it in
+    uint32_t* seen = malloc(sizeof(uint32_t) * vertices);
+    uint32_t* owners = malloc(sizeof(uint32_t) * vertices);
+    if (meshlets == NULL || shared == NULL || seen == NULL || owners == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(meshlets);
+        free(shared);
+        free(seen);
+        free(owners);
+        return 1;
+    }
+    memset(seen, 0xff, sizeof(uint32_t) * vertices);
+
+    long long count = 0;
+    long long number_of_shared = 0;
+    uint32_t next_vertex = 0;
+    int used = 0;
+    int ordered = 1;
+    meshlet_t* meshlet = NULL;
+    for (long long i = 0; i < polygons && ordered; i++)
+    {
+        uint32_t* index = &mesh->indices[i * 3];
+        uint32_t current = (uint32_t) (count - 1);
+        int fresh = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            int repeat = (k > 0 && index[k] == index[0]) || (k > 1 && index[k] == index[1]);
+            fresh += !repeat && (meshlet == NULL || seen[index[k]] != current);
+        }
+        if (meshlet == NULL || meshlet->last_polygon - meshlet->first_polygon == MESHLET_POLYGONS || used + fresh > MESHLET_VERTICES)
+        {
+            if (count == meshlets_allocated)
+            {
+                meshlet_t* grown = realloc(meshlets, sizeof(meshlet_t) * meshlets_allocated * 2);
+                if (grown == NULL) {ordered = 0; break;}
+                meshlets = grown;
+                meshlets_allocated *= 2;
+            }
+            meshlet = &meshlets[count++];
+            *meshlet = (meshlet_t) {.first_polygon = (uint32_t) i, .last_polygon = (uint32_t) i, .first_vertex = next_vertex, .first_shared = (uint32_t) number_of_shared};
+            current = (uint32_t) (count - 1);
+            used = 0;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = index[k];
+            if (seen[v] == current) {continue;}
+            seen[v] = current;
+            used++;
+            if (v == next_vertex)
+            {
+                owners[v] = current;
+                next_vertex++;
+                continue;
+            }
+            if (v > next_vertex) {ordered = 0; break;}
+            if (number_of_shared == shared_allocated)
+            {
+                uint32_t* grown = realloc(shared, sizeof(uint32_t) * 2 * shared_allocated * 2);
+                if (grown == NULL) {ordered = 0; break;}
+                shared = grown;
+                shared_allocated *= 2;
+            }
+            shared[number_of_shared * 2] = v;
+            shared[number_of_shared * 2 + 1] = owners[v];
+            number_of_shared++;
+        }
+        meshlet->last_polygon = (uint32_t) i + 1;
+        meshlet->last_vertex = next_vertex;
+        meshlet->number_of_shared = (uint32_t) (number_of_shared - meshlet->first_shared);
+    }
+    free(seen);
+    free(owners);
+    if (!ordered)
+    {
+        free(meshlets);
+        free(shared);
+        return 1;
+    }
+
+    meshlet_t* shrunk = realloc(meshlets, sizeof(meshlet_t) * count);
+    uint32_t* shrunk_shared = realloc(shared, sizeof(uint32_t) * 2 * (number_of_shared ? number_of_shared : 1));
+    mesh->meshlets = shrunk ? shrunk : meshlets;
+    mesh->shared_vertices = shrunk_shared ? shrunk_shared : shared;
+    mesh->number_of_meshlets = count;
+    mesh->number_of_shared_vertices = number_of_shared;
+    parallel_for(count, 4096, meshlet_bounds, mesh);
+    return 0;
+}
+
+void meshlet_bounds(void* data, long long first, long long last)
+{
+    //sphere and normal cone of meshlets [first, last) from the positions as they are stored, so compact meshes get the bounds
+    //of their rounded positions
+    mesh_t* mesh = data;
+    for (long long m = first; m < last; m++)
+    {
+        meshlet_t* meshlet = &mesh->meshlets[m];
+        point3d low = {INFINITY, INFINITY, INFINITY};
+        point3d high = {-INFINITY, -INFINITY, -INFINITY};
+        for (uint32_t k = 0; k < meshlet->last_vertex - meshlet->first_vertex + meshlet->number_of_shared; k++)
+        {
+            uint32_t v = meshlet->first_vertex + k;
+            if (v >= meshlet->last_vertex) {v = mesh->shared_vertices[(meshlet->first_shared + v - meshlet->last_vertex) * 2];}
+            point3d p = mesh_vertex(mesh, v);
+            low = (point3d) {min_float(low.x, p.x), min_float(low.y, p.y), min_float(low.z, p.z)};
+            high = (point3d) {max_float(high.x, p.x), max_float(high.y, p.y), max_float(high.z, p.z)};
+        }
+        point3d center = {(low.x + high.x) / 2, (low.y + high.y) / 2, (low.z + high.z) / 2};
+        float radius = 0;
+        for (uint32_t k = 0; k < meshlet->last_vertex - meshlet->first_vertex + meshlet->number_of_shared; k++)
+        {
+            uint32_t v = meshlet->first_vertex + k;
+            if (v >= meshlet->last_vertex) {v = mesh->shared_vertices[(meshlet->first_shared + v - meshlet->last_vertex) * 2];}
+            point3d p = mesh_vertex(mesh, v);
+            point3d d = {p.x - center.x, p.y - center.y, p.z - center.z};
+            radius = max_float(radius, d.x * d.x + d.y * d.y + d.z * d.z);
+        }
+        meshlet->center = center;
+        meshlet->radius = sqrtf(radius) * 1.0001f;
+
+        //the cone is around the mean of the unit winding normals, polygons without area face nowhere and are left out
+        point3d axis = {0, 0, 0};
+        for (uint32_t i = meshlet->first_polygon; i < meshlet->last_polygon; i++)
+        {
+            point3d n = face_normal(mesh, i);
+            float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+            if (length > 0) {axis = (point3d) {axis.x + n.x / length, axis.y + n.y / length, axis.z + n.z / length};}
+        }
+        float length = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+        meshlet->cone_axis = length > 0 ? (point3d) {axis.x / length, axis.y / length, axis.z / length} : (point3d) {0, 0, 1};
+        float cosine = length > 0 ? 1 : -1;
+        for (uint32_t i = meshlet->first_polygon; i < meshlet->last_polygon && cosine > 0; i++)
+        {
+            point3d n = face_normal(mesh, i);
+            float n_length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+            if (n_length > 0) {cosine = min_float(cosine, (n.x * meshlet->cone_axis.x + n.y * meshlet->cone_axis.y + n.z * meshlet->cone_axis.z) / n_length);}
+        }
+        //half a degree wider than measured, so a polygon seen almost edge on is left to the per polygon test, where rounding in
+        //the transform decides which way it faces
+        float sine = sqrtf(max_float(0, 1 - cosine * cosine));
+        float widened = cosine * 0.99996192f - sine * 0.00872654f;
+        meshlet->cone_cosine = widened;
+        meshlet->cone_sine = widened > 0 ? sqrtf(1 - widened * widened) : 1;
+    }
+}
+
+void free_mesh(mesh_t* mesh)
+{
+    wait_lod_build(mesh);
+    for (int k = 0; k < mesh->number_of_lods; k++) {free_mesh(&mesh->lods[k]);}
+    free(mesh->lods);
+    if (mesh->cache.data)
+    {
+        unmap_file(&mesh->cache);
+    }
+    else
+    {
+        free(mesh->x);
+        free(mesh->y);
+        free(mesh->z);
+        free(mesh->indices);
+        free(mesh->normals);
+        free(mesh->colors);
+        free(mesh->bvh);
+        free(mesh->neighbors);
+        free(mesh->edge_angles);
+        free(mesh->meshlets);
+        free(mesh->shared_vertices);
+    }
+    free(mesh->qx);
+    free(mesh->qy);
+    free(mesh->qz);
+    free(mesh->packed_normals);
+    free(mesh->color_index);
+    free(mesh->palette);
+    free(mesh->packed_indices);
+    free(mesh->index_base);
+    free(mesh->wide_indices);
+    free(mesh->quantized_bvh);
+    memset(mesh, 0, sizeof(mesh_t));
+}
+
+int compact_mesh(mesh_t* mesh)
+{
+    //replaces the float positions, normals, colors, indices and bvh with the compact forms, returns 1 and leaves the mesh alone
+    //without memory
+    long long vertices = mesh->number_of_vertices;
+    long long polygons = mesh->number_of_polygons;
+    if (mesh->qx || vertices == 0) {return 0;}
+    uint16_t* qx = malloc(sizeof(uint16_t) * vertices);
+    uint16_t* qy = malloc(sizeof(uint16_t) * vertices);
+    uint16_t* qz = malloc(sizeof(uint16_t) * vertices);
+    uint32_t* packed_normals = malloc(sizeof(uint32_t) * polygons);
+    uint8_t* color_index = malloc(polygons);
+    color_t* palette = malloc(sizeof(color_t) * 256);
+    long long blocks = (polygons + INDEX_BLOCK - 1) / INDEX_BLOCK;
+    //the base of a block needs its top bit free, bigger meshes keep their 32 bit indices
+    int pack = vertices < WIDE_INDEX_BLOCK;
+    uint16_t* packed_indices = pack ? malloc(sizeof(uint16_t) * 3 * (polygons ? polygons : 1)) : NULL;
+    uint32_t* index_base = pack ? malloc(sizeof(uint32_t) * (blocks ? blocks : 1)) : NULL;
+    quantized_bvh_node_t* quantized_bvh = mesh->number_of_bvh_nodes ? malloc(sizeof(quantized_bvh_node_t) * mesh->number_of_bvh_nodes) : NULL;
+    if (!qx || !qy || !qz || !packed_normals || !color_index || !palette || (pack && (!packed_indices || !index_base)) || (mesh->number_of_bvh_nodes && !quantized_bvh))
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(qx);
+        free(qy);
+        free(qz);
+        free(packed_normals);
+        free(color_index);
+        free(palette);
+        free(packed_indices);
+        free(index_base);
+        free(quantized_bvh);
+        return 1;
+    }
+
+    //65536 steps across the bounding box, a flat axis keeps a step of 0
+    point3d low = mesh->low;
+    point3d step = {(mesh->high.x - low.x) / 65535, (mesh->high.y - low.y) / 65535, (mesh->high.z - low.z) / 65535};
+    float* streams[3] = {mesh->x, mesh->y, mesh->z};
+    uint16_t* quantized[3] = {qx, qy, qz};
+    float lows[3] = {low.x, low.y, low.z};
+    float steps[3] = {step.x, step.y, step.z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (long long v = 0; v < vertices; v++)
+        {
+            float q = steps[axis] > 0 ? (streams[axis][v] - lows[axis]) / steps[axis] + 0.5f : 0;
+            quantized[axis][v] = q < 0 ? 0 : q >= 65535 ? 65535 : (uint16_t) q;
+        }
+    }
+    for (long long i = 0; i < polygons; i++) {packed_normals[i] = encode_normal(mesh->normals[i]);}
+
+    //most models have one or two colors, more than 255 keeps the full colors; the last slot is left free so highlighting a
+    //polygon always finds room for its color
+    int palette_size = 0;
+    int last = 0;
+    for (long long i = 0; i < polygons && palette; i++)
+    {
+        color_t color = mesh->colors[i];
+        if (palette_size == 0 || palette[last] != color)
+        {
+            last = 0;
+            while (last < palette_size && palette[last] != color) {last++;}
+            if (last == palette_size)
+            {
+                if (palette_size == 255)
+                {
+                    free(palette);
+                    free(color_index);
+                    palette = NULL;
+                    color_index = NULL;
+                    palette_size = 0;
+                    break;
+                }
+                palette[palette_size++] = color;
+            }
+        }
+        color_index[i] = (uint8_t) last;
+    }
+
+    //a block whose vertices fit in 16 bits from its lowest is packed, the others are copied whole after the packed ones
+    uint32_t* wide_indices = NULL;
+    long long wide_blocks = 0;
+    for (long long b = 0; b < blocks && pack; b++)
+    {
+        long long first = b * INDEX_BLOCK * 3;
+        long long last = first + INDEX_BLOCK * 3 < polygons * 3 ? first + INDEX_BLOCK * 3 : polygons * 3;
+        uint32_t low_vertex = UINT32_MAX;
+        uint32_t high_vertex = 0;
+        for (long long k = first; k < last; k++)
+        {
+            low_vertex = mesh->indices[k] < low_vertex ? mesh->indices[k] : low_vertex;
+            high_vertex = mesh->indices[k] > high_vertex ? mesh->indices[k] : high_vertex;
+        }
+        if (high_vertex - low_vertex <= UINT16_MAX)
+        {
+            index_base[b] = low_vertex;
+            for (long long k = first; k < last; k++) {packed_indices[k] = (uint16_t) (mesh->indices[k] - low_vertex);}
+            continue;
+        }
+        if (wide_blocks % 16 == 0)
+        {
+            uint32_t* grown = realloc(wide_indices, sizeof(uint32_t) * INDEX_BLOCK * 3 * (wide_blocks + 16));
+            if (grown == NULL)
+            {
+                //not worth failing over, the mesh keeps all its indices as they are
+                pack = 0;
+                break;
+            }
+            wide_indices = grown;
+        }
+        index_base[b] = WIDE_INDEX_BLOCK | (uint32_t) wide_blocks;
+        memcpy(&wide_indices[wide_blocks * INDEX_BLOCK * 3], &mesh->indices[first], sizeof(uint32_t) * (last - first));
+        wide_blocks++;
+    }
+    if (!pack)
+    {
+        free(packed_indices);
+        free(index_base);
+        free(wide_indices);
+        packed_indices = NULL;
+        index_base = NULL;
+        wide_indices = NULL;
+    }
+
+    //the boxes are rebuilt from the rounded positions, children come after their parent so walking backwards has them ready
+    for (long long k = mesh->number_of_bvh_nodes - 1; k >= 0; k--)
+    {
+        const bvh_node_t* node = &mesh->bvh[k];
+        quantized_bvh_node_t* box = &quantized_bvh[k];
+        box->first = node->first;
+        box->count = node->count;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            box->low[axis] = UINT16_MAX;
+            box->high[axis] = 0;
+        }
+        if (node->count == 0)
+        {
+            const quantized_bvh_node_t* left = &quantized_bvh[node->first];
+            const quantized_bvh_node_t* right = &quantized_bvh[node->first + 1];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                box->low[axis] = left->low[axis] < right->low[axis] ? left->low[axis] : right->low[axis];
+                box->high[axis] = left->high[axis] > right->high[axis] ? left->high[axis] : right->high[axis];
+            }
+            continue;
+        }
+        for (long long corner = (long long) node->first * 3; corner < (long long) (node->first + node->count) * 3; corner++)
+        {
+            uint32_t v = mesh->indices[corner];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                uint16_t q = quantized[axis][v];
+                box->low[axis] = q < box->low[axis] ? q : box->low[axis];
+                box->high[axis] = q > box->high[axis] ? q : box->high[axis];
+            }
+        }
+    }
+
+    //arrays in a mapped cache are left to the mapping, their pages are dropped once nothing reads them
+    if (mesh->cache.data == NULL)
+    {
+        free(mesh->x);
+        free(mesh->y);
+        free(mesh->z);
+        free(mesh->normals);
+        if (palette) {free(mesh->colors);}
+        if (pack) {free(mesh->indices);}
+        free(mesh->bvh);
+    }
+    mesh->x = NULL;
+    mesh->y = NULL;
+    mesh->z = NULL;
+    mesh->normals = NULL;
+    if (palette) {mesh->colors = NULL;}
+    if (pack) {mesh->indices = NULL;}
+    mesh->bvh = NULL;
+    mesh->qx = qx;
+    mesh->qy = qy;
+    mesh->qz = qz;
+    mesh->quant_low = low;
+    mesh->quant_step = step;
+    mesh->packed_normals = packed_normals;
+    mesh->color_index = color_index;
+    mesh->palette = palette;
+    mesh->palette_size = palette_size;
+    mesh->packed_indices = packed_indices;
+    mesh->index_base = index_base;
+    mesh->wide_indices = wide_indices;
+    mesh->quantized_bvh = quantized_bvh;
+    //the spheres and cones follow the rounded positions
+    parallel_for(mesh->number_of_meshlets, 4096, meshlet_bounds, mesh);
+    touch_mesh(mesh);
+    return 0;
+}
+
+uint32_t encode_normal(point3d normal)
+{
+    //octahedral: project onto |x| + |y| + |z| = 1 and fold the lower half over, two snorm16 halves; -32768 marks no normal
+    float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (!(sum > 0)) {return 0x80008000u;}
+    float u = normal.x / sum;
+    float v = normal.y / sum;
+    if (normal.z < 0)
+    {
+        float folded_u = (1 - fabsf(v)) * (u >= 0 ? 1 : -1);
+        float folded_v = (1 - fabsf(u)) * (v >= 0 ? 1 : -1);
+        u = folded_u;
+        v = folded_v;
+    }
+    int16_t qu = (int16_t) (u * 32767.0f + (u >= 0 ? 0.5f : -0.5f));
+    int16_t qv = (int16_t) (v * 32767.0f + (v >= 0 ? 0.5f : -0.5f));
+    return (uint32_t) (uint16_t) qu | ((uint32_t) (uint16_t) qv << 16);
+}
+
+point3d decode_normal(uint32_t packed)
+{
+    int16_t qu = (int16_t) (packed & 0xffff);
+    int16_t qv = (int16_t) (packed >> 16);
+    if (qu == -32768) {return (point3d) {0, 0, 0};}
+    point3d normal = {qu / 32767.0f, qv / 32767.0f, 0};
+    normal.z = 1 - fabsf(normal.x) - fabsf(normal.y);
+    if (normal.z < 0)
+    {
+        float u = normal.x;
+        normal.x = (1 - fabsf(normal.y)) * (u >= 0 ? 1 : -1);
+        normal.y = (1 - fabsf(u)) * (normal.y >= 0 ? 1 : -1);
+    }
+    float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    return (point3d) {normal.x / length, normal.y / length, normal.z / length};
+}
+
+void set_mesh_color(mesh_t* mesh, long long i, color_t color)
+{
+    //a compact mesh takes the color from its palette, adding it while there is room; compact_mesh leaves room for one
+    if (mesh->color_index == NULL)
+    {
+        mesh->colors[i] = color;
+        return;
+    }
+    for (int k = 0; k < mesh->palette_size; k++)
+    {
+        if (mesh->palette[k] == color)
+        {
+            mesh->color_index[i] = (uint8_t) k;
+            return;
+        }
+    }
+    if (mesh->palette_size < 256)
+    {
+        mesh->palette[mesh->palette_size] = color;
+        mesh->color_index[i] = (uint8_t) mesh->palette_size++;
+    }
+}
+
+long long mesh_bytes(const mesh_t* mesh)
+{
+    //what the arrays the renderer reads take up, mapped or not
+    long long vertices = mesh->number_of_vertices;
+    long long polygons = mesh->number_of_polygons;
+    long long bytes = mesh->quantized_bvh ? sizeof(quantized_bvh_node_t) * mesh->number_of_bvh_nodes : sizeof(bvh_node_t) * mesh->number_of_bvh_nodes;
+    if (mesh->index_base)
+    {
+        long long blocks = (polygons + INDEX_BLOCK - 1) / INDEX_BLOCK;
+        long long wide = 0;
+        for (long long b = 0; b < blocks; b++) {wide += (mesh->index_base[b] & WIDE_INDEX_BLOCK) != 0;}
+        bytes += sizeof(uint16_t) * 3 * polygons + sizeof(uint32_t) * blocks + sizeof(uint32_t) * 3 * INDEX_BLOCK * wide;
+    }
+    else {bytes += sizeof(uint32_t) * 3 * polygons;}
+    bytes += mesh->qx ? sizeof(uint16_t) * 3 * vertices : sizeof(float) * 3 * vertices;
+    bytes += mesh->packed_normals ? sizeof(uint32_t) * polygons : sizeof(point3d) * polygons;
+    bytes += mesh->color_index ? polygons + sizeof(color_t) * 256 : sizeof(color_t) * polygons;
+    if (mesh->neighbors) {bytes += (sizeof(uint32_t) + 1) * 3 * polygons;}
+    bytes += sizeof(meshlet_t) * mesh->number_of_meshlets + sizeof(uint32_t) * 2 * mesh->number_of_shared_vertices;
+    return bytes;
+}
+
+uint32_t weld_hash(long long x, long long y, long long z)
+{
+    uint64_t h = (uint64_t) x * 73856093u ^ (uint64_t) y * 19349663u ^ (uint64_t) z * 83492791u;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+int build_bvh(mesh_t* mesh)
+{
+    //binned sah over polygon centroids, the top levels are split here and the subtrees below them in parallel
+    long long n = mesh->number_of_polygons;
+    mesh->bvh = NULL;
+    mesh->number_of_bvh_nodes = 0;
+    //an empty model has nothing to put in a tree, which is not an error
+    if (n == 0) {return 0;}
+    if (n >= 1 << 30) {return 1;}
+
+    bvh_build_t build = {.mesh = mesh};
+    build.low = malloc(sizeof(point3d) * n);
+    build.high = malloc(sizeof(point3d) * n);
+    build.centroid = malloc(sizeof(point3d) * n);
+    build.order = malloc(sizeof(uint32_t) * n);
+    build.nodes = malloc(sizeof(bvh_node_t) * n * 2);
+    build.tasks = malloc(sizeof(uint32_t) * n);
+    uint32_t* indices = malloc(sizeof(uint32_t) * n * 3);
+    point3d* normals = malloc(sizeof(point3d) * n);
+    color_t* colors = malloc(sizeof(color_t) * n);
+    uint32_t* remap = malloc(sizeof(uint32_t) * (mesh->number_of_vertices ? mesh->number_of_vertices : 1));
+    float* scratch = malloc(sizeof(float) * (mesh->number_of_vertices ? mesh->number_of_vertices : 1));
+    if (!build.low || !build.high || !build.centroid || !build.order || !build.nodes || !build.tasks || !indices || !normals || !colors || !remap || !scratch)
+    {
+        free(build.low); free(build.high); free(build.centroid); free(build.order); free(build.nodes); free(build.tasks);
+        free(indices); free(normals); free(colors); free(remap); free(scratch);
+        return 1;
+    }
+    parallel_for(n, 65536, bvh_polygon_bounds, &build);
+
+    bvh_node_t* root = &build.nodes[0];
+    root->low = build.low[0];
+    root->high = build.high[0];
+    for (long long i = 0; i < n; i++)
+    {
+        root->low = (point3d) {min_float(root->low.x, build.low[i].x), min_float(root->low.y, build.low[i].y), min_float(root->low.z, build.low[i].z)};
+        root->high = (point3d) {max_float(root->high.x, build.high[i].x), max_float(root->high.y, build.high[i].y), max_float(root->high.z, build.high[i].z)};
+    }
+    root->first = 0;
+    root->count = (uint32_t) n;
+    SDL_SetAtomicInt(&build.next_node, 1);
+
+    //enough subtrees that every core has several to take
+    int cores = SDL_GetNumLogicalCPUCores();
+    long long task_size = n / ((cores > 0 ? cores : 1) * 8);
+    if (task_size < 4096) {task_size = 4096;}
+    bvh_build_from(&build, 0, task_size);
+    parallel_for(build.number_of_tasks, 1, bvh_build_subtrees, &build);
+
+    //store the polygons in leaf order and number the vertices by first use, so a subtree is close together in memory
+    for (long long i = 0; i < mesh->number_of_vertices; i++) {remap[i] = UINT32_MAX;}
+    uint32_t next_vertex = 0;
+    for (long long i = 0; i < n; i++)
+    {
+        uint32_t source = build.order[i];
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t vertex = mesh->indices[source * 3 + k];
+            if (remap[vertex] == UINT32_MAX) {remap[vertex] = next_vertex++;}
+            indices[i * 3 + k] = remap[vertex];
+        }
+        normals[i] = mesh->normals[source];
+        colors[i] = mesh->colors[source];
+    }
+    free(mesh->indices);
+    free(mesh->normals);
+    free(mesh->colors);
+    mesh->indices = indices;
+    mesh->normals = normals;
+    mesh->colors = colors;
+
+    float* streams[3] = {mesh->x, mesh->y, mesh->z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        //vertices no polygon uses keep their relative order at the end
+        uint32_t unused = next_vertex;
+        for (long long i = 0; i < mesh->number_of_vertices; i++)
+        {
+            scratch[remap[i] == UINT32_MAX ? unused++ : remap[i]] = streams[axis][i];
+        }
+        memcpy(streams[axis], scratch, sizeof(float) * mesh->number_of_vertices);
+    }
+
+    mesh->number_of_bvh_nodes = SDL_GetAtomicInt(&build.next_node);
+    bvh_node_t* nodes = realloc(build.nodes, sizeof(bvh_node_t) * mesh->number_of_bvh_nodes);
+    mesh->bvh = nodes ? nodes : build.nodes;
+    free(build.low);
+    free(build.high);
+    free(build.centroid);
+    free(build.order);
+    free(build.tasks);
+    free(remap);
+    free(scratch);
+    return 0;
+}
+
+void bvh_polygon_bounds(void* data, long long first, long long last)
+{
+    bvh_build_t* build = data;
+    mesh_t* mesh = build->mesh;
+    for (long long i = first; i < last; i++)
+    {
+        uint32_t* index = &mesh->indices[i * 3];
+        point3d a = {mesh->x[index[0]], mesh->y[index[0]], mesh->z[index[0]]};
+        point3d b = {mesh->x[index[1]], mesh->y[index[1]], mesh->z[index[1]]};
+        point3d c = {mesh->x[index[2]], mesh->y[index[2]], mesh->z[index[2]]};
+        build->low[i] = (point3d) {min_float(a.x, min_float(b.x, c.x)), min_float(a.y, min_float(b.y, c.y)), min_float(a.z, min_float(b.z, c.z))};
+        build->high[i] = (point3d) {max_float(a.x, max_float(b.x, c.x)), max_float(a.y, max_float(b.y, c.y)), max_float(a.z, max_float(b.z, c.z))};
+        build->centroid[i] = (point3d) {(a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3, (a.z + b.z + c.z) / 3};
+        build->order[i] = (uint32_t) i;
+    }
+}
+
+void bvh_build_subtrees(void* data, long long first, long long last)
+{
+    bvh_build_t* build = data;
+    for (long long i = first; i < last; i++)
+    {
+        bvh_build_from(build, build->tasks[i], 0);
+    }
+}
+
+void bvh_build_from(bvh_build_t* build, uint32_t root, long long task_size)
+{
+    //depth first with an explicit stack, badly balanced splits can go far deeper than the call stack allows
+    long long capacity = 64;
+    uint32_t* stack = malloc(sizeof(uint32_t) * capacity);
+    if (stack == NULL) {return;}
+    long long top = 0;
+    stack[top++] = root;
+    while (top > 0)
+    {
+        bvh_node_t* node = &build->nodes[stack[--top]];
+        if (task_size && node->count <= task_size)
+        {
+            build->tasks[build->number_of_tasks++] = (uint32_t) (node - build->nodes);
+            continue;
+        }
+        if (!bvh_split_node(build, node)) {continue;}
+        if (top + 2 > capacity)
+        {
+            uint32_t* grown = realloc(stack, sizeof(uint32_t) * capacity * 2);
+            if (grown == NULL) {break;}
+            stack = grown;
+            capacity *= 2;
+        }
+        stack[top++] = node->first + 1;
+        stack[top++] = node->first;
+    }
+    free(stack);
+}
+
+int bvh_split_node(bvh_build_t* build, bvh_node_t* node)
+{
+    //turns node into an inner node with two children, or returns 0 when it is better left as a leaf
+    if (node->count <= 2) {return 0;}
+    uint32_t* order = build->order + node->first;
+
+    point3d centroid_low = build->centroid[order[0]];
+    point3d centroid_high = centroid_low;
+    for (uint32_t i = 1; i < node->count; i++)
+    {
+        point3d c = build->centroid[order[i]];
+        centroid_low = (point3d) {min_float(centroid_low.x, c.x), min_float(centroid_low.y, c.y), min_float(centroid_low.z, c.z)};
+        centroid_high = (point3d) {max_float(centroid_high.x, c.x), max_float(centroid_high.y, c.y), max_float(centroid_high.z, c.z)};
+    }
+
+    float best_cost = INFINITY;
+    int best_axis = -1;
+    int best_split = 0;
+    point3d best_low[2];
+    point3d best_high[2];
+    uint32_t best_count = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float low = (&centroid_low.x)[axis];
+        float extent = (&centroid_high.x)[axis] - low;
+        if (!(extent > 0)) {continue;}
+        float scale = BVH_BINS / extent;
+
+        uint32_t counts[BVH_BINS] = {0};
+        point3d bin_low[BVH_BINS];
+        point3d bin_high[BVH_BINS];
+        for (int k = 0; k < BVH_BINS; k++)
+        {
+            bin_low[k] = (point3d) {INFINITY, INFINITY, INFINITY};
+            bin_high[k] = (point3d) {-INFINITY, -INFINITY, -INFINITY};
+        }
+        for (uint32_t i = 0; i < node->count; i++)
+        {
+            uint32_t polygon = order[i];
+            int bin = (int) (((&build->centroid[polygon].x)[axis] - low) * scale);
+            if (bin > BVH_BINS - 1) {bin = BVH_BINS - 1;}
+            counts[bin]++;
+            point3d l = build->low[polygon];
+            point3d h = build->high[polygon];
+            bin_low[bin] = (point3d) {min_float(bin_low[bin].x, l.x), min_float(bin_low[bin].y, l.y), min_float(bin_low[bin].z, l.z)};
+            bin_high[bin] = (point3d) {max_float(bin_high[bin].x, h.x), max_float(bin_high[bin].y, h.y), max_float(bin_high[bin].z, h.z)};
+        }
+
+        //sweep from the right to get the cost of everything after each split plane
+        float right_area[BVH_BINS];
+        uint32_t right_count[BVH_BINS];
+        point3d right_low[BVH_BINS];
+        point3d right_high[BVH_BINS];
+        point3d l = {INFINITY, INFINITY, INFINITY};
+        point3d h = {-INFINITY, -INFINITY, -INFINITY};
+        uint32_t count = 0;
+        for (int k = BVH_BINS - 1; k > 0; k--)
+        {
+            count += counts[k];
+            l = (point3d) {min_float(l.x, bin_low[k].x), min_float(l.y, bin_low[k].y), min_float(l.z, bin_low[k].z)};
+            h = (point3d) {max_float(h.x, bin_high[k].x), max_float(h.y, bin_high[k].y), max_float(h.z, bin_high[k].z)};
+            point3d d = {h.x - l.x, h.y - l.y, h.z - l.z};
+            right_area[k] = count ? d.x * d.y + d.y * d.z + d.z * d.x : 0;
+            right_count[k] = count;
+            right_low[k] = l;
+            right_high[k] = h;
+        }
+        l = (point3d) {INFINITY, INFINITY, INFINITY};
+        h = (point3d) {-INFINITY, -INFINITY, -INFINITY};
+        count = 0;
+        for (int k = 0; k < BVH_BINS - 1; k++)
+        {
+            count += counts[k];
+            l = (point3d) {min_float(l.x, bin_low[k].x), min_float(l.y, bin_low[k].y), min_float(l.z, bin_low[k].z)};
+            h = (point3d) {max_float(h.x, bin_high[k].x), max_float(h.y, bin_high[k].y), max_float(h.z, bin_high[k].z)};
+            if (count == 0 || right_count[k + 1] == 0) {continue;}
+            point3d d = {h.x - l.x, h.y - l.y, h.z - l.z};
+            float cost = (d.x * d.y + d.y * d.z + d.z * d.x) * count + right_area[k + 1] * right_count[k + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = k + 1;
+                best_low[0] = l;
+                best_high[0] = h;
+                best_low[1] = right_low[k + 1];
+                best_high[1] = right_high[k + 1];
+                best_count = count;
+            }
+        }
+    }
+    if (best_axis < 0) {return 0;}
+
+    //visiting a node costs about as much as culling four polygons with simd
+    point3d d = {node->high.x - node->low.x, node->high.y - node->low.y, node->high.z - node->low.z};
+    float area = d.x * d.y + d.y * d.z + d.z * d.x;
+    if (node->count <= BVH_LEAF_SIZE && area > 0 && 4 + best_cost / area >= node->count) {return 0;}
+
+    float low = (&centroid_low.x)[best_axis];
+    float scale = BVH_BINS / ((&centroid_high.x)[best_axis] - low);
+    uint32_t left = 0;
+    uint32_t right = node->count;
+    while (left < right)
+    {
+        int bin = (int) (((&build->centroid[order[left]].x)[best_axis] - low) * scale);
+        if (bin > BVH_BINS - 1) {bin = BVH_BINS - 1;}
+        if (bin < best_split) {left++;}
+        else
+        {
+            uint32_t swap = order[left];
+            order[left] = order[--right];
+            order[right] = swap;
+        }
+    }
+
+    uint32_t child = (uint32_t) SDL_AddAtomicInt(&build->next_node, 2);
+    build->nodes[child] = (bvh_node_t) {best_low[0], best_high[0], node->first, best_count};
+    build->nodes[child + 1] = (bvh_node_t) {best_low[1], best_high[1], node->first + best_count, node->count - best_count};
+    node->first = child;
+    node->count = 0;
+    return 1;
+}
+
+void bvh_collect_runs(raster_state_t* state, mesh_t* mesh)
+{
+    //walk the bvh against the planes of the view volume, a node outside one plane is skipped with everything below it
+    state->number_of_runs = 0;
+    if (state->runs_allocated == 0)
+    {
+        state->runs = malloc(sizeof(polygon_run_t) * 64);
+        state->run_offsets = malloc(sizeof(long long) * 65);
+        if (state->runs == NULL || state->run_offsets == NULL) {return;}
+        state->runs_allocated = 64;
+    }
+    if (mesh->number_of_bvh_nodes == 0)
+    {
+        state->runs[0] = (polygon_run_t) {0, (uint32_t) mesh->number_of_polygons};
+        state->run_offsets[0] = 0;
+        state->run_offsets[1] = mesh->number_of_polygons;
+        state->number_of_runs = 1;
+        return;
+    }
+
+    float planes[5][4];
+    view_planes(state, planes);
+
+    //the stack holds node and plane mask pairs, a plane is dropped once a node is fully inside it
+    if (state->stack_allocated < 128)
+    {
+        uint32_t* stack = realloc(state->stack, sizeof(uint32_t) * 128);
+        if (stack == NULL) {return;}
+        state->stack = stack;
+        state->stack_allocated = 128;
+    }
+    long long top = 0;
+    state->stack[top++] = 0;
+    state->stack[top++] = 0x1f;
+    while (top > 0)
+    {
+        uint32_t mask = state->stack[--top];
+        bvh_node_t node = mesh_bvh_node(mesh, state->stack[--top]);
+        int outside = 0;
+        for (int k = 0; k < 5 && !outside; k++)
+        {
+            if (!(mask & (1 << k))) {continue;}
+            float* p = planes[k];
+            float most = p[3] + max_float(p[0] * node.low.x, p[0] * node.high.x) + max_float(p[1] * node.low.y, p[1] * node.high.y) + max_float(p[2] * node.low.z, p[2] * node.high.z);
+            float least = p[3] + min_float(p[0] * node.low.x, p[0] * node.high.x) + min_float(p[1] * node.low.y, p[1] * node.high.y) + min_float(p[2] * node.low.z, p[2] * node.high.z);
+            //in front of the perspective plane means w > 0, the others allow touching
+            if (k == 4 ? most <= 0 : most < 0) {outside = 1;}
+            else if (k == 4 ? least > 0 : least >= 0) {mask &= ~(1u << k);}
+        }
+        if (outside) {continue;}
+
+        uint32_t first = node.first;
+        uint32_t last = node.first + node.count;
+        if (node.count == 0 && mask == 0)
+        {
+            //inside the whole view, the subtree is one run from its leftmost to its rightmost leaf
+            bvh_node_t edge = node;
+            while (edge.count == 0) {edge = mesh_bvh_node(mesh, edge.first);}
+            first = edge.first;
+            edge = node;
+            while (edge.count == 0) {edge = mesh_bvh_node(mesh, edge.first + 1);}
+            last = edge.first + edge.count;
+        }
+        else if (node.count == 0)
+        {
+            if (top + 4 > state->stack_allocated)
+            {
+                uint32_t* stack = realloc(state->stack, sizeof(uint32_t) * state->stack_allocated * 2);
+                if (stack == NULL) {continue;}
+                state->stack = stack;
+                state->stack_allocated *= 2;
+            }
+            //right first so the left subtree comes out first and the runs stay in polygon order
+            state->stack[top++] = node.first + 1;
+            state->stack[top++] = mask;
+            state->stack[top++] = node.first;
+            state->stack[top++] = mask;
+            continue;
+        }
+
+        if (state->number_of_runs > 0 && state->runs[state->number_of_runs - 1].last == first)
+        {
+            state->runs[state->number_of_runs - 1].last = last;
+        }
+        else
+        {
+            if (state->number_of_runs == state->runs_allocated)
+            {
+                polygon_run_t* runs = realloc(state->runs, sizeof(polygon_run_t) * state->runs_allocated * 2);
+                long long* offsets = realloc(state->run_offsets, sizeof(long long) * (state->runs_allocated * 2 + 1));
+                if (runs) {state->runs = runs;}
+                if (offsets) {state->run_offsets = offsets;}
+                if (runs == NULL || offsets == NULL) {continue;}
+                state->runs_allocated *= 2;
+            }
+            state->runs[state->number_of_runs++] = (polygon_run_t) {first, last};
+        }
+    }
+
+    state->run_offsets[0] = 0;
+    for (long long r = 0; r < state->number_of_runs; r++)
+    {
+        state->run_offsets[r + 1] = state->run_offsets[r] + state->runs[r].last - state->runs[r].first;
+    }
+}
+
+void view_planes(const raster_state_t* state, float planes[5][4])
+{
+    //screen x = X / W and y = Y / W, so 0 <= x <= width becomes X >= 0 and width * W - X >= 0; the last plane is W = 0
+    const float (*m)[4] = state->matrix.m;
+    for (int k = 0; k < 4; k++)
+    {
+        planes[0][k] = m[0][k];
+        planes[1][k] = state->target->width * m[3][k] - m[0][k];
+        planes[2][k] = m[1][k];
+        planes[3][k] = state->target->height * m[3][k] - m[1][k];
+        planes[4][k] = m[3][k];
+    }
+}
+
+int cull_meshlets(raster_state_t* state, mesh_t* mesh)
+{
+    //narrows the bvh runs down to the meshlets that are on screen, in front of the perspective plane and not turned away, and
+    //lists those meshlets for the transform; returns 1 and leaves the runs alone without memory
+    if (mesh->number_of_meshlets > state->meshlet_stamps_allocated)
+    {
+        uint32_t* stamps = calloc(mesh->number_of_meshlets, sizeof(uint32_t));
+        uint32_t* visible = malloc(sizeof(uint32_t) * mesh->number_of_meshlets);
+        uint8_t* phases = malloc(mesh->number_of_meshlets);
+        uint32_t* seen = calloc(mesh->number_of_meshlets, sizeof(uint32_t));
+        uint32_t* rotated = calloc(mesh->number_of_meshlets, sizeof(uint32_t));
+        uint32_t* projected = calloc(mesh->number_of_meshlets, sizeof(uint32_t));
+        if (stamps == NULL || visible == NULL || phases == NULL || seen == NULL || rotated == NULL || projected == NULL)
+        {
+            free(stamps);
+            free(visible);
+            free(phases);
+            free(seen);
+            free(rotated);
+            free(projected);
+            return 1;
+        }
+        free(state->meshlet_stamps);
+        free(state->visible_meshlets);
+        free(state->meshlet_phases);
+        free(state->meshlet_seen);
+        free(state->meshlet_rotated);
+        free(state->meshlet_projected);
+        state->meshlet_stamps = stamps;
+        state->visible_meshlets = visible;
+        state->meshlet_phases = phases;
+        state->meshlet_seen = seen;
+        state->meshlet_rotated = rotated;
+        state->meshlet_projected = projected;
+        state->occlusion_mesh = NULL;
+        state->meshlet_stamps_allocated = mesh->number_of_meshlets;
+        state->meshlet_stamp = 0;
+    }
+    //a run is cut at most at both ends of every meshlet it touches
+    long long most = state->number_of_runs + mesh->number_of_meshlets;
+    if (most > state->meshlet_runs_allocated)
+    {
+        polygon_run_t* runs = realloc(state->meshlet_runs, sizeof(polygon_run_t) * most);
+        uint32_t* owners = realloc(state->meshlet_run_owners, sizeof(uint32_t) * most);
+        if (runs) {state->meshlet_runs = runs;}
+        if (owners) {state->meshlet_run_owners = owners;}
+        if (runs == NULL || owners == NULL) {return 1;}
+        state->meshlet_runs_allocated = most;
+    }
+    if (++state->meshlet_stamp == 0)
+    {
+        memset(state->meshlet_stamps, 0, sizeof(uint32_t) * state->meshlet_stamps_allocated);
+        memset(state->meshlet_seen, 0, sizeof(uint32_t) * state->meshlet_stamps_allocated);
+        state->meshlet_stamp = 1;
+    }
+
+    float planes[5][4];
+    view_planes(state, planes);
+    const meshlet_t* meshlets = mesh->meshlets;
+    long long number_of_runs = 0;
+    long long tested = 0;
+    state->number_of_visible_meshlets = 0;
+    state->meshlets_culled = 0;
+    //runs and meshlets are both in polygon order, so one pass over each is enough; a meshlet across two runs is tested once
+    long long m = 0;
+    for (long long r = 0; r < state->number_of_runs; r++)
+    {
+        polygon_run_t run = state->runs[r];
+        while (m < mesh->number_of_meshlets && meshlets[m].last_polygon <= run.first) {m++;}
+        for (; m < mesh->number_of_meshlets && meshlets[m].first_polygon < run.last; m++)
+        {
+            if (m >= tested)
+            {
+                tested = m + 1;
+                if (meshlet_visible(state, &meshlets[m], planes))
+                {
+                    state->meshlet_stamps[m] = state->meshlet_stamp;
+                    state->meshlet_phases[m] = MESHLET_EARLY;
+                    state->visible_meshlets[state->number_of_visible_meshlets++] = (uint32_t) m;
+                }
+                else {state->meshlets_culled++;}
+            }
+            if (state->meshlet_stamps[m] == state->meshlet_stamp)
+            {
+                uint32_t first = meshlets[m].first_polygon > run.first ? meshlets[m].first_polygon : run.first;
+                uint32_t last = meshlets[m].last_polygon < run.last ? meshlets[m].last_polygon : run.last;
+                state->meshlet_run_owners[number_of_runs] = (uint32_t) m;
+                state->meshlet_runs[number_of_runs++] = (polygon_run_t) {first, last};
+            }
+            if (meshlets[m].last_polygon > run.last) {break;}
+        }
+    }
+
+    //room for every piece up front, so picking a phase's runs out of them later cannot fail
+    if (number_of_runs > state->runs_allocated)
+    {
+        polygon_run_t* runs = realloc(state->runs, sizeof(polygon_run_t) * number_of_runs);
+        long long* offsets = realloc(state->run_offsets, sizeof(long long) * (number_of_runs + 1));
+        if (runs) {state->runs = runs;}
+        if (offsets) {state->run_offsets = offsets;}
+        if (runs == NULL || offsets == NULL) {return 1;}
+        state->runs_allocated = number_of_runs;
+    }
+    state->number_of_meshlet_runs = number_of_runs;
+    select_meshlet_runs(state, MESHLET_EARLY);
+    return 0;
+}
+
+void select_meshlet_runs(raster_state_t* state, int phase)
+{
+    //the runs become the pieces of the meshlets in the phase, pieces that meet are joined
+    long long number_of_runs = 0;
+    for (long long k = 0; k < state->number_of_meshlet_runs; k++)
+    {
+        if (state->meshlet_phases[state->meshlet_run_owners[k]] != phase) {continue;}
+        polygon_run_t run = state->meshlet_runs[k];
+        if (number_of_runs > 0 && state->runs[number_of_runs - 1].last == run.first) {state->runs[number_of_runs - 1].last = run.last;}
+        else {state->runs[number_of_runs++] = run;}
+    }
+    state->number_of_runs = number_of_runs;
+    state->run_offsets[0] = 0;
+    for (long long r = 0; r < number_of_runs; r++)
+    {
+        state->run_offsets[r + 1] = state->run_offsets[r] + state->runs[r].last - state->runs[r].first;
+    }
+}
+
+int split_meshlets(raster_state_t* state, mesh_t* mesh)
+{
+    //the visible meshlets that were not occluded last frame go early and the rest late; returns 0 and moves nothing when
+    //none would go early, the frame is then drawn at once
+    int history = state->occlusion_mesh == mesh;
+    state->occlusion_mesh = mesh;
+    if (!history) {return 0;}
+    uint32_t last_frame = state->meshlet_stamp - 1;
+    long long early = 0;
+    for (long long k = 0; k < state->number_of_visible_meshlets; k++)
+    {
+        if (state->meshlet_seen[state->visible_meshlets[k]] == last_frame) {early++;}
+    }
+    if (early == 0) {return 0;}
+    for (long long k = 0; k < state->number_of_visible_meshlets; k++)
+    {
+        uint32_t m = state->visible_meshlets[k];
+        state->meshlet_phases[m] = state->meshlet_seen[m] == last_frame ? MESHLET_EARLY : MESHLET_LATE;
+    }
+    select_meshlet_runs(state, MESHLET_EARLY);
+    return 1;
+}
+
+void transform_meshlets(raster_state_t* state, mesh_t* mesh, const view_matrix_t* vertex_matrix, int phase)
+{
+    //the vertices each meshlet of the phase brings in are a range, consecutive meshlets that need the same work make one
+    //longer range for the kernels; a meshlet done in the current epochs is left as it is
+    const meshlet_t* list = mesh->meshlets;
+    const uint8_t* phases = state->meshlet_phases;
+    for (long long k = 0; k < state->number_of_visible_meshlets;)
+    {
+        uint32_t m = state->visible_meshlets[k];
+        int rotate = state->meshlet_rotated[m] != state->rotation_epoch;
+        int project = state->meshlet_projected[m] != state->projection_epoch;
+        if (phases[m] != phase || !project) {k++; continue;}
+        uint32_t first = list[m].first_vertex;
+        uint32_t last = list[m].last_vertex;
+        for (k++; k < state->number_of_visible_meshlets; k++)
+        {
+            uint32_t next = state->visible_meshlets[k];
+            if (phases[next] != phase || list[next].first_vertex != last) {break;}
+            if ((state->meshlet_rotated[next] != state->rotation_epoch) != rotate || state->meshlet_projected[next] == state->projection_epoch) {break;}
+            last = list[next].last_vertex;
+        }
+        transform_range(state, mesh, vertex_matrix, first, last - first, rotate);
+    }
+    for (long long k = 0; k < state->number_of_visible_meshlets; k++)
+    {
+        uint32_t m = state->visible_meshlets[k];
+        if (phases[m] != phase) {continue;}
+        state->meshlet_rotated[m] = state->rotation_epoch;
+        state->meshlet_projected[m] = state->projection_epoch;
+    }
+    //a vertex shared with a meshlet that was culled, or is not transformed yet, is done on its own, once however many
+    //meshlets share it; the caller moves the vertex stamp on once a frame
+    int stamped = state->vertex_stamps_allocated >= mesh->number_of_vertices;
+    for (long long k = 0; k < state->number_of_visible_meshlets; k++)
+    {
+        if (phases[state->visible_meshlets[k]] != phase) {continue;}
+        const meshlet_t* meshlet = &list[state->visible_meshlets[k]];
+        const uint32_t* shared = &mesh->shared_vertices[(long long) meshlet->first_shared * 2];
+        for (uint32_t s = 0; s < meshlet->number_of_shared; s++)
+        {
+            uint32_t v = shared[s * 2];
+            uint32_t owner = shared[s * 2 + 1];
+            if (state->meshlet_stamps[owner] == state->meshlet_stamp && phases[owner] <= phase) {continue;}
+            //nor when its owner was done in this projection, even in a frame before
+            if (state->meshlet_projected[owner] == state->projection_epoch) {continue;}
+            if (stamped)
+            {
+                if (state->vertex_stamps[v] == state->stamp) {continue;}
+                state->vertex_stamps[v] = state->stamp;
+            }
+            transform_range(state, mesh, vertex_matrix, v, 1, state->meshlet_rotated[owner] != state->rotation_epoch);
+        }
+    }
+}
+
+void build_depth_pyramid(raster_state_t* state, thread_pool_t* pool)
+{
+    //levels halve until the whole target fits in a few cells; the first level is split between the threads, the others
+    //are a third of its size together and are done here
+    int width = state->target->width;
+    int height = state->target->height;
+    long long total = 0;
+    int levels = 1;
+    state->pyramid_width[0] = width;
+    state->pyramid_height[0] = height;
+    state->pyramid_offsets[0] = 0;
+    while (levels < 16 && (width > 4 || height > 4))
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        state->pyramid_width[levels] = width;
+        state->pyramid_height[levels] = height;
+        state->pyramid_offsets[levels] = total;
+        total += (long long) width * height;
+        levels++;
+    }
+    state->pyramid_levels = 1;
+    if (total > state->pyramid_allocated)
+    {
+        free(state->pyramid);
+        state->pyramid = malloc(sizeof(float) * total);
+        state->pyramid_allocated = state->pyramid ? total : 0;
+        //without it nothing is occluded
+        if (state->pyramid == NULL) {return;}
+    }
+    if (levels > 1)
+    {
+        state->pyramid_levels = 2;
+        pool_run(pool, reduce_depth_rows, state, state->chunks);
+    }
+    for (; state->pyramid_levels < levels; state->pyramid_levels++)
+    {
+        reduce_depth_rows(state, -1, 0);
+    }
+}
+
+void reduce_depth_rows(void* data, int band, int worker)
+{
+    //fills a share of the rows of the newest level from the one before, or all of them with band -1
+    raster_state_t* state = data;
+    int level = state->pyramid_levels - 1;
+    int source_width = state->pyramid_width[level - 1];
+    int source_height = state->pyramid_height[level - 1];
+    const float* source = level == 1 ? state->depth : state->pyramid + state->pyramid_offsets[level - 1];
+    int width = state->pyramid_width[level];
+    int height = state->pyramid_height[level];
+    float* cells = state->pyramid + state->pyramid_offsets[level];
+    int first = band < 0 ? 0 : (int) ((long long) height * band / state->chunks);
+    int last = band < 0 ? height : (int) ((long long) height * (band + 1) / state->chunks);
+    for (int y = first; y < last; y++)
+    {
+        const float* top = source + (long long) y * 2 * source_width;
+        //an odd last row or column is its own pair
+        const float* bottom = y * 2 + 1 < source_height ? top + source_width : top;
+        float* row = cells + (long long) y * width;
+        for (int x = 0; x < width; x++)
+        {
+            int right = x * 2 + 1 < source_width ? x * 2 + 1 : x * 2;
+            row[x] = min_float(min_float(top[x * 2], top[right]), min_float(bottom[x * 2], bottom[right]));
+        }
+    }
+}
+
+void occlude_meshlets(raster_state_t* state, mesh_t* mesh)
+{
+    //tests every visible meshlet against the pyramid; the late ones that are hidden are occluded this frame, and all that
+    //are not hidden are remembered to go early next frame
+    const meshlet_t* meshlets = mesh->meshlets;
+    state->meshlets_occluded = 0;
+    state->occlusion_culled = 0;
+    for (long long k = 0; k < state->number_of_visible_meshlets; k++)
+    {
+        uint32_t m = state->visible_meshlets[k];
+        if (!sphere_occluded(state, meshlets[m].center, meshlets[m].radius)) {state->meshlet_seen[m] = state->meshlet_stamp;}
+        else if (state->meshlet_phases[m] == MESHLET_LATE)
+        {
+            state->meshlet_phases[m] = MESHLET_OCCLUDED;
+            state->meshlets_occluded++;
+        }
+    }
+    if (state->meshlets_occluded == 0) {return;}
+    for (long long k = 0; k < state->number_of_meshlet_runs; k++)
+    {
+        polygon_run_t run = state->meshlet_runs[k];
+        if (state->meshlet_phases[state->meshlet_run_owners[k]] == MESHLET_OCCLUDED) {state->occlusion_culled += run.last - run.first;}
+    }
+}
+
+int sphere_occluded(const raster_state_t* state, point3d center, float radius)
+{
+    //the screen bounds of the sphere come from the ranges of X, Y and W over it, and it is hidden when its nearest depth is
+    //behind the farthest depth over those bounds; line_bias keeps outlines that show through with their slack and covers
+    //the rounding of the depth the fill interpolates
+    const float (*m)[4] = state->matrix.m;
+    float value[4];
+    float reach[4];
+    for (int k = 0; k < 4; k++)
+    {
+        value[k] = m[k][0] * center.x + m[k][1] * center.y + m[k][2] * center.z + m[k][3];
+        reach[k] = radius * sqrtf(m[k][0] * m[k][0] + m[k][1] * m[k][1] + m[k][2] * m[k][2]);
+    }
+    float w_low = value[3] - reach[3];
+    float w_high = value[3] + reach[3];
+    if (!(w_low > 0)) {return 0;}
+    float x0 = min_float((value[0] - reach[0]) / w_low, (value[0] - reach[0]) / w_high);
+    float x1 = max_float((value[0] + reach[0]) / w_low, (value[0] + reach[0]) / w_high);
+    float y0 = min_float((value[1] - reach[1]) / w_low, (value[1] - reach[1]) / w_high);
+    float y1 = max_float((value[1] + reach[1]) / w_low, (value[1] + reach[1]) / w_high);
+    float nearest = value[2] + reach[2] + state->line_bias;
+    int width = state->target->width;
+    int height = state->target->height;
+    if (!(x1 >= 0 && y1 >= 0 && x0 < width && y0 < height && nearest == nearest)) {return 0;}
+    //a pixel either side, the rasterizer samples pixel centres
+    int px0 = x0 < 1 ? 0 : (int) x0 - 1;
+    int py0 = y0 < 1 ? 0 : (int) y0 - 1;
+    int px1 = x1 >= width - 1 ? width - 1 : (int) x1 + 1;
+    int py1 = y1 >= height - 1 ? height - 1 : (int) y1 + 1;
+
+    //the finest level where the bounds cover at most four cells each way
+    int level = 0;
+    while (level + 1 < state->pyramid_levels && ((px1 >> level) - (px0 >> level) > 3 || (py1 >> level) - (py0 >> level) > 3)) {level++;}
+    const float* cells = level == 0 ? state->depth : state->pyramid + state->pyramid_offsets[level];
+    int cells_width = state->pyramid_width[level];
+    for (int y = py0 >> level; y <= py1 >> level; y++)
+    {
+        for (int x = px0 >> level; x <= px1 >> level; x++)
+        {
+            if (!(cells[(long long) y * cells_width + x] > nearest)) {return 0;}
+        }
+    }
+    return 1;
+}
+
+int meshlet_visible(const raster_state_t* state, const meshlet_t* meshlet, float planes[5][4])
+{
+    //the sphere against the planes of the view volume as the bvh does with its boxes
+    point3d c = meshlet->center;
+    for (int k = 0; k < 5; k++)
+    {
+        float* p = planes[k];
+        float distance = p[0] * c.x + p[1] * c.y + p[2] * c.z + p[3];
+        float reach = meshlet->radius * sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        if (k == 4 ? distance + reach <= 0 : distance + reach < 0) {return 0;}
+    }
+    if (!settings.occlude || !(meshlet->cone_cosine > 0)) {return 1;}
+
+    //as in faces_viewer a polygon faces the viewer when its normal has a positive dot product with 2 * axis - p * corner;
+    //over the sphere that vector is d = 2 * axis - p * center give or take |p| * radius, and over the cone the normals come
+    //at most cone angle closer to d than the axis does, so the largest dot product is |d| cos(angle to d - cone angle) + |p| r
+    const float* axis = state->matrix.rotation[2];
+    float p = settings.perspective;
+    point3d d = {2 * axis[0] - p * c.x, 2 * axis[1] - p * c.y, 2 * axis[2] - p * c.z};
+    float along = d.x * meshlet->cone_axis.x + d.y * meshlet->cone_axis.y + d.z * meshlet->cone_axis.z;
+    float across = sqrtf(max_float(0, d.x * d.x + d.y * d.y + d.z * d.z - along * along));
+    return along * meshlet->cone_cosine + across * meshlet->cone_sine + fabsf(p) * meshlet->radius >= 0;
+}
+
+long long pick_polygon(mesh_t* mesh, const view_matrix_t* matrix, float x, float y, point3d* hit)
+{
+    //the pixel is a line in model space, where X - x * W = 0 and Y - y * W = 0; returns the nearest polygon on it or -1
+    const float (*m)[4] = matrix->m;
+    float r0[4];
+    float r1[4];
+    for (int k = 0; k < 4; k++)
+    {
+        r0[k] = m[0][k] - x * m[3][k];
+        r1[k] = m[1][k] - y * m[3][k];
+    }
+    point3d a = {r0[0], r0[1], r0[2]};
+    point3d b = {r1[0], r1[1], r1[2]};
+    point3d direction = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    float length = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+    if (!(length > 0)) {return -1;}
+    //the point on the line closest to the origin
+    point3d bd = {b.y * direction.z - b.z * direction.y, b.z * direction.x - b.x * direction.z, b.x * direction.y - b.y * direction.x};
+    point3d da = {direction.y * a.z - direction.z * a.y, direction.z * a.x - direction.x * a.z, direction.x * a.y - direction.y * a.x};
+    point3d origin = {(-r0[3] * bd.x - r1[3] * da.x) / length, (-r0[3] * bd.y - r1[3] * da.y) / length, (-r0[3] * bd.z - r1[3] * da.z) / length};
+
+    //larger view z is nearer, so walk away from the viewer and keep the smallest t
+    const float* toward = matrix->rotation[2];
+    if (toward[0] * direction.x + toward[1] * direction.y + toward[2] * direction.z > 0)
+    {
+        direction = (point3d) {-direction.x, -direction.y, -direction.z};
+    }
+    float t_min = -INFINITY;
+    float t_max = INFINITY;
+    //only points with w > 0 are in front of the eye
+    float w0 = m[3][0] * origin.x + m[3][1] * origin.y + m[3][2] * origin.z + m[3][3];
+    float wd = m[3][0] * direction.x + m[3][1] * direction.y + m[3][2] * direction.z;
+    if (wd > 0) {t_min = -w0 / wd;}
+    else if (wd < 0) {t_max = -w0 / wd;}
+    else if (!(w0 > 0)) {return -1;}
+
+    long long best = -1;
+    float best_t = t_max;
+    if (mesh->number_of_polygons == 0) {return -1;}
+    point3d inverse = {1 / direction.x, 1 / direction.y, 1 / direction.z};
+    bvh_node_t whole = {mesh->low, mesh->high, 0, (uint32_t) mesh->number_of_polygons};
+    //a depth first walk never holds more than one entry per node
+    uint32_t* stack = malloc(sizeof(uint32_t) * (mesh->number_of_bvh_nodes ? mesh->number_of_bvh_nodes : 1));
+    if (stack == NULL) {return -1;}
+    long long top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        uint32_t n = stack[--top];
+        bvh_node_t node = mesh->number_of_bvh_nodes ? mesh_bvh_node(mesh, n) : whole;
+        if (!ray_box(origin, inverse, node.low, node.high, t_min, best_t)) {continue;}
+        if (node.count == 0)
+        {
+            stack[top++] = node.first + 1;
+            stack[top++] = node.first;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            uint32_t index[3];
+            mesh_indices(mesh, i, index);
+            point3d p[3];
+            for (int k = 0; k < 3; k++) {p[k] = mesh_vertex(mesh, index[k]);}
+            float t = ray_triangle(origin, direction, p[0], p[1], p[2]);
+            if (t > t_min && t < best_t)
+            {
+                best_t = t;
+                best = i;
+            }
+        }
+    }
+    free(stack);
+    if (best >= 0 && hit)
+    {
+        *hit = (point3d) {origin.x + direction.x * best_t, origin.y + direction.y * best_t, origin.z + direction.z * best_t};
+    }
+    return best;
+}
+
+int ray_box(point3d origin, point3d inverse, point3d low, point3d high, float t_min, float t_max)
+{
+    //slab test, fminf and fmaxf drop the nan from an axis the ray runs along
+    float t0 = (low.x - origin.x) * inverse.x;
+    float t1 = (high.x - origin.x) * inverse.x;
+    t_min = fmaxf(t_min, fminf(t0, t1));
+    t_max = fminf(t_max, fmaxf(t0, t1));
+    t0 = (low.y - origin.y) * inverse.y;
+    t1 = (high.y - origin.y) * inverse.y;
+    t_min = fmaxf(t_min, fminf(t0, t1));
+    t_max = fminf(t_max, fmaxf(t0, t1));
+    t0 = (low.z - origin.z) * inverse.z;
+    t1 = (high.z - origin.z) * inverse.z;
+    t_min = fmaxf(t_min, fminf(t0, t1));
+    t_max = fminf(t_max, fmaxf(t0, t1));
+    return t_min <= t_max;
+}
+
+float ray_triangle(point3d origin, point3d direction, point3d a, point3d b, point3d c)
+{
+    //moller trumbore from both sides, returns the ray parameter of the hit or nan when there is none
+    point3d e1 = {b.x - a.x, b.y - a.y, b.z - a.z};
+    point3d e2 = {c.x - a.x, c.y - a.y, c.z - a.z};
+    point3d p = {direction.y * e2.z - direction.z * e2.y, direction.z * e2.x - direction.x * e2.z, direction.x * e2.y - direction.y * e2.x};
+    float determinant = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+    if (determinant == 0) {return NAN;}
+    float inverse = 1 / determinant;
+    point3d s = {origin.x - a.x, origin.y - a.y, origin.z - a.z};
+    float u = (s.x * p.x + s.y * p.y + s.z * p.z) * inverse;
+    if (u < 0 || u > 1) {return NAN;}
+    point3d q = {s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x};
+    float v = (direction.x * q.x + direction.y * q.y + direction.z * q.z) * inverse;
+    if (v < 0 || u + v > 1) {return NAN;}
+    return (e2.x * q.x + e2.y * q.y + e2.z * q.z) * inverse;
+}
+
+void start_lod_build(mesh_t* mesh)
+{
+    //small meshes are cheap enough to draw in full
+    SDL_SetAtomicInt(&mesh->lods_ready, 0);
+    mesh->number_of_lods = 0;
+    mesh->lod_thread = NULL;
+    if (mesh->number_of_polygons < 16384) {return;}
+    mesh->lods = calloc(MAX_LODS, sizeof(mesh_t));
+    if (mesh->lods == NULL) {return;}
+    mesh->lod_thread = SDL_CreateThread(lod_build_thread, "lod", mesh);
+}
+
+void wait_lod_build(mesh_t* mesh)
+{
+    if (mesh->lod_thread == NULL) {return;}
+    SDL_WaitThread(mesh->lod_thread, NULL);
+    mesh->lod_thread = NULL;
+}
+
+int lod_build_thread(void* data)
+{
+    //each level simplifies the one before it and is published as soon as it is done
+    mesh_t* mesh = data;
+    double area = 0;
+    for (long long i = 0; i < mesh->number_of_polygons; i++)
+    {
+        uint32_t index[3];
+        mesh_indices(mesh, i, index);
+        point3d a = mesh_vertex(mesh, index[0]);
+        point3d b = mesh_vertex(mesh, index[1]);
+        point3d c = mesh_vertex(mesh, index[2]);
+        double u[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+        double v[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+        double n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+        area += sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) / 2;
+    }
+    mesh->surface_area = area;
+
+    const mesh_t* source = mesh;
+    for (int k = 0; k < MAX_LODS; k++)
+    {
+        long long target = source->number_of_polygons / 4;
+        if (target < 1024) {break;}
+        if (simplify_mesh(source, target, &mesh->lods[k]) != 0) {break;}
+        //a level that barely shrank is not worth drawing, the mesh is as simple as it gets
+        if (mesh->lods[k].number_of_polygons > source->number_of_polygons * 3 / 4)
+        {
+            free_mesh(&mesh->lods[k]);
+            break;
+        }
+        //levels of a compact mesh are stored the same way
+        if (mesh->qx) {compact_mesh(&mesh->lods[k]);}
+        mesh->number_of_lods = k + 1;
+        SDL_SetAtomicInt(&mesh->lods_ready, k + 1);
+        if (redraw_event)
+        {
+            SDL_Event event = {.type = redraw_event};
+            SDL_PushEvent(&event);
+        }
+        source = &mesh->lods[k];
+    }
+    return 0;
+}
+
+int simplify_mesh(const mesh_t* source, long long target, mesh_t* level)
+{
+    //quadric error edge collapses toward target polygons; each pass sorts every edge by cost and collapses
+    //the cheapest ones that do not share a neighbourhood, vertices stay where they were so nothing is solved
+    long long vertices = source->number_of_vertices;
+    long long polygons = source->number_of_polygons;
+    memset(level, 0, sizeof(mesh_t));
+    double* quadrics = calloc(vertices * 10, sizeof(double));
+    uint32_t* indices = malloc(sizeof(uint32_t) * polygons * 3);
+    color_t* colors = malloc(sizeof(color_t) * polygons);
+    uint32_t* remap = malloc(sizeof(uint32_t) * vertices);
+    uint8_t* flags = calloc(vertices, 1);
+    uint32_t* offsets = malloc(sizeof(uint32_t) * (vertices + 1));
+    uint32_t* around = malloc(sizeof(uint32_t) * polygons * 3);
+    uint32_t* keys = malloc(sizeof(uint32_t) * polygons * 3);
+    uint32_t* edges = malloc(sizeof(uint32_t) * polygons * 3);
+    uint32_t* keys_temp = malloc(sizeof(uint32_t) * polygons * 3);
+    uint32_t* edges_temp = malloc(sizeof(uint32_t) * polygons * 3);
+    //a compact source is expanded to floats for the duration
+    float* decoded = source->qx ? malloc(sizeof(float) * vertices * 3) : NULL;
+    int result = 1;
+    if (!quadrics || !indices || !colors || !remap || !flags || !offsets || !around || !keys || !edges || !keys_temp || !edges_temp || (source->qx && !decoded)) {goto done;}
+    for (long long i = 0; i < polygons; i++) {mesh_indices(source, i, &indices[i * 3]);}
+    for (long long i = 0; i < polygons; i++) {colors[i] = mesh_color(source, i);}
+    float* x = source->x;
+    float* y = source->y;
+    float* z = source->z;
+    if (decoded)
+    {
+        x = decoded;
+        y = decoded + vertices;
+        z = decoded + vertices * 2;
+        for (long long v = 0; v < vertices; v++)
+        {
+            point3d p = mesh_vertex(source, (uint32_t) v);
+            x[v] = p.x;
+            y[v] = p.y;
+            z[v] = p.z;
+        }
+    }
+
+    //area weighted plane quadric of every polygon, added to its three corners
+    for (long long i = 0; i < polygons; i++)
+    {
+        uint32_t* index = &indices[i * 3];
+        double u[3] = {x[index[1]] - x[index[0]], y[index[1]] - y[index[0]], z[index[1]] - z[index[0]]};
+        double v[3] = {x[index[2]] - x[index[0]], y[index[2]] - y[index[0]], z[index[2]] - z[index[0]]};
+        double n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (!(length > 0)) {continue;}
+        double weight = length / 2;
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * x[index[0]] + n[1] * y[index[0]] + n[2] * z[index[0]]);
+        double q[10] = {n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * d, n[1] * n[1], n[1] * n[2], n[1] * d, n[2] * n[2], n[2] * d, d * d};
+        for (int k = 0; k < 3; k++)
+        {
+            for (int j = 0; j < 10; j++) {quadrics[(long long) index[k] * 10 + j] += q[j] * weight;}
+        }
+    }
+
+    //flag 1 marks vertices on an open edge, they stay put so holes and sheet borders do not erode
+    //flag 2 marks vertices whose neighbourhood already changed in the current pass
+    for (int pass = 0; polygons > target; pass++)
+    {
+        memset(offsets, 0, sizeof(uint32_t) * (vertices + 1));
+        for (long long k = 0; k < polygons * 3; k++) {offsets[indices[k] + 1]++;}
+        for (long long v = 0; v < vertices; v++) {offsets[v + 1] += offsets[v];}
+        for (long long k = 0; k < polygons * 3; k++) {around[offsets[indices[k]]++] = (uint32_t) (k / 3);}
+        for (long long v = vertices; v > 0; v--) {offsets[v] = offsets[v - 1];}
+        offsets[0] = 0;
+
+        if (pass == 0)
+        {
+            //an edge used by only one polygon around its vertex is open
+            for (long long v = 0; v < vertices; v++)
+            {
+                for (uint32_t a = offsets[v]; a < offsets[v + 1] && !(flags[v] & 1); a++)
+                {
+                    uint32_t* index = &indices[around[a] * 3];
+                    for (int k = 0; k < 3; k++)
                     {
+                        uint32_t w = index[k];
+                        if (w == v) {continue;}
+                        int uses = 0;
+                        for (uint32_t b = offsets[v]; b < offsets[v + 1]; b++)
+                        {
+                            uint32_t* other = &indices[around[b] * 3];
+                            uses += other[0] == w || other[1] == w || other[2] == w;
+                        }
+                        if (uses == 1) {flags[v] |= 1;}
                     }
-                    break;
-                case SDL_EVENT_KEY_DOWN:
-                    SDL_Keycode key = event.key.key;
-                    if (event.key.repeat == 0) //one time event
+                }
+            }
+        }
+
+        //edge k of a polygon moves its first corner onto its second, the cost is the error at the second
+        long long count = 0;
+        for (long long k = 0; k < polygons * 3; k++)
+        {
+            uint32_t from = indices[k];
+            uint32_t to = indices[k % 3 == 2 ? k - 2 : k + 1];
+            if (flags[from] & 1) {continue;}
+            double* a = &quadrics[(long long) from * 10];
+            double* b = &quadrics[(long long) to * 10];
+            double q[10];
+            for (int j = 0; j < 10; j++) {q[j] = a[j] + b[j];}
+            double px = x[to];
+            double py = y[to];
+            double pz = z[to];
+            double error = q[0] * px * px + 2 * q[1] * px * py + 2 * q[2] * px * pz + 2 * q[3] * px
+                + q[4] * py * py + 2 * q[5] * py * pz + 2 * q[6] * py + q[7] * pz * pz + 2 * q[8] * pz + q[9];
+            //positive floats sort like their bits
+            float cost = error > 0 ? (float) error : 0;
+            memcpy(&keys[count], &cost, sizeof(float));
+            edges[count++] = (uint32_t) k;
+        }
+        radix_sort(keys, edges, keys_temp, edges_temp, count);
+
+        //each collapse removes about two polygons
+        long long budget = (polygons - target) / 2 + 1;
+        long long collapsed = 0;
+        for (long long v = 0; v < vertices; v++) {remap[v] = (uint32_t) v;}
+        for (long long e = 0; e < count && collapsed < budget; e++)
+        {
+            long long k = edges[e];
+            uint32_t from = indices[k];
+            uint32_t to = indices[k % 3 == 2 ? k - 2 : k + 1];
+            if ((flags[from] & 2) || (flags[to] & 2) || from == to) {continue;}
+
+            //refuse collapses that would turn a remaining polygon around
+            int flips = 0;
+            for (uint32_t a = offsets[from]; a < offsets[from + 1] && !flips; a++)
+            {
+                uint32_t* index = &indices[around[a] * 3];
+                if (index[0] == to || index[1] == to || index[2] == to) {continue;}
+                point3d before[3];
+                point3d after[3];
+                for (int j = 0; j < 3; j++)
+                {
+                    uint32_t w = index[j];
+                    before[j] = (point3d) {x[w], y[w], z[w]};
+                    if (w == from) {w = to;}
+                    after[j] = (point3d) {x[w], y[w], z[w]};
+                }
+                point3d u = {before[1].x - before[0].x, before[1].y - before[0].y, before[1].z - before[0].z};
+                point3d v = {before[2].x - before[0].x, before[2].y - before[0].y, before[2].z - before[0].z};
+                point3d n0 = {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+                u = (point3d) {after[1].x - after[0].x, after[1].y - after[0].y, after[1].z - after[0].z};
+                v = (point3d) {after[2].x - after[0].x, after[2].y - after[0].y, after[2].z - after[0].z};
+                point3d n1 = {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+                if (n0.x * n1.x + n0.y * n1.y + n0.z * n1.z <= 0) {flips = 1;}
+            }
+            if (flips) {continue;}
+
+            remap[from] = to;
+            for (int j = 0; j < 10; j++) {quadrics[(long long) to * 10 + j] += quadrics[(long long) from * 10 + j];}
+            for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++)
+            {
+                uint32_t* index = &indices[around[a] * 3];
+                for (int j = 0; j < 3; j++) {flags[index[j]] |= 2;}
+            }
+            flags[to] |= 2;
+            collapsed++;
+        }
+        if (collapsed == 0) {break;}
+
+        //apply the pass and drop the polygons that folded to a line
+        long long kept = 0;
+        for (long long i = 0; i < polygons; i++)
+        {
+            uint32_t a = remap[indices[i * 3]];
+            uint32_t b = remap[indices[i * 3 + 1]];
+            uint32_t c = remap[indices[i * 3 + 2]];
+            if (a == b || b == c || c == a) {continue;}
+            indices[kept * 3] = a;
+            indices[kept * 3 + 1] = b;
+            indices[kept * 3 + 2] = c;
+            colors[kept++] = colors[i];
+        }
+        polygons = kept;
+        for (long long v = 0; v < vertices; v++) {flags[v] &= 1;}
+    }
+
+    //keep only the vertices still in use
+    for (long long v = 0; v < vertices; v++) {remap[v] = UINT32_MAX;}
+    uint32_t used = 0;
+    for (long long k = 0; k < polygons * 3; k++)
+    {
+        if (remap[indices[k]] == UINT32_MAX) {remap[indices[k]] = used++;}
+    }
+    level->x = malloc(sizeof(float) * (used ? used : 1));
+    level->y = malloc(sizeof(float) * (used ? used : 1));
+    level->z = malloc(sizeof(float) * (used ? used : 1));
+    level->indices = malloc(sizeof(uint32_t) * (polygons ? polygons * 3 : 1));
+    level->normals = malloc(sizeof(point3d) * (polygons ? polygons : 1));
+    level->colors = malloc(sizeof(color_t) * (polygons ? polygons : 1));
+    if (!level->x || !level->y || !level->z || !level->indices || !level->normals || !level->colors)
+    {
+        free_mesh(level);
+        goto done;
+    }
+    for (long long v = 0; v < vertices; v++)
+    {
+        if (remap[v] == UINT32_MAX) {continue;}
+        level->x[remap[v]] = x[v];
+        level->y[remap[v]] = y[v];
+        level->z[remap[v]] = z[v];
+    }
+    for (long long i = 0; i < polygons; i++)
+    {
+        for (int k = 0; k < 3; k++) {level->indices[i * 3 + k] = remap[indices[i * 3 + k]];}
+        level->normals[i] = (point3d) {0, 0, 0};
+        level->colors[i] = colors[i];
+    }
+    level->number_of_vertices = used;
+    level->number_of_polygons = polygons;
+    level->low = source->low;
+    level->high = source->high;
+    //zero normals are filled in from the winding
+    repair_normals(level, 0, polygons);
+    build_bvh(level);
+    build_edges(level);
+    build_meshlets(level);
+    touch_mesh(level);
+    result = 0;
+
+done:
+    free(decoded);
+    free(quadrics);
+    free(indices);
+    free(colors);
+    free(remap);
+    free(flags);
+    free(offsets);
+    free(around);
+    free(keys);
+    free(edges);
+    free(keys_temp);
+    free(edges_temp);
+    return result;
+}
+
+void radix_sort(uint32_t* keys, uint32_t* values, uint32_t* keys_temp, uint32_t* values_temp, long long count)
+{
+    //least significant byte first, four passes leave the result back in keys and values
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        long long histogram[257] = {0};
+        for (long long i = 0; i < count; i++) {histogram[((keys[i] >> shift) & 0xff) + 1]++;}
+        for (int b = 0; b < 256; b++) {histogram[b + 1] += histogram[b];}
+        for (long long i = 0; i < count; i++)
+        {
+            long long slot = histogram[(keys[i] >> shift) & 0xff]++;
+            keys_temp[slot] = keys[i];
+            values_temp[slot] = values[i];
+        }
+        uint32_t* swap = keys;
+        keys = keys_temp;
+        keys_temp = swap;
+        swap = values;
+        values = values_temp;
+        values_temp = swap;
+    }
+}
+
+mesh_t* select_lod(mesh_t* mesh, int moving)
+{
+    //the coarsest level whose polygons still cover at most lod_pixel_area on screen, or the motion budget allows
+    int ready = SDL_GetAtomicInt(&mesh->lods_ready);
+    mesh_t* chosen = mesh;
+    int level = 0;
+    if (settings.lod >= 0)
+    {
+        level = settings.lod < ready ? settings.lod : ready;
+        chosen = level ? &mesh->lods[level - 1] : mesh;
+    }
+    else
+    {
+        //about half the surface faces the viewer, perspective divides by w, which is 2 at the centre
+        double w = settings.perspective ? 2 : 1;
+        double pixels = mesh->surface_area / 2 * settings.scale * settings.scale / (w * w);
+        for (int k = 0; k < ready; k++)
+        {
+            mesh_t* next = &mesh->lods[k];
+            int small = pixels / next->number_of_polygons <= settings.lod_pixel_area;
+            if (!small && !(moving && chosen->number_of_polygons > settings.lod_motion_polygons)) {break;}
+            chosen = next;
+            level = k + 1;
+        }
+    }
+    raster_stats.lod_level = level;
+    raster_stats.lod_levels = ready;
+    return chosen;
+}
+
+void switch_mesh_axes(mesh_t* mesh)
+{
+    //x <- z, y <- x, z <- y is just a rotation of the stream pointers; waits for the level builder, which reads them
+    wait_lod_build(mesh);
+    float* old_x = mesh->x;
+    mesh->x = mesh->z;
+    mesh->z = mesh->y;
+    mesh->y = old_x;
+    point3d temp;
+    if (mesh->qx)
+    {
+        uint16_t* old_qx = mesh->qx;
+        mesh->qx = mesh->qz;
+        mesh->qz = mesh->qy;
+        mesh->qy = old_qx;
+        temp = mesh->quant_low;
+        mesh->quant_low = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+        temp = mesh->quant_step;
+        mesh->quant_step = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+    }
+    for (long long i = 0; i < mesh->number_of_polygons; i++)
+    {
+        temp = mesh_normal(mesh, i);
+        temp = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+        if (mesh->packed_normals) {mesh->packed_normals[i] = encode_normal(temp);}
+        else {mesh->normals[i] = temp;}
+    }
+    for (long long i = 0; i < mesh->number_of_bvh_nodes && mesh->bvh; i++)
+    {
+        temp = mesh->bvh[i].low;
+        mesh->bvh[i].low = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+        temp = mesh->bvh[i].high;
+        mesh->bvh[i].high = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+    }
+    for (long long i = 0; i < mesh->number_of_bvh_nodes && mesh->quantized_bvh; i++)
+    {
+        quantized_bvh_node_t* node = &mesh->quantized_bvh[i];
+        uint16_t low[3] = {node->low[2], node->low[0], node->low[1]};
+        uint16_t high[3] = {node->high[2], node->high[0], node->high[1]};
+        memcpy(node->low, low, sizeof(low));
+        memcpy(node->high, high, sizeof(high));
+    }
+    temp = mesh->low;
+    mesh->low = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+    temp = mesh->high;
+    mesh->high = (point3d) {.x = temp.z, .y = temp.x, .z = temp.y};
+    parallel_for(mesh->number_of_meshlets, 4096, meshlet_bounds, mesh);
+    for (int k = 0; k < mesh->number_of_lods; k++) {switch_mesh_axes(&mesh->lods[k]);}
+    touch_mesh(mesh);
+}
+
+void center_mesh(mesh_t* mesh)
+{
+    //moves the middle of the bounding box to the origin the view turns around
+    wait_lod_build(mesh);
+    point3d centre = {(mesh->low.x + mesh->high.x) / 2, (mesh->low.y + mesh->high.y) / 2, (mesh->low.z + mesh->high.z) / 2};
+    if (mesh->qx)
+    {
+        mesh->quant_low = (point3d) {mesh->quant_low.x - centre.x, mesh->quant_low.y - centre.y, mesh->quant_low.z - centre.z};
+    }
+    else
+    {
+        for (long long v = 0; v < mesh->number_of_vertices; v++)
+        {
+            mesh->x[v] -= centre.x;
+            mesh->y[v] -= centre.y;
+            mesh->z[v] -= centre.z;
+        }
+    }
+    //quantized boxes are relative to quant_low and move with it
+    for (long long i = 0; i < mesh->number_of_bvh_nodes && mesh->bvh; i++)
+    {
+        bvh_node_t* node = &mesh->bvh[i];
+        node->low = (point3d) {node->low.x - centre.x, node->low.y - centre.y, node->low.z - centre.z};
+        node->high = (point3d) {node->high.x - centre.x, node->high.y - centre.y, node->high.z - centre.z};
+    }
+    mesh->low = (point3d) {mesh->low.x - centre.x, mesh->low.y - centre.y, mesh->low.z - centre.z};
+    mesh->high = (point3d) {mesh->high.x - centre.x, mesh->high.y - centre.y, mesh->high.z - centre.z};
+    parallel_for(mesh->number_of_meshlets, 4096, meshlet_bounds, mesh);
+    for (int k = 0; k < mesh->number_of_lods; k++) {center_mesh(&mesh->lods[k]);}
+    touch_mesh(mesh);
+}
+
+void touch_mesh(mesh_t* mesh)
+{
+    mesh->revision = (uint32_t) SDL_AddAtomicInt(&mesh_revisions, 1) + 1;
+}
+
+int map_file(const char* path, mapped_file_t* file, int copy_on_write)
+{
+    //copy on write mappings can be changed in memory, the file itself is never written
+    file->data = NULL;
+    file->size = 0;
+#ifdef _WIN32
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) {return 1;}
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size)) {CloseHandle(file->file); return 1;}
+    file->size = (size_t) size.QuadPart;
+    file->mapping = NULL;
+    if (file->size == 0) {return 0;}
+    file->mapping = CreateFileMappingA(file->file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping == NULL) {CloseHandle(file->file); return 1;}
+    file->data = MapViewOfFile(file->mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL) {CloseHandle(file->mapping); CloseHandle(file->file); return 1;}
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {return 1;}
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {close(fd); return 1;}
+    file->size = (size_t) info.st_size;
+    if (file->size == 0) {close(fd); return 0;}
+    void* data = mmap(NULL, file->size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {return 1;}
+    madvise(data, file->size, MADV_WILLNEED);
+    file->data = data;
+#endif
+    return 0;
+}
+
+void unmap_file(mapped_file_t* file)
+{
+#ifdef _WIN32
+    if (file->data) {UnmapViewOfFile(file->data);}
+    if (file->mapping) {CloseHandle(file->mapping);}
+    CloseHandle(file->file);
+#else
+    if (file->data) {munmap((void*) file->data, file->size);}
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+int file_stamp(const char* path, uint64_t* size, int64_t* mtime)
+{
+    //size and last write time, a cache is stale once either differs; the time is in whatever units the system keeps
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {return 1;}
+    *size = ((uint64_t) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *mtime = (int64_t) (((uint64_t) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {return 1;}
+    *size = (uint64_t) info.st_size;
+    //in nanoseconds, a model saved twice within a second still has a new stamp
+#ifdef __APPLE__
+    *mtime = (int64_t) info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    *mtime = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    return 0;
+}
+
+int load_mesh_cache(const char* path, mesh_t* mesh)
+{
+    //maps <path>.cache and points the mesh into it, returns 1 when there is no cache or it does not match the model
+    char cache_path[1024];
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (snprintf(cache_path, sizeof(cache_path), "%s.cache", path) >= (int) sizeof(cache_path)) {return 1;}
+    if (file_stamp(path, &source_size, &source_mtime) != 0) {return 1;}
+    mapped_file_t file;
+    if (map_file(cache_path, &file, 1) != 0) {return 1;}
+    if (file.size < sizeof(mesh_cache_header_t))
+    {
+        unmap_file(&file);
+        return 1;
+    }
+
+    const mesh_cache_header_t* header = (const mesh_cache_header_t*) file.data;
+    int valid = memcmp(header->magic, "P3DMESH", 8) == 0 && header->version == CACHE_VERSION
+        && header->byte_order == 0x01020304 && header->source_size == source_size && header->source_mtime == source_mtime
+        && header->weld_tolerance == settings.weld_tolerance && header->file_size == file.size
+        && header->number_of_polygons > 0 && header->number_of_polygons < 1 << 30 && header->number_of_vertices > 0 && header->number_of_vertices <= header->number_of_polygons * 3
+        && header->number_of_bvh_nodes >= 0 && header->number_of_bvh_nodes < header->number_of_polygons * 2
+        && header->number_of_meshlets >= 0 && header->number_of_meshlets <= header->number_of_polygons
+        && header->number_of_shared_vertices >= 0 && header->number_of_shared_vertices <= header->number_of_polygons * 3;
+    //every section has to lie inside the file, the counts were checked above so none of this overflows
+    uint64_t lengths[11] = {sizeof(float) * header->number_of_vertices, sizeof(float) * header->number_of_vertices, sizeof(float) * header->number_of_vertices,
+        sizeof(uint32_t) * 3 * header->number_of_polygons, sizeof(point3d) * header->number_of_polygons, sizeof(color_t) * header->number_of_polygons,
+        sizeof(bvh_node_t) * header->number_of_bvh_nodes, sizeof(uint32_t) * 3 * header->number_of_polygons, 3 * header->number_of_polygons,
+        sizeof(meshlet_t) * header->number_of_meshlets, sizeof(uint32_t) * 2 * header->number_of_shared_vertices};
+    for (int k = 0; k < 11 && valid; k++)
+    {
+        if (header->offsets[k] % 64 != 0 || header->offsets[k] < sizeof(mesh_cache_header_t) || header->offsets[k] > file.size || lengths[k] > file.size - header->offsets[k]) {valid = 0;}
+    }
+    if (!valid)
+    {
+        unmap_file(&file);
+        return 1;
+    }
+
+    //the mapping is copy on write, so switching axes or highlighting changes memory and never the file
+    uint8_t* base = (uint8_t*) file.data;
+    memset(mesh, 0, sizeof(mesh_t));
+    mesh->x = (float*) (base + header->offsets[0]);
+    mesh->y = (float*) (base + header->offsets[1]);
+    mesh->z = (float*) (base + header->offsets[2]);
+    mesh->indices = (uint32_t*) (base + header->offsets[3]);
+    mesh->normals = (point3d*) (base + header->offsets[4]);
+    mesh->colors = (color_t*) (base + header->offsets[5]);
+    mesh->bvh = header->number_of_bvh_nodes ? (bvh_node_t*) (base + header->offsets[6]) : NULL;
+    mesh->neighbors = (uint32_t*) (base + header->offsets[7]);
+    mesh->edge_angles = base + header->offsets[8];
+    mesh->meshlets = header->number_of_meshlets ? (meshlet_t*) (base + header->offsets[9]) : NULL;
+    mesh->shared_vertices = (uint32_t*) (base + header->offsets[10]);
+    mesh->number_of_meshlets = header->number_of_meshlets;
+    mesh->number_of_shared_vertices = header->number_of_shared_vertices;
+    mesh->number_of_vertices = header->number_of_vertices;
+    mesh->number_of_polygons = header->number_of_polygons;
+    mesh->number_of_bvh_nodes = header->number_of_bvh_nodes;
+    mesh->low = header->low;
+    mesh->high = header->high;
+    mesh->cache = file;
+    if (check_mesh_cache(mesh) != 0)
+    {
+        SDL_Log("Error 33: Mesh Cache Is Damaged, Rebuilding It");
+        unmap_file(&mesh->cache);
+        memset(mesh, 0, sizeof(mesh_t));
+        return 1;
+    }
+    touch_mesh(mesh);
+    return 0;
+}
+
+int check_mesh_cache(const mesh_t* mesh)
+{
+    //the header only says the sections fit in the file; every index in them is checked against what it indexes, so a cache
+    //that was cut short or written over fails here and not in the renderer. Returns 1 at the first index out of range
+    long long vertices = mesh->number_of_vertices;
+    long long polygons = mesh->number_of_polygons;
+    for (long long i = 0; i < polygons * 3; i++)
+    {
+        if (mesh->indices[i] >= vertices) {return 1;}
+        if (mesh->neighbors[i] != NO_NEIGHBOR && mesh->neighbors[i] >= polygons) {return 1;}
+    }
+    //children are always stored after their parent, which also keeps the walks from going round in a loop
+    for (long long n = 0; n < mesh->number_of_bvh_nodes; n++)
+    {
+        const bvh_node_t* node = &mesh->bvh[n];
+        if (node->count == 0 ? node->first <= n || node->first + 1LL >= mesh->number_of_bvh_nodes : node->first + (long long) node->count > polygons) {return 1;}
+    }
+    for (long long m = 0; m < mesh->number_of_meshlets; m++)
+    {
+        const meshlet_t* meshlet = &mesh->meshlets[m];
+        if (meshlet->first_polygon > meshlet->last_polygon || meshlet->last_polygon > polygons) {return 1;}
+        if (meshlet->first_vertex > meshlet->last_vertex || meshlet->last_vertex > vertices) {return 1;}
+        if ((long long) meshlet->first_shared + meshlet->number_of_shared > mesh->number_of_shared_vertices) {return 1;}
+    }
+    for (long long s = 0; s < mesh->number_of_shared_vertices; s++)
+    {
+        if (mesh->shared_vertices[s * 2] >= vertices || mesh->shared_vertices[s * 2 + 1] >= mesh->number_of_meshlets) {return 1;}
+    }
+    return 0;
+}
+
+int write_mesh_cache(const char* path, const mesh_t* mesh)
+{
+    //written to a temporary name and renamed, so a reader never maps half a cache
+    char cache_path[1024];
+    char temp_path[1040];
+    mesh_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    if (snprintf(cache_path, sizeof(cache_path), "%s.cache", path) >= (int) sizeof(cache_path)) {return 1;}
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", cache_path);
+    //a cache always has the edges, a mesh that ran out of memory building them is not worth keeping
+    if (mesh->number_of_polygons == 0 || mesh->neighbors == NULL || file_stamp(path, &header.source_size, &header.source_mtime) != 0) {return 1;}
+
+    memcpy(header.magic, "P3DMESH", 8);
+    header.version = CACHE_VERSION;
+    header.byte_order = 0x01020304;
+    header.number_of_vertices = mesh->number_of_vertices;
+    header.number_of_polygons = mesh->number_of_polygons;
+    header.number_of_bvh_nodes = mesh->bvh ? mesh->number_of_bvh_nodes : 0;
+    header.number_of_meshlets = mesh->number_of_meshlets;
+    header.number_of_shared_vertices = mesh->number_of_shared_vertices;
+    header.low = mesh->low;
+    header.high = mesh->high;
+    header.weld_tolerance = settings.weld_tolerance;
+    const void* sections[11] = {mesh->x, mesh->y, mesh->z, mesh->indices, mesh->normals, mesh->colors, mesh->bvh, mesh->neighbors, mesh->edge_angles,
+        mesh->meshlets, mesh->shared_vertices};
+    uint64_t lengths[11] = {sizeof(float) * mesh->number_of_vertices, sizeof(float) * mesh->number_of_vertices, sizeof(float) * mesh->number_of_vertices,
+        sizeof(uint32_t) * 3 * mesh->number_of_polygons, sizeof(point3d) * mesh->number_of_polygons, sizeof(color_t) * mesh->number_of_polygons,
+        sizeof(bvh_node_t) * header.number_of_bvh_nodes, sizeof(uint32_t) * 3 * mesh->number_of_polygons, 3 * mesh->number_of_polygons,
+        sizeof(meshlet_t) * mesh->number_of_meshlets, sizeof(uint32_t) * 2 * mesh->number_of_shared_vertices};
+    uint64_t offset = sizeof(header);
+    for (int k = 0; k < 11; k++)
+    {
+        offset = (offset + 63) & ~(uint64_t) 63;
+        header.offsets[k] = offset;
+        offset += lengths[k];
+    }
+    header.file_size = offset;
+
+    FILE* file = fopen(temp_path, "wb");
+    if (file == NULL)
+    {
+        SDL_Log("Error 14: Mesh Cache Not Written");
+        return 1;
+    }
+    static const uint8_t padding[64] = {0};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    for (int k = 0; k < 11 && ok; k++)
+    {
+        ok = fwrite(padding, 1, header.offsets[k] - written, file) == header.offsets[k] - written;
+        if (ok && lengths[k]) {ok = fwrite(sections[k], 1, lengths[k], file) == lengths[k];}
+        written = header.offsets[k] + lengths[k];
+    }
+    if (fclose(file) != 0) {ok = 0;}
+    //rename does not replace an existing file everywhere
+    remove(cache_path);
+    if (!ok || rename(temp_path, cache_path) != 0)
+    {
+        remove(temp_path);
+        SDL_Log("Error 14: Mesh Cache Not Written");
+        return 1;
+    }
+    return 0;
+}
+
+polygon_t* load_stl_binary(const uint8_t* data, size_t size, int* number_of_polygons, mesh_stream_t* stream)
+{
+    //80 byte header, uint32 count, then 50 byte records: normal, 3 vertices, uint16 attribute
+    *number_of_polygons = 0;
+    if (size < 84)
+    {
+        SDL_Log("Error 02: File Too Short");
+        return NULL;
+    }
+
+    uint32_t count;
+    memcpy(&count, data + 80, sizeof(uint32_t));
+    if ((uint64_t) 84 + (uint64_t) 50 * count != size || count > INT32_MAX)
+    {
+        SDL_Log("Error 08: Corrupt STL (header says %u triangles, file has %llu bytes)", count, (unsigned long long) size);
+        return NULL;
+    }
+
+    polygon_t* polygonlist = malloc(sizeof(polygon_t) * (count ? count : 1));
+    if (polygonlist == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return NULL;
+    }
+
+    stl_decode_t decode;
+    SDL_SetAtomicInt(&decode.corrupt, 0);
+    stream_begin(stream, count);
+    //in one go, or in batches when something is drawing the polygons as they arrive
+    long long batch = stream ? LOAD_BATCH : (long long) count;
+    for (long long first = 0; first < count; first += batch)
+    {
+        if (stream && SDL_GetAtomicInt(&stream->cancel)) {free(polygonlist); return NULL;}
+        long long last = first + batch < count ? first + batch : count;
+        decode.records = data + 84 + 50 * first;
+        decode.polygonlist = polygonlist + first;
+        parallel_for(last - first, 65536, decode_stl_records, &decode);
+        stream_publish(stream, polygonlist, first, last);
+    }
+
+    if (SDL_GetAtomicInt(&decode.corrupt))
+    {
+        SDL_Log("Error 09: Corrupt STL (%d triangles with non-finite vertices)", SDL_GetAtomicInt(&decode.corrupt));
+        free(polygonlist);
+        return NULL;
+    }
+
+    *number_of_polygons = count;
+    return polygonlist;
+}
+
+void decode_stl_records(void* data, long long first, long long last)
+{
+    stl_decode_t* decode = data;
+    int corrupt = 0;
+    for (long long i = first; i < last; i++)
+    {
+        //the first 48 bytes of a record match the first four point3d of polygon_t
+        polygon_t* polygon = &decode->polygonlist[i];
+        memcpy(polygon, decode->records + 50 * i, sizeof(float) * 12);
+        polygon->color = WHITE;
+
+        if (!isfinite(polygon->a.x) || !isfinite(polygon->a.y) || !isfinite(polygon->a.z) ||
+            !isfinite(polygon->b.x) || !isfinite(polygon->b.y) || !isfinite(polygon->b.z) ||
+            !isfinite(polygon->c.x) || !isfinite(polygon->c.y) || !isfinite(polygon->c.z))
+        {
+            corrupt++;
+        }
+        //a broken normal is harmless, just drop it
+        if (!isfinite(polygon->normal_vector.x) || !isfinite(polygon->normal_vector.y) || !isfinite(polygon->normal_vector.z))
+        {
+            polygon->normal_vector = (point3d) {0.0f, 0.0f, 0.0f};
+        }
+    }
+    if (corrupt) {SDL_AddAtomicInt(&decode->corrupt, corrupt);}
+}
+
+int looks_like_ascii_stl(const uint8_t* data, size_t size)
+{
+    //binary headers often start with "solid" too, so also require the first kilobyte to be plain text
+    size_t i = 0;
+    while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n')) {i++;}
+    if (size - i < 5 || memcmp(data + i, "solid", 5) != 0) {return 0;}
+
+    size_t probe = size < 1024 ? size : 1024;
+    for (i = 0; i < probe; i++)
+    {
+        if ((data[i] < ' ' && data[i] != '\t' && data[i] != '\r' && data[i] != '\n') || data[i] > 126) {return 0;}
+    }
+    return 1;
+}
+
+polygon_t* load_stl_ascii(const uint8_t* data, size_t size, int* number_of_polygons, mesh_stream_t* stream)
+{
+    //solid name / facet normal n n n / outer loop / vertex x y z (x3) / endloop / endfacet / endsolid name
+    *number_of_polygons = 0;
+    int chunks = SDL_GetNumLogicalCPUCores() * 4;
+    if (chunks > 256) {chunks = 256;}
+    if (size < ((size_t) 1 << 20)) {chunks = 1;}
+
+    stl_ascii_t ascii;
+    ascii.boundaries = malloc(sizeof(size_t) * (chunks + 1));
+    ascii.first_chunk = 0;
+    ascii.first_polygon = malloc(sizeof(long long) * chunks);
+    ascii.chunk_polygons = malloc(sizeof(long long) * chunks);
+    ascii.polygonlist = NULL;
+    SDL_SetAtomicInt(&ascii.corrupt, 0);
+    if (ascii.boundaries == NULL || ascii.first_polygon == NULL || ascii.chunk_polygons == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(ascii.boundaries);
+        free(ascii.first_polygon);
+        free(ascii.chunk_polygons);
+        return NULL;
+    }
+
+    long long total = split_stl_ascii(&ascii, (const char*) data, size, chunks);
+    if (total > INT32_MAX)
+    {
+        SDL_Log("Error 10: Corrupt STL (too many triangles)");
+        SDL_SetAtomicInt(&ascii.corrupt, 1);
+    }
+    else
+    {
+        ascii.polygonlist = malloc(sizeof(polygon_t) * (total ? total : 1));
+        if (ascii.polygonlist == NULL)
+        {
+            SDL_Log("Error 04: Out Of Memory");
+            SDL_SetAtomicInt(&ascii.corrupt, 1);
+        }
+        else
+        {
+            //chunks end on facet boundaries, so every group of chunks completes the polygons before it
+            stream_begin(stream, total);
+            int group = stream ? SDL_GetNumLogicalCPUCores() : chunks;
+            for (int first = 0; first < chunks && !SDL_GetAtomicInt(&ascii.corrupt); first += group)
+            {
+                if (stream && SDL_GetAtomicInt(&stream->cancel)) {SDL_SetAtomicInt(&ascii.corrupt, -1); break;}
+                int last = first + group < chunks ? first + group : chunks;
+                ascii.first_chunk = first;
+                parallel_for(last - first, 1, parse_stl_ascii_chunks, &ascii);
+                stream_publish(stream, ascii.polygonlist, ascii.first_polygon[first], last < chunks ? ascii.first_polygon[last] : total);
+            }
+            if (SDL_GetAtomicInt(&ascii.corrupt) > 0)
+            {
+                SDL_Log("Error 10: Corrupt STL (malformed ascii facet)");
+            }
+        }
+    }
+
+    free(ascii.boundaries);
+    free(ascii.first_polygon);
+    free(ascii.chunk_polygons);
+    if (SDL_GetAtomicInt(&ascii.corrupt))
+    {
+        free(ascii.polygonlist);
+        return NULL;
+    }
+    *number_of_polygons = total;
+    return ascii.polygonlist;
+}
+
+long long split_stl_ascii(stl_ascii_t* ascii, const char* data, size_t size, int chunks)
+{
+    //every chunk after the first starts right after an endfacet, so no facet straddles two chunks; returns the facets counted
+    const char* end = data + size;
+    ascii->data = data;
+    ascii->size = size;
+    ascii->chunks = chunks;
+    ascii->boundaries[0] = 0;
+    for (int i = 1; i < chunks; i++)
+    {
+        size_t nominal = size / chunks * i;
+        if (nominal < ascii->boundaries[i - 1]) {nominal = ascii->boundaries[i - 1];}
+        //back up to the start of the word the split landed in
+        while (nominal > ascii->boundaries[i - 1] && (unsigned char) data[nominal - 1] > ' ') {nominal--;}
+        const char* found = find_word(data + nominal, end, "endfacet", 8);
+        ascii->boundaries[i] = found ? (size_t) (found + 8 - data) : size;
+    }
+    ascii->boundaries[chunks] = size;
+
+    parallel_for(chunks, 1, count_stl_ascii_chunks, ascii);
+
+    long long total = 0;
+    for (int i = 0; i < chunks; i++)
+    {
+        ascii->first_polygon[i] = total;
+        total += ascii->chunk_polygons[i];
+    }
+    return total;
+}
+
+void count_stl_ascii_chunks(void* data, long long first, long long last)
+{
+    stl_ascii_t* ascii = data;
+    for (long long chunk = first; chunk < last; chunk++)
+    {
+        const char* p = ascii->data + ascii->boundaries[chunk];
+        const char* end = ascii->data + ascii->boundaries[chunk + 1];
+        long long count = 0;
+        while ((p = find_word(p, end, "endfacet", 8)) != NULL)
+        {
+            count++;
+            p += 8;
+        }
+        ascii->chunk_polygons[chunk] = count;
+    }
+}
+
+void parse_stl_ascii_chunks(void* data, long long first, long long last)
+{
+    stl_ascii_t* ascii = data;
+    for (long long chunk = ascii->first_chunk + first; chunk < ascii->first_chunk + last; chunk++)
+    {
+        const char* p = ascii->data + ascii->boundaries[chunk];
+        const char* end = ascii->data + ascii->boundaries[chunk + 1];
+        polygon_t* polygon = ascii->polygonlist + ascii->first_polygon[chunk];
+        polygon_t* polygon_end = polygon + ascii->chunk_polygons[chunk];
+        const char* word;
+        size_t length;
+        int ok = 1;
+
+        while (ok && (word = next_word(p, end, &length)) != NULL)
+        {
+            p = word + length;
+            if (length == 5 && memcmp(word, "solid", 5) == 0)
+            {
+                //the name runs to the end of the line and may contain anything
+                while (p < end && *p != '\n') {p++;}
+                continue;
+            }
+            if (length == 8 && memcmp(word, "endsolid", 8) == 0)
+            {
+                while (p < end && *p != '\n') {p++;}
+                continue;
+            }
+            if (length != 5 || memcmp(word, "facet", 5) != 0 || polygon == polygon_end) {ok = 0; break;}
+
+            //normal then three vertices, the vertices sit right after the normal in polygon_t
+            float* values = &polygon->normal_vector.x;
+            const char* expected[6] = {"normal", "outer", "loop", "vertex", "vertex", "vertex"};
+            int value = 0;
+            int broken_normal = 0;
+            for (int step = 0; step < 6 && ok; step++)
+            {
+                word = next_word(p, end, &length);
+                if (word == NULL || length != strlen(expected[step]) || memcmp(word, expected[step], length) != 0) {ok = 0; break;}
+                p = word + length;
+                if (step == 1 || step == 2) {continue;}
+                for (int k = 0; k < 3; k++)
+                {
+                    word = next_word(p, end, &length);
+                    if (word == NULL) {ok = 0; break;}
+                    values[value] = 0.0f;
+                    if (!parse_float(word, length, &values[value]))
                     {
-                        if (key == settings.keybind_exit)
-                        {
-                            running = 0;
-                        }
-                        else if (key == settings.keybind_default_view)
-                        {
-                            yrotation = 0.35;
-                            xrotation = 0.35;
-                        }
-                        else if (key == settings.keybind_show_view)
-                        {
-                            char buffer[64];
-                            sprintf(buffer, "Xrot: %f\nYrot: %f\nZoom/Scale: %f\n", xrotation, yrotation, settings.scale);
-                            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Current Rotation", buffer, NULL);
-                        }
-                        else if (key == settings.keybind_switch_xyz)
-                        {
-                            polygon_t temp;
-                            for (int i = 0; i < number_of_polygons; i++)
-                            {
-                                temp = polygonlist[i];
-                                polygonlist[i].a = (point3d) {.x = temp.a.z, .y = temp.a.x, .z = temp.a.y};
-                                polygonlist[i].b = (point3d) {.x = temp.b.z, .y = temp.b.x, .z = temp.b.y};
-                                polygonlist[i].c = (point3d) {.x = temp.c.z, .y = temp.c.x, .z = temp.c.y};
-                            }
-                        }
-                        else if (key == settings.keybind_debug)
-                        {
-                            char buffer[64];
-                            sprintf(buffer, "Frames Per Second: %lld\nLatency: %lldms", fps, frame_latency_ms);
-                            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "DEBUG", buffer, NULL);
-                        }
+                        //like the binary loader only the vertices have to be finite, a nan, inf or overflowing normal is dropped
+                        if (value >= 3 || !(isinf(values[value]) || nonfinite_word(word, length))) {ok = 0; break;}
+                        broken_normal = 1;
                     }
-                    break;
+                    value++;
+                    p = word + length;
+                }
+            }
+            if (!ok) {break;}
+            if (broken_normal) {polygon->normal_vector = (point3d) {0.0f, 0.0f, 0.0f};}
+
+            word = next_word(p, end, &length);
+            if (word == NULL || length != 7 || memcmp(word, "endloop", 7) != 0) {ok = 0; break;}
+            p = word + length;
+            word = next_word(p, end, &length);
+            if (word == NULL || length != 8 || memcmp(word, "endfacet", 8) != 0) {ok = 0; break;}
+            p = word + length;
+
+            polygon->color = WHITE;
+            polygon++;
+        }
+
+        if (!ok || polygon != polygon_end) {SDL_AddAtomicInt(&ascii->corrupt, 1);}
+    }
+}
+
+int compression_format(const uint8_t* data, size_t size)
+{
+    if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {return COMPRESSION_GZIP;}
+    if (size >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd) {return COMPRESSION_ZSTD;}
+    return COMPRESSION_NONE;
+}
+
+polygon_t* load_compressed_stl(const uint8_t* data, size_t size, int format, int* number_of_polygons, mesh_stream_t* stream)
+{
+    //decompressed on its own thread a block at a time while the blocks before are parsed here, the decompressed file is never in memory whole
+    *number_of_polygons = 0;
+    decompress_t decompress;
+    memset(&decompress, 0, sizeof(decompress));
+    decompress.data = data;
+    decompress.size = size;
+    decompress.format = format;
+    decompress.mutex = SDL_CreateMutex();
+    decompress.filled = SDL_CreateCondition();
+    decompress.emptied = SDL_CreateCondition();
+    int chunks = SDL_GetNumLogicalCPUCores() * 4;
+    if (chunks > 256) {chunks = 256;}
+    compressed_stl_t load;
+    memset(&load, 0, sizeof(load));
+    load.ascii = -1;
+    load.chunks.boundaries = malloc(sizeof(size_t) * (chunks + 1));
+    load.chunks.first_polygon = malloc(sizeof(long long) * chunks);
+    load.chunks.chunk_polygons = malloc(sizeof(long long) * chunks);
+    uint8_t* carry = malloc(COMPRESSED_CARRY);
+    int ok = decompress.mutex && decompress.filled && decompress.emptied && load.chunks.boundaries && load.chunks.first_polygon && load.chunks.chunk_polygons && carry;
+    for (int k = 0; k < COMPRESSED_BLOCKS && ok; k++)
+    {
+        decompress.blocks[k] = malloc(COMPRESSED_CARRY + COMPRESSED_BLOCK);
+        ok = decompress.blocks[k] != NULL;
+    }
+    if (!ok) {SDL_Log("Error 04: Out Of Memory");}
+    if (ok)
+    {
+        decompress.thread = SDL_CreateThread(decompress_thread, "decompress", &decompress);
+        if (decompress.thread == NULL)
+        {
+            SDL_Log("Error 21: Could Not Start The Decompression Thread: %s", SDL_GetError());
+            ok = 0;
+        }
+    }
+
+    //a block is parsed up to its last whole triangle, the rest is put in front of the next block
+    size_t carried = 0;
+    long long decompressed = 0;
+    size_t length;
+    uint8_t* block;
+    while (ok && (block = take_block(&decompress, &length)) != NULL)
+    {
+        uint8_t* region = block - carried;
+        memcpy(region, carry, carried);
+        size_t region_size = carried + length;
+        decompressed += length;
+        if (load.ascii < 0) {load.ascii = looks_like_ascii_stl(region, region_size);}
+        long long used = load.ascii ? parse_stl_ascii_block(&load, (const char*) region, region_size, 0) : decode_stl_binary_block(&load, region, region_size, stream);
+        if (used >= 0 && region_size - used > COMPRESSED_CARRY)
+        {
+            SDL_Log("Error 10: Corrupt STL (malformed ascii facet)");
+            used = -1;
+        }
+        if (used >= 0)
+        {
+            carried = region_size - used;
+            memcpy(carry, region + used, carried);
+        }
+        return_block(&decompress);
+        if (used < 0 || (stream && SDL_GetAtomicInt(&stream->cancel))) {ok = 0;}
+    }
+    if (decompress.thread)
+    {
+        SDL_LockMutex(decompress.mutex);
+        decompress.cancel = 1;
+        SDL_BroadcastCondition(decompress.emptied);
+        SDL_UnlockMutex(decompress.mutex);
+        SDL_WaitThread(decompress.thread, NULL);
+    }
+
+    if (ok && decompress.finished < 0)
+    {
+        SDL_Log("Error 19: Corrupt Compressed File");
+        ok = 0;
+    }
+    if (ok && load.ascii == 1)
+    {
+        //what is left after the last endfacet, usually just endsolid
+        ok = parse_stl_ascii_block(&load, (const char*) carry, carried, 1) >= 0;
+        if (ok && load.count > INT32_MAX)
+        {
+            SDL_Log("Error 10: Corrupt STL (too many triangles)");
+            ok = 0;
+        }
+    }
+    else if (ok && (load.ascii < 0 || decompressed < 84))
+    {
+        SDL_Log("Error 02: File Too Short");
+        ok = 0;
+    }
+    else if (ok && (carried != 0 || load.count != load.announced))
+    {
+        SDL_Log("Error 08: Corrupt STL (header says %lld triangles, file has %lld bytes)", load.announced, decompressed);
+        ok = 0;
+    }
+    if (ok && load.corrupt)
+    {
+        SDL_Log("Error 09: Corrupt STL (%d triangles with non-finite vertices)", load.corrupt);
+        ok = 0;
+    }
+
+    for (int k = 0; k < COMPRESSED_BLOCKS; k++) {free(decompress.blocks[k]);}
+    SDL_DestroyCondition(decompress.emptied);
+    SDL_DestroyCondition(decompress.filled);
+    SDL_DestroyMutex(decompress.mutex);
+    free(load.chunks.boundaries);
+    free(load.chunks.first_polygon);
+    free(load.chunks.chunk_polygons);
+    free(carry);
+    if (!ok)
+    {
+        free(load.polygonlist);
+        return NULL;
+    }
+    *number_of_polygons = (int) load.count;
+    return load.polygonlist;
+}
+
+long long decode_stl_binary_block(compressed_stl_t* load, const uint8_t* data, size_t size, mesh_stream_t* stream)
+{
+    //whole records from data, returns the bytes used or -1 on a corrupt file
+    size_t used = 0;
+    if (load->count == 0 && load->polygonlist == NULL)
+    {
+        if (size < 84) {return 0;}
+        uint32_t count;
+        memcpy(&count, data + 80, sizeof(uint32_t));
+        if (count > INT32_MAX)
+        {
+            SDL_Log("Error 08: Corrupt STL (header says %u triangles)", count);
+            return -1;
+        }
+        load->announced = count;
+        //the list grows with the records that actually arrive, the preview is sized by the header like an uncompressed one
+        if (reserve_polygons(load, 1) != 0) {return -1;}
+        stream_begin(stream, count);
+        used = 84;
+    }
+
+    long long records = (size - used) / 50;
+    if (load->count + records > load->announced)
+    {
+        SDL_Log("Error 08: Corrupt STL (header says %lld triangles, file has more)", load->announced);
+        return -1;
+    }
+    if (reserve_polygons(load, load->count + records) != 0) {return -1;}
+    stl_decode_t decode;
+    SDL_SetAtomicInt(&decode.corrupt, 0);
+    decode.records = data + used;
+    decode.polygonlist = load->polygonlist + load->count;
+    parallel_for(records, 16384, decode_stl_records, &decode);
+    load->corrupt += SDL_GetAtomicInt(&decode.corrupt);
+    stream_publish(stream, load->polygonlist, load->count, load->count + records);
+    load->count += records;
+    return used + records * 50;
+}
+
+long long parse_stl_ascii_block(compressed_stl_t* load, const char* data, size_t size, int last)
+{
+    //the facets up to the last endfacet, or everything in the last block; returns the bytes used or -1 on a corrupt file
+    size_t end = size;
+    if (!last)
+    {
+        const char* p = data + size;
+        while (p - data > 8 && !(memcmp(p - 9, "endfacet", 8) == 0 && (unsigned char) p[-1] <= ' ' && (p - 9 == data || (unsigned char) p[-10] <= ' '))) {p--;}
+        if (p - data <= 8) {return 0;}
+        end = p - 1 - data;
+    }
+
+    int chunks = end < ((size_t) 1 << 20) ? 1 : SDL_GetNumLogicalCPUCores() * 4;
+    if (chunks > 256) {chunks = 256;}
+    long long total = split_stl_ascii(&load->chunks, data, end, chunks);
+    if (reserve_polygons(load, load->count + total) != 0) {return -1;}
+    load->chunks.polygonlist = load->polygonlist + load->count;
+    load->chunks.first_chunk = 0;
+    SDL_SetAtomicInt(&load->chunks.corrupt, 0);
+    parallel_for(chunks, 1, parse_stl_ascii_chunks, &load->chunks);
+    if (SDL_GetAtomicInt(&load->chunks.corrupt))
+    {
+        SDL_Log("Error 10: Corrupt STL (malformed ascii facet)");
+        return -1;
+    }
+    load->count += total;
+    return end;
+}
+
+int reserve_polygons(compressed_stl_t* load, long long count)
+{
+    //doubles, so a file of n triangles is copied about once
+    if (count <= load->capacity && load->polygonlist) {return 0;}
+    long long capacity = load->capacity ? load->capacity : 65536;
+    while (capacity < count) {capacity *= 2;}
+    polygon_t* polygonlist = realloc(load->polygonlist, sizeof(polygon_t) * capacity);
+    if (polygonlist == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return 1;
+    }
+    load->polygonlist = polygonlist;
+    load->capacity = capacity;
+    return 0;
+}
+
+int decompress_thread(void* data)
+{
+    decompress_t* decompress = data;
+    int result = 1;
+#ifdef HAVE_ZLIB
+    if (decompress->format == COMPRESSION_GZIP) {result = inflate_blocks(decompress);}
+#endif
+#ifdef HAVE_ZSTD
+    if (decompress->format == COMPRESSION_ZSTD) {result = zstd_blocks(decompress);}
+#endif
+    SDL_LockMutex(decompress->mutex);
+    decompress->finished = result == 0 ? 1 : -1;
+    SDL_SignalCondition(decompress->filled);
+    SDL_UnlockMutex(decompress->mutex);
+    return result;
+}
+
+#ifdef HAVE_ZLIB
+int inflate_blocks(decompress_t* decompress)
+{
+    //gzip members one after another, the way concatenated .gz files are read; returns 1 on corrupt or cut off data
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    //15 bit window, 32 takes a gzip or a zlib header
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {return 1;}
+    size_t offset = 0;
+    int status = Z_OK;
+    int more = 1;
+    uint8_t* block;
+    while (more && (block = next_free_block(decompress)) != NULL)
+    {
+        z.next_out = block;
+        z.avail_out = COMPRESSED_BLOCK;
+        while (z.avail_out > 0)
+        {
+            if (z.avail_in == 0)
+            {
+                if (offset == decompress->size) {more = 0; break;}
+                //avail_in is 32 bits, larger files are fed a gigabyte at a time
+                size_t take = decompress->size - offset < ((size_t) 1 << 30) ? decompress->size - offset : (size_t) 1 << 30;
+                z.next_in = (Bytef*) decompress->data + offset;
+                z.avail_in = (uInt) take;
+                offset += take;
+            }
+            status = inflate(&z, Z_NO_FLUSH);
+            if (status == Z_STREAM_END)
+            {
+                if (z.avail_in > 0 || offset < decompress->size) {inflateReset(&z);}
+            }
+            else if (status != Z_OK)
+            {
+                more = 0;
+                break;
+            }
+        }
+        if (z.avail_out < COMPRESSED_BLOCK) {publish_block(decompress, COMPRESSED_BLOCK - z.avail_out);}
+    }
+    inflateEnd(&z);
+    return status != Z_STREAM_END;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+int zstd_blocks(decompress_t* decompress)
+{
+    //any number of frames, returns 1 on corrupt or cut off data
+    ZSTD_DStream* z = ZSTD_createDStream();
+    if (z == NULL) {return 1;}
+    ZSTD_inBuffer input = {decompress->data, decompress->size, 0};
+    //0 once a frame is complete
+    size_t hint = 0;
+    int result = 0;
+    int more = 1;
+    uint8_t* block;
+    while (more && (block = next_free_block(decompress)) != NULL)
+    {
+        ZSTD_outBuffer output = {block, COMPRESSED_BLOCK, 0};
+        while (output.pos < output.size)
+        {
+            hint = ZSTD_decompressStream(z, &output, &input);
+            if (ZSTD_isError(hint)) {result = 1; more = 0; break;}
+            //everything read and nothing held back, so the block is as full as it gets
+            if (input.pos == input.size && output.pos < output.size) {more = 0; break;}
+        }
+        if (output.pos) {publish_block(decompress, output.pos);}
+    }
+    ZSTD_freeDStream(z);
+    return result || hint != 0;
+}
+#endif
+
+uint8_t* next_free_block(decompress_t* decompress)
+{
+    //for the decompressor, waits for the loader to hand a block back; NULL once the loader has stopped
+    SDL_LockMutex(decompress->mutex);
+    while (!decompress->cancel && decompress->produced - decompress->consumed == COMPRESSED_BLOCKS) {SDL_WaitCondition(decompress->emptied, decompress->mutex);}
+    uint8_t* block = decompress->cancel ? NULL : decompress->blocks[decompress->produced % COMPRESSED_BLOCKS] + COMPRESSED_CARRY;
+    SDL_UnlockMutex(decompress->mutex);
+    return block;
+}
+
+void publish_block(decompress_t* decompress, size_t length)
+{
+    SDL_LockMutex(decompress->mutex);
+    decompress->lengths[decompress->produced % COMPRESSED_BLOCKS] = length;
+    decompress->produced++;
+    SDL_SignalCondition(decompress->filled);
+    SDL_UnlockMutex(decompress->mutex);
+}
+
+uint8_t* take_block(decompress_t* decompress, size_t* length)
+{
+    //for the loader, the next block in order; NULL once the decompressor has finished or failed and every block is taken
+    SDL_LockMutex(decompress->mutex);
+    while (decompress->consumed == decompress->produced && !decompress->finished) {SDL_WaitCondition(decompress->filled, decompress->mutex);}
+    uint8_t* block = NULL;
+    if (decompress->consumed < decompress->produced)
+    {
+        block = decompress->blocks[decompress->consumed % COMPRESSED_BLOCKS] + COMPRESSED_CARRY;
+        *length = decompress->lengths[decompress->consumed % COMPRESSED_BLOCKS];
+    }
+    SDL_UnlockMutex(decompress->mutex);
+    return block;
+}
+
+void return_block(decompress_t* decompress)
+{
+    SDL_LockMutex(decompress->mutex);
+    decompress->consumed++;
+    SDL_SignalCondition(decompress->emptied);
+    SDL_UnlockMutex(decompress->mutex);
+}
+
+const char* next_word(const char* p, const char* end, size_t* length)
+{
+    while (p < end && (unsigned char) *p <= ' ') {p++;}
+    if (p == end) {return NULL;}
+    const char* start = p;
+    while (p < end && (unsigned char) *p > ' ') {p++;}
+    *length = p - start;
+    return start;
+}
+
+const char* find_word(const char* p, const char* end, const char* word, size_t word_length)
+{
+    //next occurrence of word that is delimited by whitespace on both sides
+    const char* start = p;
+    while ((size_t) (end - p) >= word_length)
+    {
+        p = memchr(p, word[0], end - p - word_length + 1);
+        if (p == NULL) {return NULL;}
+        if (memcmp(p, word, word_length) == 0 &&
+            (p == start || (unsigned char) p[-1] <= ' ') &&
+            (p + word_length == end || (unsigned char) p[word_length] <= ' '))
+        {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+int parse_float(const char* p, size_t length, float* out)
+{
+    //locale independent [+-]digits[.digits][(e|E)[+-]digits], no strtof
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char* end = p + length;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {negative = *p == '-'; p++;}
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        //digits past what fits in the mantissa only shift the exponent
+        if (mantissa < 1000000000000000000ull) {mantissa = mantissa * 10 + (*p - '0');}
+        else {exponent++;}
+        p++;
+        digits++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (mantissa < 1000000000000000000ull) {mantissa = mantissa * 10 + (*p - '0'); exponent--;}
+            p++;
+            digits++;
+        }
+    }
+    if (digits == 0) {return 0;}
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        int exponent_negative = 0;
+        int value = 0;
+        if (p < end && (*p == '-' || *p == '+')) {exponent_negative = *p == '-'; p++;}
+        if (p == end) {return 0;}
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (value < 10000) {value = value * 10 + (*p - '0');}
+            p++;
+        }
+        exponent += exponent_negative ? -value : value;
+    }
+    if (p != end) {return 0;}
+
+    double result = (double) mantissa;
+    while (exponent > 22) {result *= 1e22; exponent -= 22;}
+    while (exponent < -22) {result /= 1e22; exponent += 22;}
+    result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    *out = (float) (negative ? -result : result);
+    return isfinite(*out);
+}
+
+int nonfinite_word(const char* p, size_t length)
+{
+    //nan, inf and infinity in any case and with an optional sign as printf writes them, or msvc's 1.#INF and 1.#QNAN
+    if (length > 0 && (*p == '-' || *p == '+')) {p++; length--;}
+    if (length >= 3 && (SDL_strncasecmp(p, "nan", 3) == 0 || SDL_strncasecmp(p, "inf", 3) == 0)) {return 1;}
+    return memchr(p, '#', length) != NULL && length > 0 && *p >= '0' && *p <= '9';
+}
+
+void parallel_for(long long count, long long min_per_thread, void (*job)(void* data, long long first, long long last), void* data)
+{
+    //split [0, count) into one contiguous range per core, small inputs stay on the calling thread
+    int threads = SDL_GetNumLogicalCPUCores();
+    if (settings.parallel_threads > 0 && threads > settings.parallel_threads) {threads = settings.parallel_threads;}
+    if (threads > 64) {threads = 64;}
+    if (count / min_per_thread < threads) {threads = count / min_per_thread;}
+    if (threads <= 1)
+    {
+        job(data, 0, count);
+        return;
+    }
+
+    parallel_range_t ranges[64];
+    SDL_Thread* workers[64];
+    for (int i = 0; i < threads; i++)
+    {
+        ranges[i].job = job;
+        ranges[i].data = data;
+        ranges[i].first = count * i / threads;
+        ranges[i].last = count * (i + 1) / threads;
+    }
+    for (int i = 1; i < threads; i++)
+    {
+        workers[i] = SDL_CreateThread(parallel_range_thread, "parallel_for", &ranges[i]);
+        //no thread, do the work here instead
+        if (workers[i] == NULL) {job(data, ranges[i].first, ranges[i].last);}
+    }
+    job(data, ranges[0].first, ranges[0].last);
+    for (int i = 1; i < threads; i++)
+    {
+        if (workers[i]) {SDL_WaitThread(workers[i], NULL);}
+    }
+}
+
+int parallel_range_thread(void* data)
+{
+    parallel_range_t* range = data;
+    range->job(range->data, range->first, range->last);
+    return 0;
+}
+
+//shared by every caller of get_thread_pool until stop_thread_pool
+static thread_pool_t* thread_pool = NULL;
+
+thread_pool_t* get_thread_pool(void)
+{
+    //created on first use with settings.threads participants, the calling thread being one of them
+    if (thread_pool) {return thread_pool;}
+
+    int threads = settings.threads > 0 ? settings.threads : SDL_GetNumLogicalCPUCores();
+    if (threads < 1) {threads = 1;}
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    pool->threads = calloc(threads, sizeof(SDL_Thread*));
+    pool->queue_next = calloc(threads, sizeof(SDL_AtomicInt));
+    pool->queue_end = calloc(threads, sizeof(int));
+    pool->busy_ms = calloc(threads, sizeof(double));
+    pool->mutex = SDL_CreateMutex();
+    pool->wake = SDL_CreateCondition();
+    pool->done = SDL_CreateCondition();
+    pool->workers = calloc(threads, sizeof(pool_worker_t));
+    for (int i = 1; i < threads; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = pool->number_of_threads + 1;
+        SDL_Thread* thread = SDL_CreateThread(pool_worker_thread, "raster", &pool->workers[i]);
+        if (thread == NULL) {break;}
+        pool->threads[pool->number_of_threads++] = thread;
+    }
+    thread_pool = pool;
+    return pool;
+}
+
+void stop_thread_pool(void)
+{
+    //wake the idle workers with quit set, join them and free the queues; the next get_thread_pool starts a new pool
+    thread_pool_t* pool = thread_pool;
+    if (pool == NULL) {return;}
+    SDL_LockMutex(pool->mutex);
+    pool->quit = 1;
+    SDL_BroadcastCondition(pool->wake);
+    SDL_UnlockMutex(pool->mutex);
+    for (int i = 0; i < pool->number_of_threads; i++) {SDL_WaitThread(pool->threads[i], NULL);}
+    SDL_DestroyCondition(pool->done);
+    SDL_DestroyCondition(pool->wake);
+    SDL_DestroyMutex(pool->mutex);
+    free(pool->busy_ms);
+    free(pool->queue_end);
+    free(pool->queue_next);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+    thread_pool = NULL;
+}
+
+void pool_run(thread_pool_t* pool, void (*job)(void* data, int item, int worker), void* data, int items)
+{
+    //hand every participant a contiguous share of the items, then wait until all of them are done
+    int participants = pool->number_of_threads + 1;
+    SDL_LockMutex(pool->mutex);
+    pool->job = job;
+    pool->data = data;
+    for (int k = 0; k < participants; k++)
+    {
+        SDL_SetAtomicInt(&pool->queue_next[k], items * k / participants);
+        pool->queue_end[k] = items * (k + 1) / participants;
+        pool->busy_ms[k] = 0;
+    }
+    SDL_SetAtomicInt(&pool->steals, 0);
+    pool->busy = pool->number_of_threads;
+    pool->generation++;
+    SDL_BroadcastCondition(pool->wake);
+    SDL_UnlockMutex(pool->mutex);
+
+    pool_drain(pool, 0);
+
+    SDL_LockMutex(pool->mutex);
+    while (pool->busy > 0) {SDL_WaitCondition(pool->done, pool->mutex);}
+    SDL_UnlockMutex(pool->mutex);
+}
+
+void pool_drain(thread_pool_t* pool, int self)
+{
+    //own queue first, then steal from the others; claiming an item is a single atomic increment
+    Uint64 start = SDL_GetPerformanceCounter();
+    int participants = pool->number_of_threads + 1;
+    for (int k = 0; k < participants; k++)
+    {
+        int victim = (self + k) % participants;
+        int item;
+        while ((item = SDL_AddAtomicInt(&pool->queue_next[victim], 1)) < pool->queue_end[victim])
+        {
+            if (victim != self) {SDL_AddAtomicInt(&pool->steals, 1);}
+            pool->job(pool->data, item, self);
+        }
+    }
+    pool->busy_ms[self] = elapsed_ms(start);
+}
+
+int pool_worker_thread(void* data)
+{
+    pool_worker_t* worker = data;
+    thread_pool_t* pool = worker->pool;
+    int seen = 0;
+    SDL_LockMutex(pool->mutex);
+    while (1)
+    {
+        while (pool->generation == seen && !pool->quit) {SDL_WaitCondition(pool->wake, pool->mutex);}
+        if (pool->quit) {break;}
+        seen = pool->generation;
+        SDL_UnlockMutex(pool->mutex);
+
+        pool_drain(pool, worker->index);
+
+        SDL_LockMutex(pool->mutex);
+        if (--pool->busy == 0) {SDL_SignalCondition(pool->done);}
+    }
+    SDL_UnlockMutex(pool->mutex);
+    return 0;
+}
+
+polygon_t* default_cube(int* number_of_polygons)
+{
+    //front
+    point3d p1 = {1.0f, 1.0f, 1.0f}; //top right
+    point3d p2 = {1.0f, -1.0f, 1.0f}; //bottom right
+    point3d p3 = {-1.0f, 1.0f, 1.0f}; //top left
+    point3d p4 = {-1.0f, -1.0f, 1.0f}; //bottom left
+    //back
+    point3d p5 = {1.0f, 1.0f, -1.0f}; //top right
+    point3d p6 = {1.0f, -1.0f, -1.0f}; //bottom right
+    point3d p7 = {-1.0f, 1.0f, -1.0f}; //top left
+    point3d p8 = {-1.0f, -1.0f, -1.0f}; //bottom left
+    //every polygon counter clockwise seen from outside, like an STL facet
+
+    polygon_t polygon = newpolygon(RED, p1, p3, p4);
+    polygon_t polygon2 = newpolygon(WHITE, p2, p1, p4);
+
+    *number_of_polygons = 12;
+    polygon_t* polygonlist = malloc(sizeof(polygon_t) * *number_of_polygons);
+    //front face
+    polygonlist[0] = polygon;
+    polygonlist[1] = polygon2;
+    //left face
+    polygonlist[2] = newpolygon(RED, p3, p8, p4);
+    polygonlist[3] = newpolygon(WHITE, p7, p8, p3);
+    //top face
+    polygonlist[4] = newpolygon(RED, p1, p5, p3);
+    polygonlist[5] = newpolygon(WHITE, p3, p5, p7);
+
+    //back face
+    polygonlist[6] = newpolygon(RED, p5, p6, p7);
+    polygonlist[7] = newpolygon(WHITE, p8, p7, p6);
+    //right face
+    polygonlist[8] = newpolygon(RED, p1, p2, p5);
+    polygonlist[9] = newpolygon(WHITE, p2, p6, p5);
+    //bottom face
+    polygonlist[10] = newpolygon(RED, p2, p4, p8);
+    polygonlist[11] = newpolygon(WHITE, p2, p8, p6);
+
+    /*for (int i = 0; i < 480; i++)
+    {
+        printf("%02x", *(i + (uint8_t*) polygonlist));
+    }*/
+    return polygonlist;
+}
+
+polygon_t* generate_model(const char* spec, int* number_of_polygons)
+{
+    //"sphere" or "grid", optionally followed by ":n" for about n triangles; the same spec always gives the same polygons
+    const char* colon = strchr(spec, ':');
+    size_t length = colon ? (size_t) (colon - spec) : strlen(spec);
+    long long triangles = colon ? atoll(colon + 1) : 0;
+    if (colon && (triangles < 1 || triangles > 100000000))
+    {
+        SDL_Log("Error 28: Generated Model Must Be sphere Or grid With 1 To 100000000 Triangles");
+        return NULL;
+    }
+    if (length == 6 && strncmp(spec, "sphere", 6) == 0) {return generate_sphere(triangles ? (int) triangles : 20000, number_of_polygons);}
+    if (length == 4 && strncmp(spec, "grid", 4) == 0) {return generate_grid(triangles ? (int) triangles : 1000000, number_of_polygons);}
+    SDL_Log("Error 28: Generated Model Must Be sphere Or grid With 1 To 100000000 Triangles");
+    return NULL;
+}
+
+polygon_t* generate_sphere(int triangles, int* number_of_polygons)
+{
+    //a uv sphere of radius 1 wound outwards, single triangles around the poles, red and white checkered
+    int rings = (int) sqrt(triangles / 4.0);
+    if (rings < 2) {rings = 2;}
+    int segments = rings * 2;
+    *number_of_polygons = 2 * segments * (rings - 1);
+    polygon_t* polygonlist = malloc(sizeof(polygon_t) * *number_of_polygons);
+    if (polygonlist == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return NULL;
+    }
+    int count = 0;
+    for (int ring = 0; ring < rings; ring++)
+    {
+        float theta0 = (float) (PI * ring / rings);
+        float theta1 = (float) (PI * (ring + 1) / rings);
+        for (int segment = 0; segment < segments; segment++)
+        {
+            float phi0 = (float) (2 * PI * segment / segments);
+            float phi1 = (float) (2 * PI * (segment + 1) / segments);
+            point3d top_left = sphere_point(theta0, phi0);
+            point3d bottom_left = sphere_point(theta1, phi0);
+            point3d bottom_right = sphere_point(theta1, phi1);
+            point3d top_right = sphere_point(theta0, phi1);
+            color_t color = (ring + segment) % 2 ? WHITE : RED;
+            if (ring > 0) {polygonlist[count++] = newpolygon(color, top_left, top_right, bottom_left);}
+            if (ring < rings - 1) {polygonlist[count++] = newpolygon(color, top_right, bottom_right, bottom_left);}
+        }
+    }
+    //filled in from the winding when the mesh is built
+    for (int i = 0; i < count; i++) {polygonlist[i].normal_vector = (point3d) {0.0f, 0.0f, 0.0f};}
+    return polygonlist;
+}
+
+point3d sphere_point(float theta, float phi)
+{
+    //theta from the top pole, phi around y
+    point3d ret;
+    ret.x = sinf(theta) * cosf(phi);
+    ret.y = cosf(theta);
+    ret.z = sinf(theta) * sinf(phi);
+    return ret;
+}
+
+polygon_t* generate_grid(int triangles, int* number_of_polygons)
+{
+    //a rippled height field over [-1, 1] in x and y facing +z, two triangles per cell, cells checkered red and white
+    int cells = (int) sqrt(triangles / 2.0);
+    if (cells < 1) {cells = 1;}
+    *number_of_polygons = 2 * cells * cells;
+    polygon_t* polygonlist = malloc(sizeof(polygon_t) * *number_of_polygons);
+    if (polygonlist == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return NULL;
+    }
+    int count = 0;
+    for (int row = 0; row < cells; row++)
+    {
+        for (int column = 0; column < cells; column++)
+        {
+            point3d corners[4];
+            for (int k = 0; k < 4; k++)
+            {
+                float x = -1.0f + 2.0f * (column + (k == 1 || k == 2)) / cells;
+                float y = -1.0f + 2.0f * (row + (k >= 2)) / cells;
+                corners[k] = (point3d) {x, y, 0.1f * sinf(6.0f * x) * cosf(6.0f * y)};
+            }
+            color_t color = (row + column) % 2 ? WHITE : RED;
+            polygonlist[count++] = newpolygon(color, corners[0], corners[1], corners[2]);
+            polygonlist[count++] = newpolygon(color, corners[0], corners[2], corners[3]);
+        }
+    }
+    for (int i = 0; i < count; i++) {polygonlist[i].normal_vector = (point3d) {0.0f, 0.0f, 0.0f};}
+    return polygonlist;
+}
+
+int run_headless(mesh_t* mesh, int frames, const char* camera_path, const char* snapshot_path, const char* reference_path, int tolerance)
+{
+    if (frames < 1) {frames = 1;}
+
+    int camera_count = 0;
+    camera_t* cameras = NULL;
+    if (camera_path)
+    {
+        cameras = load_camera_path(camera_path, &camera_count);
+        if (cameras == NULL) {return 1;}
+    }
+
+    //same ARGB8888 layout as the streaming texture, pitch = width * 4, always at window size
+    render_target_t target;
+    int no_target = init_render_target(&target, 1);
+    //one column per stage: clear, transform, cull, raster, upload, total
+    double* samples = malloc(sizeof(double) * frames * 6);
+    if (no_target || samples == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(target.pixels);
+        free(samples);
+        free(cameras);
+        return 1;
+    }
+
+    //levels of detail are finished first so every run draws the same thing
+    wait_lod_build(mesh);
+
+    int result = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        camera_t camera;
+        if (cameras)
+        {
+            camera = cameras[frame % camera_count];
+        }
+        else
+        {
+            //default orbit: one full turn around y over the run
+            camera.xangle = 0.35f;
+            camera.yangle = 0.35f + (float) (2 * PI * frame / frames);
+            camera.scale = settings.scale;
+            camera.perspective = settings.perspective;
+        }
+        settings.scale = camera.scale;
+        settings.perspective = camera.perspective;
+
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+
+        Uint64 clear_start = SDL_GetPerformanceCounter();
+        clear_rect(&target, target.width, target.dirty);
+        target.dirty = (rect_t) {0, 0, 0, 0};
+        frame_timing.clear_ms = profile_end("clear", clear_start, 0);
+
+        polyrender(&target, select_lod(mesh, 0), camera.xangle, camera.yangle, settings.rendermode);
+
+        //nothing is uploaded or presented without a texture
+        frame_timing.upload_ms = 0;
+        frame_timing.present_ms = 0;
+
+        samples[frame] = frame_timing.clear_ms;
+        samples[frames + frame] = frame_timing.transform_ms;
+        samples[frames * 2 + frame] = frame_timing.cull_ms;
+        samples[frames * 3 + frame] = frame_timing.raster_ms;
+        samples[frames * 4 + frame] = frame_timing.upload_ms;
+        samples[frames * 5 + frame] = profile_end("frame", frame_start, 0);
+        profile_frame();
+
+        //a %d in the snapshot name means one image per frame, otherwise only the last frame is written
+        char name[1024];
+        if (snapshot_path && (frame_path(snapshot_path, frame, name, sizeof(name)) == 1 || frame == frames - 1))
+        {
+            if (write_snapshot(name, target.pixels, target.width, target.height) != 0)
+            {
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    const char* stage_names[6] = {"clear", "transform", "cull", "raster", "upload", "total"};
+    printf("frames: %d  triangles: %lld  vertices: %lld  resolution: %dx%d\n", frames, mesh->number_of_polygons, mesh->number_of_vertices, settings.width, settings.height);
+    printf("mesh: %.1f MB%s\n", mesh_bytes(mesh) / 1048576.0, mesh->qx ? " compact" : "");
+    printf("%-10s %10s %10s %10s\n", "stage", "p50 ms", "p95 ms", "p99 ms");
+    for (int stage = 0; stage < 6; stage++)
+    {
+        double* column = samples + frames * stage;
+        qsort(column, frames, sizeof(double), compare_double);
+        printf("%-10s %10.3f %10.3f %10.3f\n", stage_names[stage], percentile(column, frames, 0.50), percentile(column, frames, 0.95), percentile(column, frames, 0.99));
+    }
+
+    printf("lod: level %d of %d\n", raster_stats.lod_level, raster_stats.lod_levels);
+    printf("polygons: %lld in view, %lld skipped by the bvh\n", raster_stats.visible_polygons + raster_stats.culled.backface + raster_stats.culled.outside + raster_stats.culled.behind, raster_stats.bvh_skipped);
+    printf("meshlets: %lld of %lld culled whole, %lld polygons in them\n", raster_stats.meshlets_culled, raster_stats.meshlets, raster_stats.meshlet_skipped);
+    printf("hi-z: %lld meshlets occluded, %lld polygons in them\n", raster_stats.meshlets_occluded, raster_stats.occlusion_culled);
+    printf("last frame vertices: %lld rotated, %lld projected\n", raster_stats.rotated_vertices, raster_stats.projected_vertices);
+    printf("polygons: %lld drawn  culled %lld back facing, %lld off screen, %lld behind the perspective plane\n",
+        raster_stats.visible_polygons, raster_stats.culled.backface, raster_stats.culled.outside, raster_stats.culled.behind);
+    printf("last frame: %lld triangles submitted, %lld lines, %lld pixels written\n", raster_stats.submitted, raster_stats.lines, raster_stats.pixels);
+    printf("tiles: %d of %dx%d  threads: %d  steals: %d\n", raster_stats.tiles, settings.tile_size, settings.tile_size, raster_stats.threads, raster_stats.steals);
+    printf("polygons per tile: max %lld mean %.1f  tile ms: max %.3f mean %.3f  thread ms: max %.3f mean %.3f\n",
+        raster_stats.max_tile_polygons, raster_stats.mean_tile_polygons, raster_stats.max_tile_ms, raster_stats.mean_tile_ms, raster_stats.max_thread_ms, raster_stats.mean_thread_ms);
+
+    //the last frame against a reference image, a pixel differs when a channel is further off than the tolerance
+    if (reference_path && result == 0)
+    {
+        int width = 0;
+        int height = 0;
+        uint32_t* reference = read_ppm(reference_path, &width, &height);
+        if (reference == NULL) {result = 1;}
+        else if (width != target.width || height != target.height)
+        {
+            SDL_Log("Error 30: Reference Image Is %dx%d, Not %dx%d", width, height, target.width, target.height);
+            result = 1;
+        }
+        else
+        {
+            int worst = 0;
+            long long differing = compare_image(target.pixels, reference, (long long) width * height, tolerance, &worst);
+            printf("compare: %lld of %lld pixels differ by more than %d, at most by %d\n", differing, (long long) width * height, tolerance, worst);
+            if (differing) {result = 1;}
+        }
+        free(reference);
+    }
+
+    stop_thread_pool();
+    free(samples);
+    free(target.pixels);
+    free(cameras);
+    return result;
+}
+
+int run_bench(const char* json_path)
+{
+    //every kernel timed on its own, and whole frames of the default cube and generated models; the same seeds and models
+    //every run, so results can be compared from one run to the next
+    render_target_t target;
+    int no_target = init_render_target(&target, 1);
+    int calls = 50;
+    double* samples = malloc(sizeof(double) * calls);
+    point3d* points = malloc(sizeof(point3d) * 100000);
+    if (no_target || samples == NULL || points == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(target.pixels);
+        free(samples);
+        free(points);
+        return 1;
+    }
+    bench_result_t results[16];
+    int number_of_results = 0;
+    uint32_t seed = 1;
+
+    //lines across and a little past the target, so some are clipped
+    for (int call = 0; call < calls; call++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < 10000; k++)
+        {
+            float ends[4];
+            for (int e = 0; e < 4; e++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                ends[e] = (float) (seed >> 8) / (1 << 24) * ((e % 2 ? target.height : target.width) + 100) - 50;
             }
+            line(&target, (point3d) {ends[0], ends[1], 0}, (point3d) {ends[2], ends[3], 0}, WHITE);
+        }
+        samples[call] = elapsed_ms(start);
+    }
+    bench_record(&results[number_of_results++], "line", 10000, samples, calls);
+
+    for (int k = 0; k < 100000; k++)
+    {
+        float coordinates[3];
+        for (int e = 0; e < 3; e++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            coordinates[e] = (float) (seed >> 8) / (1 << 23) - 1;
+        }
+        points[k] = (point3d) {coordinates[0], coordinates[1], coordinates[2]};
+    }
+    //the sum is stored where the compiler cannot leave it out, so the points are not either
+    volatile float sink = 0;
+    for (int call = 0; call < calls; call++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        float sum = 0;
+        for (int k = 0; k < 100000; k++)
+        {
+            point3d point = model_to_2d(points[k], 0.35f, 0.01f * call);
+            sum += point.x + point.y;
+        }
+        sink = sum;
+        samples[call] = elapsed_ms(start);
+    }
+    (void) sink;
+    bench_record(&results[number_of_results++], "model_to_2d", 100000, samples, calls);
+
+    for (int call = 0; call < calls; call++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < 10000; k++)
+        {
+            numberrender(&target, k * 7919 % 100000, (point3d) {(float) (k % 40 * 30), (float) (k / 40 % 30 * 24), 0}, 5);
+        }
+        samples[call] = elapsed_ms(start);
+    }
+    bench_record(&results[number_of_results++], "numberrender", 10000, samples, calls);
+
+    //whole frames, turned a little every call so nothing transformed can be reused
+    const char* specs[3] = {NULL, "sphere:20000", "grid:1000000"};
+    const char* frame_names[3] = {"polyrender cube", "polyrender sphere", "polyrender grid"};
+    int frame_calls[3] = {calls, calls, 10};
+    polygon_t* sphere = NULL;
+    int sphere_polygons = 0;
+    for (int model = 0; model < 3; model++)
+    {
+        int number_of_polygons = 0;
+        polygon_t* polygonlist = specs[model] ? generate_model(specs[model], &number_of_polygons) : default_cube(&number_of_polygons);
+        mesh_t mesh = {0};
+        if (polygonlist == NULL || mesh_from_polygons(polygonlist, number_of_polygons, &mesh) != 0)
+        {
+            free(polygonlist);
+            continue;
+        }
+        free(polygonlist);
+        settings.scale = fit_scale(&mesh, target.width, target.height);
+        for (int call = -1; call < frame_calls[model]; call++)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            clear_rect(&target, target.width, target.dirty);
+            target.dirty = (rect_t) {0, 0, 0, 0};
+            polyrender(&target, &mesh, 0.35f, 0.35f + 0.05f * call, settings.rendermode);
+            //the first call only sizes the buffers
+            if (call >= 0) {samples[call] = elapsed_ms(start);}
+        }
+        bench_record(&results[number_of_results++], frame_names[model], mesh.number_of_polygons, samples, frame_calls[model]);
+        free_mesh(&mesh);
+    }
+
+    //the loaders on files made in memory from a sphere, so no disk time is counted
+    sphere = generate_model("sphere:100000", &sphere_polygons);
+    for (int ascii = 0; sphere && ascii < 2; ascii++)
+    {
+        size_t size = 0;
+        uint8_t* image = stl_image(sphere, sphere_polygons, ascii, &size);
+        if (image == NULL) {continue;}
+        for (int call = 0; call < 10; call++)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            int number_of_polygons = 0;
+            polygon_t* polygonlist = ascii ? load_stl_ascii(image, size, &number_of_polygons, NULL) : load_stl_binary(image, size, &number_of_polygons, NULL);
+            samples[call] = elapsed_ms(start);
+            free(polygonlist);
+        }
+        bench_record(&results[number_of_results++], ascii ? "stl ascii" : "stl binary", (long long) size, samples, 10);
+        free(image);
+    }
+    free(sphere);
+
+    printf("%-18s %12s %8s %10s %10s %10s %14s\n", "benchmark", "items", "calls", "min ms", "p50 ms", "p95 ms", "items/s");
+    for (int k = 0; k < number_of_results; k++)
+    {
+        bench_result_t* bench = &results[k];
+        printf("%-18s %12lld %8d %10.3f %10.3f %10.3f %14.0f\n", bench->name, bench->items, bench->calls, bench->min_ms, bench->median_ms, bench->p95_ms,
+            bench->median_ms > 0 ? bench->items * 1000.0 / bench->median_ms : 0);
+    }
+
+    int result = 0;
+    FILE* file = fopen(json_path, "w");
+    if (file == NULL) {result = 1;}
+    else
+    {
+        fprintf(file, "{\"width\":%d,\"height\":%d,\"threads\":%d,\"tile_size\":%d,\"benchmarks\":[\n", target.width, target.height, get_thread_pool()->number_of_threads + 1, settings.tile_size);
+        for (int k = 0; k < number_of_results; k++)
+        {
+            bench_result_t* bench = &results[k];
+            fprintf(file, "{\"name\":\"%s\",\"items\":%lld,\"calls\":%d,\"min_ms\":%.4f,\"median_ms\":%.4f,\"p95_ms\":%.4f,\"items_per_s\":%.0f}%s\n",
+                bench->name, bench->items, bench->calls, bench->min_ms, bench->median_ms, bench->p95_ms, bench->median_ms > 0 ? bench->items * 1000.0 / bench->median_ms : 0, k + 1 < number_of_results ? "," : "");
+        }
+        fprintf(file, "]}\n");
+        if (fclose(file) != 0) {result = 1;}
+    }
+    if (result) {SDL_Log("Error 31: Benchmark Results Not Written");}
+    stop_thread_pool();
+    free(target.pixels);
+    free(samples);
+    free(points);
+    return result;
+}
+
+void bench_record(bench_result_t* result, const char* name, long long items, double* samples, int calls)
+{
+    qsort(samples, calls, sizeof(double), compare_double);
+    result->name = name;
+    result->items = items;
+    result->calls = calls;
+    result->min_ms = samples[0];
+    result->median_ms = percentile(samples, calls, 0.50);
+    result->p95_ms = percentile(samples, calls, 0.95);
+}
+
+uint8_t* stl_image(const polygon_t* polygons, int number_of_polygons, int ascii, size_t* size)
+{
+    //the bytes of a binary or ascii stl file of the polygons, normals written as zero
+    size_t capacity = ascii ? (size_t) number_of_polygons * 256 + 64 : (size_t) number_of_polygons * 50 + 84;
+    uint8_t* image = calloc(capacity, 1);
+    if (image == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return NULL;
+    }
+    if (!ascii)
+    {
+        uint32_t count = (uint32_t) number_of_polygons;
+        memcpy(image + 80, &count, sizeof(uint32_t));
+        for (int i = 0; i < number_of_polygons; i++)
+        {
+            float values[12] = {0, 0, 0, polygons[i].a.x, polygons[i].a.y, polygons[i].a.z, polygons[i].b.x, polygons[i].b.y, polygons[i].b.z, polygons[i].c.x, polygons[i].c.y, polygons[i].c.z};
+            memcpy(image + 84 + (size_t) i * 50, values, sizeof(values));
         }
+        *size = capacity;
+        return image;
+    }
+    size_t length = (size_t) snprintf((char*) image, capacity, "solid bench\n");
+    for (int i = 0; i < number_of_polygons; i++)
+    {
+        const polygon_t* polygon = &polygons[i];
+        length += (size_t) snprintf((char*) image + length, capacity - length, " facet normal 0 0 0\n  outer loop\n   vertex %g %g %g\n   vertex %g %g %g\n   vertex %g %g %g\n  endloop\n endfacet\n",
+            polygon->a.x, polygon->a.y, polygon->a.z, polygon->b.x, polygon->b.y, polygon->b.z, polygon->c.x, polygon->c.y, polygon->c.z);
+    }
+    length += (size_t) snprintf((char*) image + length, capacity - length, "endsolid bench\n");
+    *size = length;
+    return image;
+}
 
-        
+int run_batch(const char* list_path, const char* out_dir, int angles, const char* format, long long budget)
+{
+    //a turntable of angles images per model, fitted to the image; prints models per second at the end
+    batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.paths = list_models(list_path, &batch.number_of_paths);
+    if (batch.paths == NULL) {return 1;}
+    if (!SDL_CreateDirectory(out_dir))
+    {
+        SDL_Log("Error 26: Output Directory Not Created");
+        free(batch.paths);
+        return 1;
+    }
+    batch.budget = budget;
+    batch.mutex = SDL_CreateMutex();
+    batch.changed = SDL_CreateCondition();
+    render_target_t target;
+    int no_target = init_render_target(&target, 1);
+    if (batch.mutex == NULL || batch.changed == NULL || no_target)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        SDL_DestroyCondition(batch.changed);
+        SDL_DestroyMutex(batch.mutex);
+        free(target.pixels);
+        free(batch.paths);
+        return 1;
+    }
 
-        void* pixels;
-        int pitch; //bytes per horizontal line
-        SDL_LockTexture(screen_texture, NULL, &pixels, &pitch);
+    //loading runs on every core, drawing stays on this thread and the raster pool; the caches are not written next to a library
+    Uint64 start = SDL_GetPerformanceCounter();
+    settings.mesh_cache = 0;
+    SDL_Thread* loaders[64];
+    int number_of_loaders = SDL_GetNumLogicalCPUCores();
+    if (number_of_loaders > 64) {number_of_loaders = 64;}
+    if (number_of_loaders > batch.number_of_paths) {number_of_loaders = batch.number_of_paths;}
+    //the cores are shared between the loaders, so each one's parallel_for splits into fewer threads and not one per core
+    settings.parallel_threads = number_of_loaders > 0 ? SDL_GetNumLogicalCPUCores() / number_of_loaders : 0;
+    if (settings.parallel_threads < 1) {settings.parallel_threads = 1;}
+    for (int k = 0; k < number_of_loaders; k++)
+    {
+        loaders[k] = SDL_CreateThread(batch_loader_thread, "batch loader", &batch);
+        if (loaders[k]) {batch.loaders++;}
+    }
+    //no thread at all, load here between drawing instead, on every core
+    int inline_loading = batch.loaders == 0;
+    if (inline_loading) {settings.parallel_threads = 0;}
 
-        //clear screen with black
-        memset(pixels, 0, pitch * settings.height);
-        
-        uint32_t* pixels32 = (uint32_t*) pixels;
-        
-        //real-time keys
-        const bool* keystate = SDL_GetKeyboardState(NULL);
+    int models = 0;
+    int images = 0;
+    int result = 0;
+    for (;;)
+    {
+        //one model at a time and drawn before the next, there is no other thread to free the budget a wait would be for
+        while (inline_loading && batch.ready == NULL && batch_load_next(&batch, 0)) {}
+        SDL_LockMutex(batch.mutex);
+        while (batch.ready == NULL && batch.loaders > 0) {SDL_WaitCondition(batch.changed, batch.mutex);}
+        batch_model_t* model = batch.ready;
+        if (model) {batch.ready = model->next;}
+        SDL_UnlockMutex(batch.mutex);
+        if (model == NULL) {break;}
 
-        if (keystate[settings.keybind_yrotate_minus]) {yrotation -= settings.sensitivity;}
-        if (keystate[settings.keybind_yrotate_plus]) {yrotation += settings.sensitivity;}
-        if (keystate[settings.keybind_xrotate_plus]) {xrotation += settings.sensitivity;}
-        if (keystate[settings.keybind_xrotate_minus]) {xrotation -= settings.sensitivity;}
-        if (keystate[settings.keybind_zoom_in]) {settings.scale = settings.scale + (100 * settings.sensitivity);}
-        if (keystate[settings.keybind_zoom_out]) {settings.scale = settings.scale < 1 ? 1: settings.scale - (100 * settings.sensitivity);}
-        
-        //check if right mouse button is being held for mouse rotation
-        SDL_MouseButtonFlags mbf = SDL_GetMouseState(&mouse_x_new, &mouse_y_new);
-        //numberrender(pixels32, (mbf & 0b0100) >> 2, (point3d) {.x = 50.0f, .y = 50.0f, .z = 0.0f}, 4);
-        if (((mbf & 0b0100) >> 2) == 1)
+        //the file name without its directory and .stl, a compressed copy keeps its format so it does not overwrite the plain one
+        const char* name = batch.paths[model->path];
+        for (const char* p = name; *p; p++)
         {
-            //rotate based on difference of new and old mouse positions
-            
+            if (*p == '/' || *p == '\\') {name = p + 1;}
         }
-
-        //test line
-        for (int i = 0; i < settings.width; i++)
+        char base[512];
+        snprintf(base, sizeof(base), "%s", name);
+        char* dot = strrchr(base, '.');
+        char* stl = dot;
+        if (dot && (SDL_strcasecmp(dot, ".gz") == 0 || SDL_strcasecmp(dot, ".zst") == 0))
         {
-            put_pixel(pixels32, i, 10, RED);
+            *dot = '\0';
+            stl = strrchr(base, '.');
         }
-        //display buttons
-        renderbutton(pixels32, buttonup);
-        renderbutton(pixels32, buttondown);
-        //display perspective number not float
-        numberrender(pixels32, (int) (settings.perspective * 100.0f), (point3d) {.x = 100.0f, .y = 0.0f, .z = 0.0f}, 3);
-        //display fps
-        numberrender(pixels32, fps, (point3d) {.x=10.0f, .y=10.0f, .z=0.0f}, 3);
-        //render the polygons
-        polyrender(pixels32, polygonlist, number_of_polygons, xrotation, yrotation, settings.rendermode);
-
-        SDL_UnlockTexture(screen_texture);
+        if (stl && SDL_strcasecmp(stl, ".stl") == 0) {*stl = '\0';}
+        if (stl != dot) {snprintf(base + strlen(base), sizeof(base) - strlen(base), "_%s", dot + 1);}
 
-        SDL_RenderClear(renderer);
-        SDL_RenderTexture(renderer, screen_texture, NULL, NULL);
-        SDL_RenderPresent(renderer);
-
-        SDL_Delay(settings.ms_delay_per_frame);
+        settings.scale = fit_scale(&model->mesh, target.width, target.height);
+        for (int angle = 0; angle < angles; angle++)
+        {
+            clear_rect(&target, target.width, target.dirty);
+            target.dirty = (rect_t) {0, 0, 0, 0};
+            polyrender(&target, &model->mesh, 0.35f, (float) (2 * PI * angle / angles), settings.rendermode);
+            char path[1600];
+            snprintf(path, sizeof(path), "%s/%s_%02d.%s", out_dir, base, angle, format);
+            if (write_snapshot(path, target.pixels, target.width, target.height) != 0) {result = 1;}
+            else {images++;}
+        }
+        models++;
 
-        SDL_Time end_time;
-        SDL_GetCurrentTime(&end_time);
-        fps = 1000000000 / (end_time - start_time);
-        frame_latency_ms = (end_time - start_time) / 1000;
+        SDL_LockMutex(batch.mutex);
+        batch.used -= model->charge;
+        SDL_BroadcastCondition(batch.changed);
+        SDL_UnlockMutex(batch.mutex);
+        free_mesh(&model->mesh);
+        free(model);
+    }
+    for (int k = 0; k < number_of_loaders; k++)
+    {
+        if (loaders[k]) {SDL_WaitThread(loaders[k], NULL);}
     }
 
-    //end the SDL stuff and heap
-    free(polygonlist);
+    double seconds = elapsed_ms(start) / 1000;
+    printf("batch: %d models, %d images, %d failed to load in %.2f s, %.1f models/s\n", models, images, batch.failed, seconds, seconds > 0 ? models / seconds : 0);
+    SDL_DestroyCondition(batch.changed);
+    SDL_DestroyMutex(batch.mutex);
+    stop_thread_pool();
+    free(target.pixels);
+    free(batch.paths);
+    return result || batch.failed;
+}
 
-    SDL_DestroySurface(icon);
-    SDL_DestroyTexture(screen_texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+int batch_loader_thread(void* data)
+{
+    //takes the next path off the list until none are left, each loaded model is handed to the drawing thread
+    batch_t* batch = data;
+    while (batch_load_next(batch, 1)) {}
+    SDL_LockMutex(batch->mutex);
+    batch->loaders--;
+    SDL_BroadcastCondition(batch->changed);
+    SDL_UnlockMutex(batch->mutex);
     return 0;
 }
 
+int batch_load_next(batch_t* batch, int wait)
+{
+    //loads the next model on the list onto the ready list, waiting for the budget when asked to; 0 once the list is done
+    int i = SDL_AddAtomicInt(&batch->next_path, 1);
+    if (i >= batch->number_of_paths) {return 0;}
+    const char* path = batch->paths[i];
 
+    //what loading takes is guessed from the file: about three times a binary stl, more for a compressed one
+    uint64_t size = 0;
+    int64_t mtime;
+    file_stamp(path, &size, &mtime);
+    size_t length = strlen(path);
+    int compressed = (length > 3 && SDL_strcasecmp(path + length - 3, ".gz") == 0) || (length > 4 && SDL_strcasecmp(path + length - 4, ".zst") == 0);
+    long long charge = (long long) size * (compressed ? 12 : 3);
+    SDL_LockMutex(batch->mutex);
+    while (wait && batch->used > 0 && batch->used + charge > batch->budget) {SDL_WaitCondition(batch->changed, batch->mutex);}
+    batch->used += charge;
+    SDL_UnlockMutex(batch->mutex);
 
-void polyrender(uint32_t* screen, polygon_t* polygonlist, long long number_of_polygons, float xangle, float yangle, uint8_t mode)
-{
-    for (long long i = 0; i < number_of_polygons; i++)
+    batch_model_t* model = calloc(1, sizeof(batch_model_t));
+    int number_of_polygons = 0;
+    polygon_t* polygonlist = model ? load_model(path, &number_of_polygons, NULL) : NULL;
+    int ok = polygonlist && mesh_from_polygons(polygonlist, number_of_polygons, &model->mesh) == 0;
+    free(polygonlist);
+    if (ok)
     {
-        polygon_t current_polygon = polygonlist[i];
+        center_mesh(&model->mesh);
+        if (settings.compact) {compact_mesh(&model->mesh);}
+    }
 
-        current_polygon.normal_vector = rotatex(xangle, rotatey(yangle, current_polygon.normal_vector));
-        if (settings.occlude && (current_polygon.normal_vector.z < 0)) {return;}
+    SDL_LockMutex(batch->mutex);
+    if (ok)
+    {
+        //once loaded the mesh is all that is left of it
+        model->path = i;
+        model->charge = mesh_bytes(&model->mesh);
+        batch->used += model->charge - charge;
+        model->next = batch->ready;
+        batch->ready = model;
+    }
+    else
+    {
+        SDL_Log("Error 23: %s Not Loaded", path);
+        batch->used -= charge;
+        batch->failed++;
+        free(model);
+    }
+    SDL_BroadcastCondition(batch->changed);
+    SDL_UnlockMutex(batch->mutex);
+    return 1;
+}
 
-        //rotate the polygon
-        current_polygon.a = model_to_2d(current_polygon.a, xangle, yangle);
-        current_polygon.b = model_to_2d(current_polygon.b, xangle, yangle);
-        current_polygon.c = model_to_2d(current_polygon.c, xangle, yangle);
+char** list_models(const char* path, int* count)
+{
+    //the models in a directory, or one path per line of a list file ('#' starts a comment); one allocation, freed as a whole
+    *count = 0;
+    SDL_PathInfo info;
+    if (!SDL_GetPathInfo(path, &info))
+    {
+        SDL_Log("Error 24: Batch List Not Open");
+        return NULL;
+    }
 
-        //render the polygon
-        if (mode && RENDER_LINES)
+    char* text = NULL;
+    size_t text_size = 0;
+    if (info.type == SDL_PATHTYPE_DIRECTORY)
+    {
+        //joined into the same form as a list file
+        int found = 0;
+        char** names = SDL_GlobDirectory(path, NULL, 0, &found);
+        for (int k = 0; names && k < found; k++)
         {
-            line(screen, calculated_position_to_screen_position(current_polygon.a), calculated_position_to_screen_position(current_polygon.b), current_polygon.color);
-            line(screen, calculated_position_to_screen_position(current_polygon.a), calculated_position_to_screen_position(current_polygon.c), current_polygon.color);
-            line(screen, calculated_position_to_screen_position(current_polygon.c), calculated_position_to_screen_position(current_polygon.b), current_polygon.color);
+            if (has_model_extension(names[k])) {text_size += strlen(path) + strlen(names[k]) + 2;}
         }
-        if (mode && FILL_POLYGONS)
+        text = malloc(text_size + 1);
+        size_t used = 0;
+        for (int k = 0; text && names && k < found; k++)
+        {
+            if (has_model_extension(names[k])) {used += sprintf(text + used, "%s/%s\n", path, names[k]);}
+        }
+        if (text) {text[used] = '\0';}
+        SDL_free(names);
+    }
+    else if (has_model_extension(path))
+    {
+        //a single model
+        text = malloc(strlen(path) + 2);
+        if (text) {sprintf(text, "%s\n", path);}
+    }
+    else
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
         {
-            //fill polygon
+            SDL_Log("Error 24: Batch List Not Open");
+            return NULL;
         }
+        text_size = (size_t) info.size;
+        text = malloc(text_size + 1);
+        if (text) {text[fread(text, 1, text_size, file)] = '\0';}
+        fclose(file);
+    }
+    if (text == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        return NULL;
+    }
+
+    //the pointers go in front of the text they point into
+    size_t lines = 1;
+    for (const char* p = text; *p; p++) {lines += *p == '\n';}
+    size_t length = strlen(text);
+    char** paths = malloc(sizeof(char*) * lines + length + 1);
+    if (paths == NULL)
+    {
+        SDL_Log("Error 04: Out Of Memory");
+        free(text);
+        return NULL;
+    }
+    char* copy = (char*) (paths + lines);
+    memcpy(copy, text, length + 1);
+    free(text);
+    for (char* line = strtok(copy, "\r\n"); line; line = strtok(NULL, "\r\n"))
+    {
+        while (*line == ' ' || *line == '\t') {line++;}
+        if (*line == '\0' || *line == '#') {continue;}
+        paths[(*count)++] = line;
+    }
+    if (*count == 0)
+    {
+        SDL_Log("Error 25: No Models To Draw");
+        free(paths);
+        return NULL;
+    }
+    return paths;
+}
+
+int has_model_extension(const char* name)
+{
+    size_t length = strlen(name);
+    const char* endings[3] = {".stl", ".stl.gz", ".stl.zst"};
+    for (int k = 0; k < 3; k++)
+    {
+        size_t ending = strlen(endings[k]);
+        if (length > ending && SDL_strcasecmp(name + length - ending, endings[k]) == 0) {return 1;}
+    }
+    return 0;
+}
+
+float fit_scale(const mesh_t* mesh, int width, int height)
+{
+    //keeps the bounding sphere of a centred mesh inside the shorter side at every angle, with a small margin
+    point3d size = {mesh->high.x - mesh->low.x, mesh->high.y - mesh->low.y, mesh->high.z - mesh->low.z};
+    float radius = sqrtf(size.x * size.x + size.y * size.y + size.z * size.z) / 2;
+    if (!(radius > 0)) {return settings.scale;}
+    float scale = 0.45f * (width < height ? width : height) / radius;
+    //perspective divides by 2 - z * perspective, which is smallest at the nearest point of the sphere
+    if (settings.perspective)
+    {
+        float w = 2 - radius * settings.perspective;
+        scale *= w > 0.1f ? w : 0.1f;
     }
+    return scale;
 }
 
-void line(uint32_t* screen, point3d a, point3d b, color_t color)
+camera_t* load_camera_path(const char* path, int* count)
 {
-    point3d scaleda = a;
-    point3d scaledb = b;
+    //one camera per line: xangle yangle [scale [perspective]], '#' starts a comment
+    *count = 0;
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        SDL_Log("Error 05: Camera Path Not Open");
+        return NULL;
+    }
 
-    if (scaleda.x == scaledb.x)
+    int capacity = 64;
+    camera_t* cameras = malloc(sizeof(camera_t) * capacity);
+    char buffer[256];
+    while (cameras && fgets(buffer, sizeof(buffer), file))
     {
-        int lessy = scaleda.y > scaledb.y ? scaledb.y : scaleda.y;
-        int greatery = scaleda.y > scaledb.y ? scaleda.y : scaledb.y;
-        for (int i = lessy; i <= greatery; i++)
+        camera_t camera = {.scale = settings.scale, .perspective = settings.perspective};
+        if (buffer[0] == '#') {continue;}
+        if (sscanf(buffer, "%f %f %f %f", &camera.xangle, &camera.yangle, &camera.scale, &camera.perspective) < 2) {continue;}
+        //between 0 and 1 like the buttons keep it
+        camera.perspective = camera.perspective > 0 ? min_float(camera.perspective, 1) : 0;
+        if (*count == capacity)
         {
-            put_pixel(screen, (int) scaleda.x, i, WHITE);
+            capacity *= 2;
+            camera_t* grown = realloc(cameras, sizeof(camera_t) * capacity);
+            if (grown == NULL) {free(cameras); cameras = NULL; break;}
+            cameras = grown;
         }
+        cameras[(*count)++] = camera;
     }
-    else
+    fclose(file);
+
+    if (cameras == NULL || *count == 0)
+    {
+        SDL_Log("Error 06: Camera Path Empty");
+        free(cameras);
+        return NULL;
+    }
+    return cameras;
+}
+
+int write_ppm(const char* path, uint32_t* pixels, int width, int height)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        SDL_Log("Error 07: Snapshot Not Written");
+        return 1;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    uint8_t* row = malloc(width * 3);
+    for (int y = 0; y < height; y++)
     {
-        float slope = (scaleda.y - scaledb.y) / (scaleda.x - scaledb.x);
-        if (abs(slope) <= 1)
+        for (int x = 0; x < width; x++)
         {
-            int least_x;
-            int most_x;
-            float y;
-            if (scaleda.x > scaledb.x) {least_x = scaledb.x; most_x = scaleda.x; y = scaledb.y;}
-            else {least_x = scaleda.x; most_x = scaledb.x; y = scaleda.y;}
+            uint32_t pixel = pixels[x + y * width];
+            row[x * 3] = pixel >> 16;
+            row[x * 3 + 1] = pixel >> 8;
+            row[x * 3 + 2] = pixel;
+        }
+        fwrite(row, 3, width, file);
+    }
+    free(row);
+    fclose(file);
+    return 0;
+}
 
-            for (int i = least_x; i <= most_x; i++)
-            {
-                put_pixel(screen, i, y, color);
-                y += slope;
-            }
+uint32_t* read_ppm(const char* path, int* width, int* height)
+{
+    //binary P6 with a maxval of 255 as write_ppm leaves it; the pixels come back opaque
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        SDL_Log("Error 29: Reference Image Not Read");
+        return NULL;
+    }
+    int maxval = 0;
+    uint32_t* pixels = NULL;
+    uint8_t* row = NULL;
+    //one whitespace character ends the header
+    if (fscanf(file, "P6 %d %d %d", width, height, &maxval) == 3 && maxval == 255 && fgetc(file) != EOF
+        && *width > 0 && *height > 0 && *width <= 16384 && *height <= 16384)
+    {
+        pixels = malloc(sizeof(uint32_t) * *width * *height);
+        row = malloc(*width * 3);
+    }
+    for (int y = 0; pixels && row && y < *height; y++)
+    {
+        if (fread(row, 3, *width, file) != (size_t) *width) {break;}
+        for (int x = 0; x < *width; x++)
+        {
+            pixels[x + y * *width] = 0xff000000u | (uint32_t) row[x * 3] << 16 | (uint32_t) row[x * 3 + 1] << 8 | row[x * 3 + 2];
         }
-        else
+        if (y == *height - 1)
         {
-            slope = (scaleda.x - scaledb.x) / (scaleda.y - scaledb.y);
-            int least_y;
-            int most_y;
-            float x;
-            if (scaleda.y > scaledb.y) {least_y = scaledb.y; most_y = scaleda.y; x = scaledb.x;}
-            else {least_y = scaleda.y; most_y = scaledb.y; x = scaleda.x;}
+            free(row);
+            fclose(file);
+            return pixels;
+        }
+    }
+    free(pixels);
+    free(row);
+    fclose(file);
+    SDL_Log("Error 29: Reference Image Not Read");
+    return NULL;
+}
 
-            for (int i = least_y; i <= most_y; i++)
-            {
-                put_pixel(screen, x, i, WHITE);
-                x += slope;
-            }
+long long compare_image(const uint32_t* pixels, const uint32_t* reference, long long count, int tolerance, int* worst)
+{
+    //pixels with a red, green or blue channel more than tolerance away from the reference; alpha is not written to ppm files
+    long long differing = 0;
+    *worst = 0;
+    for (long long i = 0; i < count; i++)
+    {
+        int largest = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int difference = abs((int) ((pixels[i] >> shift) & 0xff) - (int) ((reference[i] >> shift) & 0xff));
+            if (difference > largest) {largest = difference;}
         }
+        if (largest > tolerance) {differing++;}
+        if (largest > *worst) {*worst = largest;}
     }
+    return differing;
 }
 
-void numberrender(uint32_t* screen, int number, point3d offset, int count)
+uint32_t png_crc(uint32_t crc, const uint8_t* data, size_t length)
 {
-    //loop over each char
-    for (int i = 0; i < count; i++)
+    static uint32_t table[256];
+    if (table[1] == 0)
     {
-        uint8_t character = (number / (int)pow(10, (count - (i + 1)))) % 10;
-        switch (character)
+        for (uint32_t i = 0; i < 256; i++)
         {
-            case 0: // Actually good coding by Noah (discord: whyareyoureadingthis)
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, addpoint(offset, 10, 20, 0), addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, offset, addpoint(offset, 0, 20, 0), WHITE);
-                line(screen, addpoint(offset, 10, 20, 0), addpoint(offset, 0, 20, 0), WHITE);
-                break;
-            case 1:
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 2:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 10, 10, 0), addpoint(offset, 0, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 0, 20, 0), WHITE);
-                line(screen, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 3:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 4:
-                line(screen, offset, addpoint(offset, 0, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 5:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, addpoint(offset, 0, 0, 0), addpoint(offset, 0, 10, 0), WHITE);
-                line(screen, addpoint(offset, 10, 10, 0), addpoint(offset, 0, 10, 0), WHITE);
-                line(screen, addpoint(offset, 10, 10, 0), addpoint(offset, 10, 20, 0), WHITE);
-                line(screen, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 6:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, offset, addpoint(offset, 0, 20, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
-                line(screen, addpoint(offset, 10, 10, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 7:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 8:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, offset, addpoint(offset, 0, 20, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 20, 0), addpoint(offset, 10, 20, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            case 9:
-                line(screen, offset, addpoint(offset, 10, 0, 0), WHITE);
-                line(screen, offset, addpoint(offset, 0, 10, 0), WHITE);
-                line(screen, addpoint(offset, 0, 10, 0), addpoint(offset, 10, 10, 0), WHITE);
-                line(screen, addpoint(offset, 10, 0, 0), addpoint(offset, 10, 20, 0), WHITE);
-                break;
-            default:
-                break;
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;}
+            table[i] = c;
         }
-        offset.x += 14;
     }
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);}
+    return ~crc;
 }
 
-point3d calculated_position_to_screen_position(point3d point)
+void png_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t length)
 {
-    point3d ret;
-    ret.x = roundf(point.x * settings.scale) + (settings.width / 2);
-    ret.y = roundf(0 - point.y * settings.scale) + (settings.height / 2);
-    return ret;
+    uint8_t header[8] = {length >> 24, length >> 16, length >> 8, length, type[0], type[1], type[2], type[3]};
+    uint32_t crc = png_crc(png_crc(0, header + 4, 4), data, length);
+    uint8_t footer[4] = {crc >> 24, crc >> 16, crc >> 8, crc};
+    fwrite(header, 1, 8, file);
+    fwrite(data, 1, length, file);
+    fwrite(footer, 1, 4, file);
 }
 
-point3d model_to_2d(point3d point, float xangle, float yangle)
+int write_png(const char* path, uint32_t* pixels, int width, int height)
 {
-    point3d ret = rotatex(xangle, rotatey(yangle, point));
-    if (settings.perspective)
+    //uncompressed png: zlib stream made of stored deflate blocks, so no zlib dependency
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
     {
-        ret.x = ret.x / (2 - ret.z * settings.perspective);
-        ret.y = ret.y / (2 - ret.z * settings.perspective);
+        SDL_Log("Error 07: Snapshot Not Written");
+        return 1;
     }
-    return ret;
+
+    size_t raw_size = (size_t) height * (1 + width * 3);
+    size_t blocks = (raw_size + 65534) / 65535;
+    size_t idat_size = 2 + raw_size + blocks * 5 + 4;
+    uint8_t* raw = malloc(raw_size);
+    uint8_t* idat = malloc(idat_size);
+    if (raw == NULL || idat == NULL)
+    {
+        free(raw);
+        free(idat);
+        fclose(file);
+        return 1;
+    }
+
+    uint8_t* out = raw;
+    for (int y = 0; y < height; y++)
+    {
+        *out++ = 0; //filter type none
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t pixel = pixels[x + y * width];
+            *out++ = pixel >> 16;
+            *out++ = pixel >> 8;
+            *out++ = pixel;
+        }
+    }
+
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    out = idat;
+    *out++ = 0x78;
+    *out++ = 0x01;
+    for (size_t offset = 0; offset < raw_size; offset += 65535)
+    {
+        uint32_t length = raw_size - offset > 65535 ? 65535 : raw_size - offset;
+        *out++ = offset + length == raw_size; //final block flag, stored type
+        *out++ = length;
+        *out++ = length >> 8;
+        *out++ = ~length;
+        *out++ = ~length >> 8;
+        memcpy(out, raw + offset, length);
+        out += length;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            adler_a = (adler_a + raw[offset + i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+    uint32_t adler = (adler_b << 16) | adler_a;
+    *out++ = adler >> 24;
+    *out++ = adler >> 16;
+    *out++ = adler >> 8;
+    *out++ = adler;
+
+    uint8_t ihdr[13] = {width >> 24, width >> 16, width >> 8, width, height >> 24, height >> 16, height >> 8, height, 8, 2, 0, 0, 0};
+    fwrite("\x89PNG\r\n\x1a\n", 1, 8, file);
+    png_chunk(file, "IHDR", ihdr, 13);
+    png_chunk(file, "IDAT", idat, idat_size);
+    png_chunk(file, "IEND", NULL, 0);
+
+    free(raw);
+    free(idat);
+    fclose(file);
+    return 0;
 }
 
-point3d rotatex(float angle, point3d point)
+int write_snapshot(const char* path, uint32_t* pixels, int width, int height)
 {
-    point3d ret;
-    float cosa = cosf(angle);
-    float sina = sinf(angle);
-
-    ret.x = point.x;
-    ret.y = (point.y * cosa) - (point.z * sina);
-    ret.z = (point.y * sina) + (point.z * cosa);
-    return ret;
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(path + length - 4, ".png") == 0)
+    {
+        return write_png(path, pixels, width, height);
+    }
+    return write_ppm(path, pixels, width, height);
 }
 
-point3d rotatey(float angle, point3d point)
+int frame_path(const char* pattern, int frame, char* name, size_t size)
 {
-    point3d ret;
-    float cosa = cosf(angle);
-    float sina = sinf(angle);
+    //the pattern with its one %d or %0Nd replaced by the frame and %% by %, written by hand so the pattern is never a
+    //format string; returns 1 if the frame went in, 0 if there was none and -1 for any other conversion or a name too long
+    size_t length = 0;
+    int substituted = 0;
+    for (const char* p = pattern; *p; p++)
+    {
+        char piece[32] = {*p, '\0'};
+        if (*p == '%')
+        {
+            p++;
+            int width = 0;
+            int zero = *p == '0';
+            while (*p >= '0' && *p <= '9' && width < 100) {width = width * 10 + (*p++ - '0');}
+            if (*p == '%' && width == 0 && !zero) {piece[0] = '%';}
+            else if (*p == 'd' && !substituted && width < 20)
+            {
+                snprintf(piece, sizeof(piece), zero ? "%0*d" : "%*d", width, frame);
+                substituted = 1;
+            }
+            else {return -1;}
+        }
+        size_t piece_length = strlen(piece);
+        if (length + piece_length >= size) {return -1;}
+        memcpy(name + length, piece, piece_length);
+        length += piece_length;
+    }
+    name[length] = '\0';
+    return substituted;
+}
 
-    ret.x = (point.x * cosa) + (point.z * sina);
-    ret.y = point.y;
-    ret.z = (point.z * cosa) - (point.x * sina);
-    return ret;
+double elapsed_ms(Uint64 start)
+{
+    return (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
 }
 
-point3d rotatez(float angle, point3d point)
+double profile_end(const char* name, Uint64 start, int thread)
 {
-    point3d ret;
-    float cosa = cosf(angle);
-    float sina = sinf(angle);
+    //records a timed scope in the trace ring and returns its length in ms, name must outlive the trace
+    Uint64 end = SDL_GetPerformanceCounter();
+    profile_event_t* event = &profiler.events[(uint32_t) SDL_AddAtomicInt(&profiler.next, 1) & (PROFILE_EVENTS - 1)];
+    event->name = name;
+    event->start = start;
+    event->end = end;
+    event->value = 0;
+    event->thread = thread;
+    event->kind = 'X';
+    return (double) (end - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
 
-    ret.x = (point.x * cosa) - (point.y * sina);
-    ret.y = (point.x * sina) + (point.y * cosa);
-    ret.z = point.x;
-    return ret;
+void profile_count(const char* name, long long value)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    profile_event_t* event = &profiler.events[(uint32_t) SDL_AddAtomicInt(&profiler.next, 1) & (PROFILE_EVENTS - 1)];
+    event->name = name;
+    event->start = now;
+    event->end = now;
+    event->value = value;
+    event->thread = 0;
+    event->kind = 'C';
 }
 
-polygon_t newpolygon(color_t color, point3d a, point3d b, point3d c)
+void profile_frame(void)
 {
-    polygon_t ret;
-    ret.color = color;
-    ret.a = a;
-    ret.b = b;
-    ret.c = c;
-    return ret;
+    //called once a frame is finished, counters go to the trace and everything to the overlay history
+    long long counters[4] = {raster_stats.submitted, raster_stats.submitted - raster_stats.visible_polygons, raster_stats.lines, raster_stats.pixels};
+    profile_count("triangles submitted", counters[0]);
+    profile_count("triangles culled", counters[1]);
+    profile_count("lines drawn", counters[2]);
+    profile_count("pixels written", counters[3]);
+    profile_count("meshlets culled", raster_stats.meshlets_culled);
+    profile_count("triangles occluded", raster_stats.occlusion_culled);
+
+    int slot = profiler.frames % PROFILE_HISTORY;
+    double stages[PROFILE_STAGES] = {frame_timing.event_ms, frame_timing.clear_ms, frame_timing.transform_ms, frame_timing.cull_ms, frame_timing.raster_ms, frame_timing.upload_ms, frame_timing.present_ms};
+    memcpy(profiler.stage_ms[slot], stages, sizeof(stages));
+    memcpy(profiler.counters[slot], counters, sizeof(counters));
+    profiler.frames++;
 }
 
-void put_pixel(uint32_t* screen, unsigned x, unsigned y, uint32_t color)
+void profile_overlay(render_target_t* target)
 {
-    if (x < settings.width && y < settings.height)
+    //right column, one row per value: event, clear, transform, cull, raster, upload and present in us,
+    //then triangles submitted, triangles culled, lines drawn and pixels written, each averaged over the last frames
+    int frames = profiler.frames < PROFILE_HISTORY ? profiler.frames : PROFILE_HISTORY;
+    if (frames == 0) {return;}
+    int x = target->width - 110;
+    for (int row = 0; row < PROFILE_STAGES + 4; row++)
+    {
+        double mean = 0;
+        for (int k = 0; k < frames; k++)
+        {
+            mean += row < PROFILE_STAGES ? profiler.stage_ms[k][row] * 1000.0 : (double) profiler.counters[k][row - PROFILE_STAGES];
+        }
+        mean /= frames;
+        int y = 40 + row * 26;
+        numberrender(target, mean > 9999999 ? 9999999 : (int) mean, (point3d) {.x = (float) x, .y = (float) y, .z = 0.0f}, 7);
+        if (row < PROFILE_STAGES)
+        {
+            //a pixel per 100us, left of the number
+            int length = mean / 100 > 200 ? 200 : (int) (mean / 100);
+            for (int dy = 4; dy < 16; dy++)
+            {
+                for (int dx = 1; dx <= length; dx++) {put_pixel(target, x - 10 - dx, y + dy, WHITE);}
+            }
+        }
+    }
+
+    //frame time of each remembered frame, oldest on the left, red when it took longer than 60 fps allows
+    int base = 40 + (PROFILE_STAGES + 4) * 26 + 64;
+    for (int k = 0; k < frames; k++)
     {
-        screen[x + (y * settings.width)] = color;
+        int slot = (profiler.frames - frames + k) % PROFILE_HISTORY;
+        double total = 0;
+        for (int stage = 0; stage < PROFILE_STAGES; stage++) {total += profiler.stage_ms[slot][stage];}
+        int height = total * 2 > 60 ? 60 : (int) (total * 2);
+        color_t color = total > 1000.0 / 60 ? RED : WHITE;
+        for (int dy = 0; dy < height; dy++)
+        {
+            put_pixel(target, target->width - 140 + k * 2, base - dy, color);
+        }
     }
 }
 
-button_t new_button(int x, int y, int width, int height, char *text)
+int write_trace(const char* path)
 {
-    button_t ret;
-    ret.height = height;
-    strcpy(ret.text, text);
-    ret.width = width;
-    ret.x = x;
-    ret.y = y;
-    return ret;
+    //chrome trace_event json of what is still in the ring, for chrome://tracing or ui.perfetto.dev
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        SDL_Log("Error 13: Trace Not Written");
+        return 1;
+    }
+    uint32_t next = (uint32_t) SDL_GetAtomicInt(&profiler.next);
+    uint32_t count = next < PROFILE_EVENTS ? next : PROFILE_EVENTS;
+    Uint64 origin = 0;
+    int threads = 1;
+    for (uint32_t k = 0; k < count; k++)
+    {
+        profile_event_t* event = &profiler.events[(next - count + k) & (PROFILE_EVENTS - 1)];
+        if (k == 0 || event->start < origin) {origin = event->start;}
+        if (event->thread + 1 > threads) {threads = event->thread + 1;}
+    }
+    double us_per_tick = 1000000.0 / (double) SDL_GetPerformanceFrequency();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint32_t k = 0; k < count; k++)
+    {
+        profile_event_t* event = &profiler.events[(next - count + k) & (PROFILE_EVENTS - 1)];
+        if (event->kind == 'C')
+        {
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":0,\"args\":{\"value\":%lld}},\n",
+                event->name, (event->start - origin) * us_per_tick, event->value);
+        }
+        else
+        {
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d},\n",
+                event->name, (event->start - origin) * us_per_tick, (event->end - event->start) * us_per_tick, event->thread);
+        }
+    }
+    //thread names last, they carry no time and end the list without a trailing comma
+    //-1 is the SDL thread, 0 the thread that draws the frames and the rest are pool workers
+    for (int thread = -1; thread < threads; thread++)
+    {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}%s\n", thread, thread < 0 ? "sdl" : thread ? "worker" : "render", thread, thread + 1 < threads ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    if (fclose(file) != 0)
+    {
+        SDL_Log("Error 13: Trace Not Written");
+        return 1;
+    }
+    return 0;
 }
 
-void renderbutton(uint32_t* screen, button_t button)
+int compare_double(const void* a, const void* b)
 {
-    point3d topleft = (point3d) {.x = button.x, .y = button.y, .z = 0.0f};
-    line(screen, topleft, addpoint(topleft, button.width, 0, 0), WHITE);
-    line(screen, addpoint(topleft, button.width, button.height, 0), addpoint(topleft, button.width, 0, 0), WHITE);
-    line(screen, addpoint(topleft, 0, button.height, 0), addpoint(topleft, button.width, button.height, 0), WHITE);
-    line(screen, topleft, addpoint(topleft, 0, button.height, 0), WHITE);
+    double da = *(const double*) a;
+    double db = *(const double*) b;
+    return (da > db) - (da < db);
 }
 
-int check_button_pressed(button_t button, int x, int y)
+double percentile(double* sorted, int count, double p)
 {
-    return ((x >= button.x) && ((button.x + button.width) >= x)) && ((y >= button.y) && ((button.y + button.height) >= y));
+    //nearest-rank percentile of an ascending array
+    int rank = (int) ceil(p * count);
+    if (rank < 1) {rank = 1;}
+    return sorted[rank - 1];
 }
@@ -1,2 +1,2 @@
-gcc main.c -mwindows -IC:\\libs\\SDL3-3.2.16\\x86_64-w64-mingw32\\include -IC:\\libs\\SDL3_ttf-3.2.2\\x86_64-w64-mingw32\\include -LC:\\libs\\SDL3-3.2.16\\x86_64-w64-mingw32\\lib -LC:\\libs\\SDL3_ttf-3.2.2\\x86_64-w64-mingw32\\lib -lSDL3 -o "3D model viewer"
+gcc main.c -mwindows -DHAVE_ZLIB -DHAVE_ZSTD -IC:\\libs\\SDL3-3.2.16\\x86_64-w64-mingw32\\include -IC:\\libs\\SDL3_ttf-3.2.2\\x86_64-w64-mingw32\\include -LC:\\libs\\SDL3-3.2.16\\x86_64-w64-mingw32\\lib -LC:\\libs\\SDL3_ttf-3.2.2\\x86_64-w64-mingw32\\lib -lSDL3 -lz -lzstd -o "3D model viewer"
 
@@ -0,0 +1,87 @@
+#!/bin/sh
+#renders each test model headless along its camera path and compares the last frame with the reference image next to it,
+#exits 1 if any differ. Run from anywhere:
+#    sh tests/run.sh [viewer]            compare, the viewer defaults to the one make.sh builds
+#    sh tests/run.sh --update [viewer]   write the reference images instead, after a change that is meant to alter them
+update=0
+if [ "$1" = "--update" ]; then update=1; shift; fi
+viewer=${1:-"$(dirname "$0")/../3D model viewer"}
+case "$viewer" in
+    /*) ;;
+    *) viewer="$PWD/$viewer" ;;
+esac
+cd "$(dirname "$0")" || exit 1
+
+#a channel may be this far off, for rounding that differs between SIMD paths
+tolerance=2
+failed=0
+
+check()
+{
+    #label, reference image, then the options for the viewer
+    label=$1
+    reference=$2
+    shift 2
+    if [ $update = 1 ]; then
+        if "$viewer" --headless --size 320x240 "$@" --snapshot "$reference" > /dev/null; then
+            echo "wrote $reference for $label"
+        else
+            echo "FAIL $label: not rendered"
+            failed=1
+        fi
+        return
+    fi
+    output=$("$viewer" --headless --size 320x240 "$@" --compare "$reference" --tolerance $tolerance 2>&1)
+    if [ $? = 0 ]; then
+        echo "ok   $label"
+    else
+        echo "FAIL $label: $(echo "$output" | grep -E "^compare:|Error" | head -n 1)"
+        failed=1
+    fi
+}
+
+check cube cube.ppm --frames 3 --camera-path cube.cam
+check sphere sphere.ppm --frames 3 --camera-path sphere.cam --mode fill --generate sphere
+check grid grid.ppm --frames 3 --camera-path grid.cam --mode both --generate grid:1000000
+check "binary stl" tetra.ppm --frames 3 --camera-path tetra.cam --no-cache tetra.stl
+#the same tetrahedron, so the same image
+if [ $update = 0 ]; then check "ascii stl" tetra.ppm --frames 3 --camera-path tetra.cam --no-cache tetra_ascii.stl; fi
+#and again with nan, inf and overflowing facet normals, which are dropped and recomputed from the winding
+if [ $update = 0 ]; then check "ascii stl, broken normals" tetra.ppm --frames 3 --camera-path tetra.cam --no-cache tetra_normals.stl; fi
+
+check_history()
+{
+    #label, camera path, then the options for the viewer: every frame of the path has to match the same view drawn fresh,
+    #so nothing carried from one frame to the next (hi-z, cached transforms) changes what is drawn
+    label=$1
+    path=$2
+    shift 2
+    [ $update = 1 ] && return
+    frames=$(grep -c "^[^#]" "$path")
+    scratch=$(mktemp -d) || exit 1
+    if ! "$viewer" --headless --size 320x240 --frames "$frames" --camera-path "$path" --snapshot "$scratch/frame%d.ppm" "$@" > /dev/null; then
+        echo "FAIL $label: not rendered"
+        failed=1
+        rm -rf "$scratch"
+        return
+    fi
+    frame=0
+    grep "^[^#]" "$path" | while read -r camera; do
+        echo "$camera" > "$scratch/camera.txt"
+        "$viewer" --headless --size 320x240 --frames 1 --camera-path "$scratch/camera.txt" --compare "$scratch/frame$frame.ppm" --tolerance 0 "$@" > /dev/null 2>&1 || echo "$frame"
+        frame=$((frame + 1))
+    done > "$scratch/bad.txt"
+    bad=$(tr '\n' ' ' < "$scratch/bad.txt" | sed 's/ $//')
+    rm -rf "$scratch"
+    if [ -z "$bad" ]; then
+        echo "ok   $label"
+    else
+        echo "FAIL $label: frames $bad differ from a fresh render"
+        failed=1
+    fi
+}
+
+check_history "sphere history" history.cam --mode both --generate sphere
+check_history "sphere history, all edges" history.cam --mode both --edges all --generate sphere
+check_history "grid history, compact" history.cam --mode both --compact --generate grid:200000
+exit $failed